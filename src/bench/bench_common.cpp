@@ -0,0 +1,127 @@
+#include "bench_common.hpp"
+#include <cstdint>
+#include <sstream>
+#include <stdexcept>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+
+std::vector<std::pair<int, int>> parseSizes(const std::string& list)
+{
+    std::vector<std::pair<int, int>> sizes;
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ','))
+    {
+        int w = 0, h = 0;
+        char x = 0;
+        std::stringstream size(item);
+        if (!(size >> w >> x >> h) || x != 'x' || w <= 0 || h <= 0)
+            throw std::runtime_error("Invalid size, expected WxH : " + item);
+        sizes.emplace_back(w, h);
+    }
+    return sizes;
+}
+
+/*
+Gradients so the filters have edges and smooth areas to work on, plus xorshift noise so nothing
+compresses into a trivially uniform image.
+*/
+std::vector<unsigned char> makeSyntheticFrame(int width, int height)
+{
+    std::vector<unsigned char> frame(static_cast<size_t>(width) * height * 4);
+    uint32_t state = 0x9E3779B9u;
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            int noise = static_cast<int>(state & 15) - 8;
+            bool checker = ((x / 64) + (y / 64)) % 2 == 0;
+
+            size_t index = (static_cast<size_t>(y) * width + x) * 4;
+            frame[index + 0] = static_cast<unsigned char>(std::clamp(x * 255 / width + noise, 0, 255));
+            frame[index + 1] = static_cast<unsigned char>(std::clamp(y * 255 / height + noise, 0, 255));
+            frame[index + 2] = static_cast<unsigned char>(checker ? 200 : 60);
+            frame[index + 3] = 255;
+        }
+    }
+    return frame;
+}
+
+std::vector<unsigned char> makeSyntheticMask(int width, int height)
+{
+    // Same convention as MaskGenerator::generateMasks : object pixels are 255, the rest 0
+    std::vector<unsigned char> mask(static_cast<size_t>(width) * height * 4, 0);
+    float cx = width * 0.5f, cy = height * 0.5f;
+    float rx = width * 0.3f, ry = height * 0.4f;
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            float dx = (x - cx) / rx, dy = (y - cy) / ry;
+            if (dx * dx + dy * dy <= 1.0f)
+                std::fill_n(mask.begin() + (static_cast<size_t>(y) * width + x) * 4, 4, 255);
+        }
+    }
+    return mask;
+}
+
+void writeStageStatsJson(std::ostream& out, const std::map<std::string, Profiler::StageStats>& stages)
+{
+    out << "{";
+    size_t i = 0;
+    for (const auto& [stage, s] : stages)
+    {
+        out << (i++ ? ", " : "") << "\"" << stage << "\": {\"count\": " << s.count << ", \"mean\": " << s.mean
+            << ", \"p50\": " << s.p50 << ", \"p95\": " << s.p95 << ", \"p99\": " << s.p99
+            << ", \"max\": " << s.max << "}";
+    }
+    out << "}";
+}
+
+ImageComparison compareImages(const std::vector<unsigned char>& actual, const std::vector<unsigned char>& expected,
+                              int width, int height)
+{
+    size_t pixels = static_cast<size_t>(width) * height;
+    if (actual.size() < pixels * 4 || expected.size() < pixels * 4)
+        throw std::runtime_error("Image size does not match " + std::to_string(width) + "x" + std::to_string(height));
+
+    ImageComparison result = { 0.0, 0, 0 };
+    double squaredError = 0.0;
+    for (size_t i = 0; i < pixels; i++)
+    {
+        bool mismatch = false;
+        for (int c = 0; c < 3; c++)
+        {
+            int error = std::abs(actual[i * 4 + c] - expected[i * 4 + c]);
+            squaredError += static_cast<double>(error) * error;
+            result.maxError = std::max(result.maxError, error);
+            mismatch |= error != 0;
+        }
+        if (mismatch)
+            result.mismatchedPixels++;
+    }
+
+    double mse = squaredError / (pixels * 3);
+    result.psnr = mse > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / mse) : std::numeric_limits<double>::infinity();
+    return result;
+}
+
+std::vector<unsigned char> makeDiffImage(const std::vector<unsigned char>& actual,
+                                         const std::vector<unsigned char>& expected, int width, int height)
+{
+    std::vector<unsigned char> diff(static_cast<size_t>(width) * height * 4, 255);
+    for (size_t i = 0; i < static_cast<size_t>(width) * height; i++)
+    {
+        for (int c = 0; c < 3; c++)
+        {
+            int error = std::abs(actual[i * 4 + c] - expected[i * 4 + c]);
+            diff[i * 4 + c] = static_cast<unsigned char>(std::min(255, error * 8));
+        }
+    }
+    return diff;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <map>
+#include <ostream>
+#include "core/profiler.hpp"
+
+// Helpers shared by the bench executables
+
+// "1280x720,1920x1080" -> {{1280, 720}, {1920, 1080}}
+std::vector<std::pair<int, int>> parseSizes(const std::string& list);
+
+// Deterministic RGBA test card, the same bytes for the same size on every run
+std::vector<unsigned char> makeSyntheticFrame(int width, int height);
+
+// RGBA mask in the MaskGenerator layout for a centred ellipse covering roughly a third of the frame
+std::vector<unsigned char> makeSyntheticMask(int width, int height);
+
+// {"stage": {"count": .., "mean": .., "p50": .., "p95": .., "p99": .., "max": ..}, ...}
+void writeStageStatsJson(std::ostream& out, const std::map<std::string, Profiler::StageStats>& stages);
+
+struct ImageComparison {
+    double psnr;             // dB over the RGB channels, infinity when identical
+    int maxError;            // Largest absolute per channel difference
+    size_t mismatchedPixels; // Pixels with any channel difference
+};
+
+// Both images RGBA of the same size, alpha is ignored since PPM does not store it
+ImageComparison compareImages(const std::vector<unsigned char>& actual, const std::vector<unsigned char>& expected,
+                              int width, int height);
+
+// RGBA visualisation of the per channel difference, amplified so small errors are visible
+std::vector<unsigned char> makeDiffImage(const std::vector<unsigned char>& actual,
+                                         const std::vector<unsigned char>& expected, int width, int height);
@@ -0,0 +1,357 @@
+/*
+Headless benchmark for the Vulkan compute path. No ffmpeg, no video and nothing written to disk
+besides the optional JSON report : synthetic RGBA frames are pushed through ComputePipeline and
+the profiler collects upload / execute / readback times (plus GPU timestamps when the queue has
+them). Works under a software ICD, e.g. VK_ICD_FILENAMES=/usr/share/vulkan/icd.d/lvp_icd.x86_64.json
+
+    ./bench [--iterations N] [--warmup N] [--sizes 1280x720,1920x1080] [--json report.json] [shader.spv ...]
+    Eg : ./bench --sizes 3840x2160 --iterations 50 ../ghibli.spv
+
+Golden image mode, to check that optimized shader variants still produce the same pictures :
+    ./bench --record goldens/ [--input ../input.ppm] [shader.spv ...]   writes the reference outputs
+    ./bench --verify goldens/ [--psnr-min 40] [--max-error 8] ...       compares against them
+Each shader runs once per synthetic frame size and per --input image (../input.ppm by default).
+Goldens are named after the reference shader : <class>_tiled / <class>_image variants are verified
+against <class>'s goldens and skipped when recording. On a mismatch diff_<shader>_<input>.ppm is
+written to the current folder and the exit code is 1. ctest runs the checks on goldens/.
+
+--cpu runs everything on the CPU backend (cpu_pipeline) instead of Vulkan, eg
+./bench --cpu --verify goldens/ checks it against the same references.
+*/
+
+#include <cstdlib>
+#include <stdexcept>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <filesystem>
+#include <memory>
+#include <map>
+#include "core/vulkan_engine.hpp"
+#include "core/pipeline.hpp"
+#include "core/profiler.hpp"
+#include "io/ppm_handler.hpp"
+#include "bench_common.hpp"
+
+struct BenchOptions {
+    std::vector<std::string> shaders;
+    std::vector<std::pair<int, int>> sizes;
+    int iterations = 100;
+    int warmup = 5;
+    std::string jsonPath;
+
+    // Golden image mode
+    std::string recordDir;
+    std::string verifyDir;
+    std::vector<std::string> inputs;
+    double psnrMin = 40.0;
+    int maxError = 8;
+
+    bool cpu = false;
+};
+
+struct BenchResult {
+    std::string shader;
+    int width, height;
+    std::map<std::string, Profiler::StageStats> stages;
+    double fps;
+};
+
+static BenchOptions parseOptions(int argc, char* argv[])
+{
+    BenchOptions options;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--iterations" && hasValue)
+            options.iterations = std::stoi(argv[++i]);
+        else if (arg == "--warmup" && hasValue)
+            options.warmup = std::stoi(argv[++i]);
+        else if (arg == "--sizes" && hasValue)
+            options.sizes = parseSizes(argv[++i]);
+        else if (arg == "--json" && hasValue)
+            options.jsonPath = argv[++i];
+        else if (arg == "--record" && hasValue)
+            options.recordDir = argv[++i];
+        else if (arg == "--verify" && hasValue)
+            options.verifyDir = argv[++i];
+        else if (arg == "--input" && hasValue)
+            options.inputs.push_back(argv[++i]);
+        else if (arg == "--psnr-min" && hasValue)
+            options.psnrMin = std::stod(argv[++i]);
+        else if (arg == "--max-error" && hasValue)
+            options.maxError = std::stoi(argv[++i]);
+        else if (arg == "--cpu")
+            options.cpu = true;
+        else if (arg.rfind("--", 0) == 0)
+            throw std::runtime_error("Unknown option: " + arg);
+        else
+            options.shaders.push_back(arg);
+    }
+
+    // Same relative layout the main binary assumes when run from the build folder
+    if (options.shaders.empty())
+        options.shaders = { "../grayscale.spv", "../ghibli.spv", "../shaders/person.spv" };
+    if (options.sizes.empty())
+        options.sizes = { { 1280, 720 }, { 1920, 1080 } };
+    if (options.iterations <= 0 || options.warmup < 0)
+        throw std::runtime_error("Iterations must be positive and warmup non negative");
+    if (!options.recordDir.empty() && !options.verifyDir.empty())
+        throw std::runtime_error("--record and --verify are exclusive");
+    if (options.inputs.empty() && std::filesystem::exists("../input.ppm"))
+        options.inputs.push_back("../input.ppm");
+    return options;
+}
+
+static BenchResult runCase(VulkanEngine& engine, const std::string& shaderPath, int width, int height,
+                           const BenchOptions& options)
+{
+    ComputePipeline pipeline(engine, shaderPath, width, height);
+    bool usesMask = pipeline.getReflection().findBinding(2) != nullptr;
+
+    std::vector<unsigned char> input = makeSyntheticFrame(width, height);
+    std::vector<unsigned char> mask;
+    if (usesMask)
+        mask = makeSyntheticMask(width, height);
+    std::vector<unsigned char> output;
+
+    Profiler& profiler = Profiler::instance();
+    for (int i = 0; i < options.warmup + options.iterations; i++)
+    {
+        // Warmup covers lazy allocations (query pool, driver caches), drop it from the stats
+        if (i == options.warmup)
+            profiler.reset();
+
+        ProfileScope scope("frame");
+        if (usesMask)
+            pipeline.processImage(input, output, mask);
+        else
+            pipeline.processImage(input, output);
+    }
+
+    if (output.size() != input.size())
+        throw std::runtime_error("Unexpected output size from " + shaderPath);
+
+    BenchResult result;
+    result.shader = std::filesystem::path(shaderPath).stem().string();
+    result.width = width;
+    result.height = height;
+    result.stages = profiler.summarize();
+    result.fps = result.stages["frame"].mean > 0.0 ? 1000.0 / result.stages["frame"].mean : 0.0;
+    profiler.reset();
+    return result;
+}
+
+static double stageMean(const BenchResult& result, const std::string& stage)
+{
+    auto it = result.stages.find(stage);
+    return it != result.stages.end() ? it->second.mean : -1.0;
+}
+
+static void printTable(const std::vector<BenchResult>& results, std::ostream& out)
+{
+    out << "\nMean latency per frame (ms), '-' when the device has no timestamp support\n";
+    out << std::left << std::setw(16) << "shader" << std::setw(12) << "size" << std::right
+        << std::setw(10) << "upload" << std::setw(10) << "execute" << std::setw(10) << "gpu"
+        << std::setw(10) << "readback" << std::setw(10) << "frame" << std::setw(10) << "p95"
+        << std::setw(10) << "fps" << "\n";
+
+    out << std::fixed << std::setprecision(3);
+    for (const BenchResult& r : results)
+    {
+        double gpu = stageMean(r, "gpu:" + r.shader + ":dispatch");
+        out << std::left << std::setw(16) << r.shader
+            << std::setw(12) << (std::to_string(r.width) + "x" + std::to_string(r.height)) << std::right
+            << std::setw(10) << stageMean(r, "pipeline:upload")
+            << std::setw(10) << stageMean(r, "pipeline:execute");
+        if (gpu < 0.0)
+            out << std::setw(10) << "-";
+        else
+            out << std::setw(10) << gpu;
+        out << std::setw(10) << stageMean(r, "pipeline:readback")
+            << std::setw(10) << r.stages.at("frame").mean
+            << std::setw(10) << r.stages.at("frame").p95
+            << std::setw(10) << std::setprecision(1) << r.fps << std::setprecision(3) << "\n";
+    }
+    out << std::defaultfloat;
+}
+
+static void writeJson(const std::vector<BenchResult>& results, const VulkanEngine& engine,
+                      const BenchOptions& options)
+{
+    std::ofstream file(options.jsonPath);
+    if (!file)
+        throw std::runtime_error("Failed to open report file: " + options.jsonPath);
+
+    file << std::fixed << std::setprecision(4);
+    file << "{\n  \"device\": \"" << engine.getDeviceName() << "\",\n";
+    file << "  \"iterations\": " << options.iterations << ",\n  \"warmup\": " << options.warmup << ",\n";
+    file << "  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const BenchResult& r = results[i];
+        file << "    {\"shader\": \"" << r.shader << "\", \"width\": " << r.width << ", \"height\": " << r.height
+             << ", \"fps\": " << r.fps << ", \"stages\": ";
+        writeStageStatsJson(file, r.stages);
+        file << "}" << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    file << "  ]\n}\n";
+}
+
+struct GoldenInput {
+    std::string label;
+    std::vector<unsigned char> data;
+    int width, height;
+};
+
+static std::vector<GoldenInput> loadGoldenInputs(const BenchOptions& options)
+{
+    std::vector<GoldenInput> inputs;
+    for (const auto& [width, height] : options.sizes)
+        inputs.push_back({ "synthetic_" + std::to_string(width) + "x" + std::to_string(height),
+                           makeSyntheticFrame(width, height), width, height });
+
+    for (const std::string& path : options.inputs)
+    {
+        GoldenInput input;
+        input.label = std::filesystem::path(path).stem().string();
+        loadPPMImage(path.c_str(), input.data, input.width, input.height);
+        inputs.push_back(std::move(input));
+    }
+    return inputs;
+}
+
+// "ghibli_tiled" -> "ghibli", the shader whose goldens a variant has to reproduce
+static std::string referenceShader(const std::string& shader)
+{
+    for (const std::string suffix : { "_tiled", "_image" })
+    {
+        if (shader.size() > suffix.size() &&
+            shader.compare(shader.size() - suffix.size(), suffix.size(), suffix) == 0)
+            return shader.substr(0, shader.size() - suffix.size());
+    }
+    return shader;
+}
+
+// Returns the number of mismatching outputs, 0 when recording
+static int runGolden(VulkanEngine& engine, const BenchOptions& options)
+{
+    bool recording = !options.recordDir.empty();
+    const std::string& goldenDir = recording ? options.recordDir : options.verifyDir;
+    if (recording)
+        std::filesystem::create_directories(goldenDir);
+
+    std::vector<GoldenInput> inputs = loadGoldenInputs(options);
+    int failures = 0;
+    for (const std::string& shaderPath : options.shaders)
+    {
+        if (!std::filesystem::exists(shaderPath))
+            throw std::runtime_error("Shader not found: " + shaderPath);
+        std::string shader = std::filesystem::path(shaderPath).stem().string();
+        std::string reference = referenceShader(shader);
+        if (recording && reference != shader)
+        {
+            std::cout << "Skipped " << shader << ", variants are verified against " << reference << "'s goldens" << std::endl;
+            continue;
+        }
+
+        for (const GoldenInput& input : inputs)
+        {
+            ComputePipeline pipeline(engine, shaderPath, input.width, input.height);
+            std::vector<unsigned char> output;
+            if (pipeline.getReflection().findBinding(2) != nullptr)
+                pipeline.processImage(input.data, output, makeSyntheticMask(input.width, input.height));
+            else
+                pipeline.processImage(input.data, output);
+
+            std::string name = shader + "_" + input.label;
+            std::string goldenPath = (std::filesystem::path(goldenDir) / (reference + "_" + input.label + ".ppm")).string();
+            if (recording)
+            {
+                savePPMImage(goldenPath.c_str(), output, input.width, input.height);
+                std::cout << "Recorded " << goldenPath << std::endl;
+                continue;
+            }
+
+            if (!std::filesystem::exists(goldenPath))
+            {
+                std::cout << "FAIL " << name << " : no golden image, record one with --record" << std::endl;
+                failures++;
+                continue;
+            }
+
+            std::vector<unsigned char> expected;
+            int goldenWidth = 0, goldenHeight = 0;
+            loadPPMImage(goldenPath.c_str(), expected, goldenWidth, goldenHeight);
+            if (goldenWidth != input.width || goldenHeight != input.height)
+            {
+                std::cout << "FAIL " << name << " : golden image is " << goldenWidth << "x" << goldenHeight << std::endl;
+                failures++;
+                continue;
+            }
+
+            ImageComparison comparison = compareImages(output, expected, input.width, input.height);
+            bool pass = comparison.psnr >= options.psnrMin && comparison.maxError <= options.maxError;
+            std::cout << (pass ? "PASS " : "FAIL ") << name << " : psnr " << std::fixed << std::setprecision(2)
+                      << comparison.psnr << " dB, max error " << comparison.maxError << ", "
+                      << comparison.mismatchedPixels << " pixels differ" << std::defaultfloat << std::endl;
+            if (!pass)
+            {
+                std::string diffPath = "diff_" + name + ".ppm";
+                savePPMImage(diffPath.c_str(), makeDiffImage(output, expected, input.width, input.height),
+                             input.width, input.height);
+                std::cout << "     diff written to " << diffPath << std::endl;
+                failures++;
+            }
+        }
+    }
+    return failures;
+}
+
+int main(int argc, char* argv[])
+{
+    try
+    {
+        BenchOptions options = parseOptions(argc, argv);
+        Profiler::instance().setEnabled(true);
+
+        VulkanEngine engine(options.cpu);
+        if (!options.recordDir.empty() || !options.verifyDir.empty())
+        {
+            int failures = runGolden(engine, options);
+            if (failures > 0)
+            {
+                std::cerr << failures << " golden image check(s) failed" << std::endl;
+                return EXIT_FAILURE;
+            }
+            return EXIT_SUCCESS;
+        }
+
+        std::vector<BenchResult> results;
+        for (const std::string& shader : options.shaders)
+        {
+            if (!std::filesystem::exists(shader))
+                throw std::runtime_error("Shader not found: " + shader);
+
+            for (const auto& [width, height] : options.sizes)
+            {
+                std::cout << "Running " << shader << " at " << width << "x" << height << " ..." << std::endl;
+                results.push_back(runCase(engine, shader, width, height, options));
+            }
+        }
+
+        printTable(results, std::cout);
+        if (!options.jsonPath.empty())
+        {
+            writeJson(results, engine, options);
+            std::cout << "Report written to " << options.jsonPath << std::endl;
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,257 @@
+/*
+Benchmark for the CPU side of the frame loop, no GPU, ONNX model or video needed : PPM, QOI and
+LZ4 frame save/load, the 640x640 YOLO preprocessing, YOLO decoding + NMS on synthetic output
+tensors and MaskGenerator::generateMasks, each at the requested frame sizes.
+Runs inside a scratch directory, removed at the end, since the save/load stages write their bench_frame
+files to the cwd.
+
+    ./cpu_bench [--iterations N] [--sizes 1280x720,1920x1080,3840x2160] [--json report.json]
+*/
+
+#include <cstdlib>
+#include <cstdint>
+#include <stdexcept>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <filesystem>
+#include <functional>
+#include "core/profiler.hpp"
+#include "io/ppm_handler.hpp"
+#include "io/frame_codec.hpp"
+#include "processing/yolo_decode.hpp"
+#include "processing/mask_generator.hpp"
+#include "bench_common.hpp"
+
+namespace fs = std::filesystem;
+
+struct CpuBenchOptions {
+    std::vector<std::pair<int, int>> sizes;
+    int iterations = 20;
+    std::string jsonPath;
+};
+
+struct CpuBenchResult {
+    int width, height;
+    std::map<std::string, Profiler::StageStats> stages;
+};
+
+// YOLOv8-seg export layout : 4 box values, 80 class scores, 32 mask coefficients per proposal
+const int NUM_CLASSES = 80;
+const int NUM_MASK_CHANNELS = 32;
+const int NUM_PROPOSALS = 8400;
+const int MASK_PROTO_SIZE = 160;
+
+static CpuBenchOptions parseOptions(int argc, char* argv[])
+{
+    CpuBenchOptions options;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--iterations" && hasValue)
+            options.iterations = std::stoi(argv[++i]);
+        else if (arg == "--sizes" && hasValue)
+            options.sizes = parseSizes(argv[++i]);
+        else if (arg == "--json" && hasValue)
+            options.jsonPath = argv[++i];
+        else
+            throw std::runtime_error("Unknown option: " + arg);
+    }
+
+    if (options.sizes.empty())
+        options.sizes = { { 1280, 720 }, { 1920, 1080 }, { 3840, 2160 } };
+    if (options.iterations <= 0)
+        throw std::runtime_error("Iterations must be positive");
+    return options;
+}
+
+static float nextRandom(uint32_t& state)
+{
+    state = state * 1664525u + 1013904223u;
+    return (state >> 8) * (1.0f / 16777216.0f);
+}
+
+/*
+Synthetic detector output : most proposals are background, one in 200 is a confident "person"
+placed around one of a few cluster centres so NMS has overlapping boxes to suppress, like the
+real model produces. Mask prototypes and coefficients are noise, only their cost matters here.
+*/
+static void makeSyntheticYoloOutputs(std::vector<float>& output0, std::vector<int64_t>& output0Shape,
+                                     std::vector<float>& output1, std::vector<int64_t>& output1Shape)
+{
+    const int numFeatures = 4 + NUM_CLASSES + NUM_MASK_CHANNELS;
+    output0Shape = { 1, numFeatures, NUM_PROPOSALS };
+    output1Shape = { 1, NUM_MASK_CHANNELS, MASK_PROTO_SIZE, MASK_PROTO_SIZE };
+    output0.assign(static_cast<size_t>(numFeatures) * NUM_PROPOSALS, 0.0f);
+    output1.resize(static_cast<size_t>(NUM_MASK_CHANNELS) * MASK_PROTO_SIZE * MASK_PROTO_SIZE);
+
+    uint32_t state = 12345u;
+    const float clusters[4][2] = { { 160, 200 }, { 320, 320 }, { 480, 260 }, { 300, 520 } };
+    auto at = [&](int feature, int proposal) -> float& {
+        return output0[static_cast<size_t>(feature) * NUM_PROPOSALS + proposal];
+    };
+
+    for (int i = 0; i < NUM_PROPOSALS; i++)
+    {
+        bool hot = i % 200 == 0;
+        const float* centre = clusters[(i / 200) % 4];
+        at(0, i) = hot ? centre[0] + (nextRandom(state) - 0.5f) * 20.0f : nextRandom(state) * YOLO_INPUT_SIZE;
+        at(1, i) = hot ? centre[1] + (nextRandom(state) - 0.5f) * 20.0f : nextRandom(state) * YOLO_INPUT_SIZE;
+        at(2, i) = hot ? 120.0f + nextRandom(state) * 10.0f : 20.0f + nextRandom(state) * 40.0f;
+        at(3, i) = hot ? 240.0f + nextRandom(state) * 10.0f : 20.0f + nextRandom(state) * 40.0f;
+        for (int c = 0; c < NUM_CLASSES; c++)
+            at(4 + c, i) = nextRandom(state) * 0.05f;
+        if (hot)
+            at(4, i) = 0.9f;
+        for (int c = 0; c < NUM_MASK_CHANNELS; c++)
+            at(4 + NUM_CLASSES + c, i) = nextRandom(state) * 2.0f - 1.0f;
+    }
+
+    for (float& value : output1)
+        value = nextRandom(state) * 2.0f - 1.0f;
+}
+
+static void timeStage(const std::string& stage, int iterations, const std::function<void()>& body)
+{
+    for (int i = 0; i < iterations; i++)
+    {
+        ProfileScope scope(stage);
+        body();
+    }
+}
+
+static CpuBenchResult runSize(int width, int height, const CpuBenchOptions& options)
+{
+    Profiler& profiler = Profiler::instance();
+    profiler.reset();
+
+    std::vector<unsigned char> frame = makeSyntheticFrame(width, height);
+    const std::string ppmPath = "bench_frame.ppm";
+    timeStage("ppm:save", options.iterations, [&] { savePPMImage(ppmPath.c_str(), frame, width, height); });
+
+    std::vector<unsigned char> loaded;
+    int loadedWidth = 0, loadedHeight = 0;
+    timeStage("ppm:load", options.iterations, [&] { loadPPMImage(ppmPath.c_str(), loaded, loadedWidth, loadedHeight); });
+    if (loadedWidth != width || loadedHeight != height || loaded != frame)
+        throw std::runtime_error("PPM round trip mismatch at " + std::to_string(width) + "x" + std::to_string(height));
+
+    for (FrameCodec codec : { FrameCodec::QOI, FrameCodec::LZ4 })
+    {
+        std::string name = frameCodecExtension(codec) + 1;
+        std::string path = "bench_frame" + std::string(frameCodecExtension(codec));
+        timeStage(name + ":save", options.iterations, [&] { saveFrame(path, frame, width, height, codec); });
+        timeStage(name + ":load", options.iterations, [&] { loadFrame(path, loaded, loadedWidth, loadedHeight); });
+        if (loadedWidth != width || loadedHeight != height || loaded != frame)
+            throw std::runtime_error(name + " round trip mismatch at " + std::to_string(width) + "x" + std::to_string(height));
+    }
+
+    std::vector<float> inputTensor;
+    timeStage("yolo:preprocess", options.iterations, [&] { preprocessYoloInput(frame.data(), width, height, 4, inputTensor); });
+
+    std::vector<float> output0, output1;
+    std::vector<int64_t> output0Shape, output1Shape;
+    makeSyntheticYoloOutputs(output0, output0Shape, output1, output1Shape);
+    std::vector<std::string> classLabels = { "person" };
+    for (int c = 1; c < NUM_CLASSES; c++)
+        classLabels.push_back("class" + std::to_string(c));
+    const std::set<std::string> shaderClasses = { "person" };
+
+    std::map<std::string, std::vector<std::vector<unsigned char>>> classMasks;
+    timeStage("yolo:decode", options.iterations, [&] {
+        decodeYoloOutputs(output0.data(), output0Shape, output1.data(), output1Shape, classLabels, shaderClasses,
+                          0.4f, width, height, classMasks);
+    });
+    if (classMasks.empty())
+        throw std::runtime_error("Synthetic YOLO output produced no detections");
+
+    // Time the masks, not debug PPM writes and logging
+    MaskGenerator maskGenerator;
+    maskGenerator.setDebugOutput(false);
+    std::vector<std::pair<std::string, std::vector<unsigned char>>> maskDataList;
+    timeStage("masks:generate", options.iterations, [&] { maskGenerator.generateMasks(classMasks, maskDataList, width, height); });
+
+    CpuBenchResult result;
+    result.width = width;
+    result.height = height;
+    result.stages = profiler.summarize();
+    return result;
+}
+
+static void printTable(const std::vector<CpuBenchResult>& results, std::ostream& out)
+{
+    out << "\nCPU stage latency (ms)\n";
+    out << std::left << std::setw(20) << "stage" << std::setw(12) << "size" << std::right
+        << std::setw(10) << "mean" << std::setw(10) << "p50" << std::setw(10) << "p95"
+        << std::setw(10) << "max" << "\n";
+
+    out << std::fixed << std::setprecision(3);
+    for (const CpuBenchResult& r : results)
+    {
+        for (const auto& [stage, s] : r.stages)
+        {
+            out << std::left << std::setw(20) << stage
+                << std::setw(12) << (std::to_string(r.width) + "x" + std::to_string(r.height)) << std::right
+                << std::setw(10) << s.mean << std::setw(10) << s.p50 << std::setw(10) << s.p95
+                << std::setw(10) << s.max << "\n";
+        }
+    }
+    out << std::defaultfloat;
+}
+
+static void writeJson(const std::vector<CpuBenchResult>& results, const CpuBenchOptions& options)
+{
+    std::ofstream file(options.jsonPath);
+    if (!file)
+        throw std::runtime_error("Failed to open report file: " + options.jsonPath);
+
+    file << std::fixed << std::setprecision(4);
+    file << "{\n  \"iterations\": " << options.iterations << ",\n  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const CpuBenchResult& r = results[i];
+        file << "    {\"width\": " << r.width << ", \"height\": " << r.height << ", \"stages\": ";
+        writeStageStatsJson(file, r.stages);
+        file << "}" << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    file << "  ]\n}\n";
+}
+
+int main(int argc, char* argv[])
+{
+    try
+    {
+        CpuBenchOptions options = parseOptions(argc, argv);
+        if (!options.jsonPath.empty())
+            options.jsonPath = fs::absolute(options.jsonPath).string();
+        Profiler::instance().setEnabled(true);
+
+        fs::path originalDir = fs::current_path();
+        fs::path scratchDir = fs::temp_directory_path() / "nplayer_cpu_bench";
+        fs::create_directories(scratchDir);
+        fs::current_path(scratchDir);
+
+        std::vector<CpuBenchResult> results;
+        for (const auto& [width, height] : options.sizes)
+        {
+            std::cout << "Running CPU stages at " << width << "x" << height << " ..." << std::endl;
+            results.push_back(runSize(width, height, options));
+        }
+
+        fs::current_path(originalDir);
+        fs::remove_all(scratchDir);
+
+        printTable(results, std::cout);
+        if (!options.jsonPath.empty())
+        {
+            writeJson(results, options);
+            std::cout << "Report written to " << options.jsonPath << std::endl;
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -1,9 +1,47 @@
 #pragma once
 
 #include <string>
+#include <cstdint>
 
 namespace Config {
     const std::string SHADER_DIR = "/home/nikhil-saxena/Documents/GitHub/NPlayer/shaders/";
+    // Helper passes (colour conversion, ...), kept out of SHADER_DIR so they are not mistaken for effects
+    const std::string UTILITY_SHADER_DIR = SHADER_DIR + "utility/";
     const std::string ASSET_DIR = "/home/nikhil-saxena/Documents/GitHub/NPlayer/assets/";
     const std::string YOLO_MODEL_PATH = ASSET_DIR + "models/yolov8s-seg.onnx";
-}
\ No newline at end of file
+
+    // Specialization constant ids used by the stylization shaders (ghibli.comp, person.comp)
+    const uint32_t SPEC_LOCAL_SIZE_X = 0;
+    const uint32_t SPEC_LOCAL_SIZE_Y = 1;
+    const uint32_t SPEC_RADIUS = 2;
+    const uint32_t SPEC_SIMILARITY_THRESHOLD = 3;
+    const uint32_t SPEC_QUANTIZE_LEVELS = 4;
+
+    // Per-device / per-quality tuning. Zero keeps whatever default the shader was compiled with.
+    struct ShaderTier {
+        uint32_t localSizeX;
+        uint32_t localSizeY;
+        int radius;
+        float similarityThreshold;
+        int quantizeLevels;
+    };
+
+    const ShaderTier QUALITY_TIER = { 0, 0, 3, 0.95f, 0 };
+    // Tap weights are max(0, RADIUS - distance) / RADIUS, so RADIUS 1 keeps only the centre and
+    // smooths nothing; 2 is the smallest radius that still averages the 3x3 neighbourhood.
+    const ShaderTier REALTIME_TIER = { 0, 0, 2, 0.95f, 4 };
+
+    // Effects of class_map.comp, the single pass shader that shades every detected class at once.
+    // Slot 0 of its class map is the background, so 15 classes fit in one frame.
+    const uint32_t EFFECT_COPY = 0;
+    const uint32_t EFFECT_GRAYSCALE = 1;
+    const uint32_t EFFECT_STYLIZE = 2;
+    const uint32_t EFFECT_GHIBLI = 3;
+    const int CLASS_MAP_SLOTS = 16;
+    // What the class shaders do : grayscale outside the detections, stylize inside
+    const uint32_t CLASS_MAP_BACKGROUND_EFFECT = EFFECT_GRAYSCALE;
+    const uint32_t CLASS_MAP_OBJECT_EFFECT = EFFECT_STYLIZE;
+
+    // Processed frame cache (FrameCache), oldest entries are evicted past this size
+    const uint64_t RESULT_CACHE_MAX_BYTES = 2ull << 30;
+}
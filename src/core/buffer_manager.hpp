@@ -14,6 +14,11 @@ public:
                      VkBuffer& buffer, VkDeviceMemory& bufferMemory);
     void copyDataToBuffer(VkDeviceMemory memory, const void* data, VkDeviceSize size);
 
+    // 2D single-mip optimal-tiling image in device-local memory, plus a matching color view
+    void createImage(uint32_t width, uint32_t height, VkFormat format, VkImageUsageFlags usage,
+                     VkImage& image, VkDeviceMemory& imageMemory);
+    VkImageView createImageView(VkImage image, VkFormat format);
+
 private:
     VulkanEngine& engine;
 
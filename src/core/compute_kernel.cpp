@@ -0,0 +1,129 @@
+#include "compute_kernel.hpp"
+#include "vulkan_engine.hpp"
+#include <stdexcept>
+#include <algorithm>
+
+#define VK_CHECK(result) if (result != VK_SUCCESS) { \
+    fprintf(stderr, "Error: %d at line %d\n", result, __LINE__); \
+    exit(1); \
+}
+
+ComputeKernel::ComputeKernel(VulkanEngine& engine, const std::string& shaderPath)
+    : engine(engine), shaderPath(shaderPath)
+{
+    std::vector<uint32_t> shaderCode = loadSpirvFile(shaderPath);
+    reflection = reflectShader(shaderCode);
+
+    std::vector<VkDescriptorSetLayoutBinding> bindings;
+    for (const auto& reflected : reflection.bindings) {
+        if (reflected.set != 0 || reflected.descriptorType != VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
+            throw std::runtime_error("Kernels only support storage buffers in set 0: " + shaderPath);
+
+        VkDescriptorSetLayoutBinding binding = {};
+        binding.binding = reflected.binding;
+        binding.descriptorType = reflected.descriptorType;
+        binding.descriptorCount = reflected.descriptorCount;
+        binding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        bindings.push_back(binding);
+    }
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = bindings.size();
+    layoutInfo.pBindings = bindings.data();
+    VK_CHECK(vkCreateDescriptorSetLayout(engine.getDevice(), &layoutInfo, nullptr, &descriptorSetLayout));
+
+    uint32_t descriptorCount = 0;
+    for (const auto& reflected : reflection.bindings)
+        descriptorCount += reflected.descriptorCount;
+    VkDescriptorPoolSize poolSize = { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, std::max(descriptorCount, 1u) };
+
+    VkDescriptorPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.maxSets = 1;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    VK_CHECK(vkCreateDescriptorPool(engine.getDevice(), &poolInfo, nullptr, &descriptorPool));
+
+    VkDescriptorSetAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = descriptorPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &descriptorSetLayout;
+    VK_CHECK(vkAllocateDescriptorSets(engine.getDevice(), &allocInfo, &descriptorSet));
+
+    VkPushConstantRange pushConstantRange = {};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = reflection.pushConstantSize;
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = reflection.pushConstantSize > 0 ? 1 : 0;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    VK_CHECK(vkCreatePipelineLayout(engine.getDevice(), &pipelineLayoutInfo, nullptr, &pipelineLayout));
+
+    VkShaderModuleCreateInfo shaderCreateInfo = {};
+    shaderCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    shaderCreateInfo.codeSize = shaderCode.size() * sizeof(uint32_t);
+    shaderCreateInfo.pCode = shaderCode.data();
+
+    VkShaderModule shaderModule;
+    VK_CHECK(vkCreateShaderModule(engine.getDevice(), &shaderCreateInfo, nullptr, &shaderModule));
+
+    VkComputePipelineCreateInfo pipelineInfo = {};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = shaderModule;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = pipelineLayout;
+    VK_CHECK(vkCreateComputePipelines(engine.getDevice(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline));
+
+    vkDestroyShaderModule(engine.getDevice(), shaderModule, nullptr);
+}
+
+ComputeKernel::~ComputeKernel()
+{
+    vkDestroyPipeline(engine.getDevice(), pipeline, nullptr);
+    vkDestroyPipelineLayout(engine.getDevice(), pipelineLayout, nullptr);
+    vkDestroyDescriptorPool(engine.getDevice(), descriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(engine.getDevice(), descriptorSetLayout, nullptr);
+}
+
+void ComputeKernel::bindBuffer(uint32_t binding, VkBuffer buffer, VkDeviceSize range)
+{
+    if (!reflection.findBinding(binding))
+        throw std::runtime_error("Shader has no binding " + std::to_string(binding) + ": " + shaderPath);
+
+    VkDescriptorBufferInfo bufferInfo = {};
+    bufferInfo.buffer = buffer;
+    bufferInfo.offset = 0;
+    bufferInfo.range = range;
+
+    VkWriteDescriptorSet descriptorWrite = {};
+    descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrite.dstSet = descriptorSet;
+    descriptorWrite.dstBinding = binding;
+    descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    descriptorWrite.descriptorCount = 1;
+    descriptorWrite.pBufferInfo = &bufferInfo;
+    vkUpdateDescriptorSets(engine.getDevice(), 1, &descriptorWrite, 0, nullptr);
+}
+
+void ComputeKernel::record(VkCommandBuffer commandBuffer, const void* pushData, uint32_t pushSize,
+                           uint32_t invocationsX, uint32_t invocationsY)
+{
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+
+    pushSize = std::min(pushSize, reflection.pushConstantSize);
+    if (pushSize > 0)
+        vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, pushSize, pushData);
+
+    uint32_t groupsX = (invocationsX + reflection.localSize[0] - 1) / reflection.localSize[0];
+    uint32_t groupsY = (invocationsY + reflection.localSize[1] - 1) / reflection.localSize[1];
+    vkCmdDispatch(commandBuffer, groupsX, groupsY, 1);
+}
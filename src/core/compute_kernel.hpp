@@ -0,0 +1,41 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <string>
+#include <vector>
+#include "shader_reflection.hpp"
+class VulkanEngine;
+
+/*
+Auxiliary compute pass recorded into someone else's command buffer, e.g. the colour conversion
+after the effect shader. Unlike ComputePipeline it owns no frame data : every binding is a
+storage buffer in set 0 supplied by the caller through bindBuffer(), and the layout, push
+constant range and workgroup size all come from the shader's reflection.
+*/
+class ComputeKernel {
+public:
+    ComputeKernel(VulkanEngine& engine, const std::string& shaderPath);
+    ~ComputeKernel();
+
+    ComputeKernel(const ComputeKernel&) = delete;
+    ComputeKernel& operator=(const ComputeKernel&) = delete;
+
+    void bindBuffer(uint32_t binding, VkBuffer buffer, VkDeviceSize range = VK_WHOLE_SIZE);
+
+    // Binds, pushes and dispatches enough workgroups to cover invocationsX x invocationsY.
+    // Barriers around the dispatch are the caller's job.
+    void record(VkCommandBuffer commandBuffer, const void* pushData, uint32_t pushSize,
+                uint32_t invocationsX, uint32_t invocationsY);
+
+    const ShaderReflection& getReflection() const { return reflection; }
+
+private:
+    VulkanEngine& engine;
+    ShaderReflection reflection;
+    VkDescriptorSetLayout descriptorSetLayout;
+    VkDescriptorPool descriptorPool;
+    VkDescriptorSet descriptorSet;
+    VkPipelineLayout pipelineLayout;
+    VkPipeline pipeline;
+    std::string shaderPath;
+};
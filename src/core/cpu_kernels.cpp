@@ -0,0 +1,364 @@
+#include "cpu_kernels.hpp"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define NPLAYER_CPU_NEON
+#endif
+
+namespace {
+    const float LUMA_R = 0.299f, LUMA_G = 0.587f, LUMA_B = 0.114f;
+    const float EDGE_COLOR[3] = { 0.1f, 0.1f, 0.15f };
+    const float EDGE_MIX = 0.7f;
+
+    // packPixel : clamp to [0, 1], scale and truncate
+    unsigned char packChannel(float value)
+    {
+        return static_cast<unsigned char>(std::min(std::max(value, 0.0f), 1.0f) * 255.0f);
+    }
+
+    // Alpha goes through unpackPixel / packPixel in the shaders, which is not always the identity
+    unsigned char packAlpha(unsigned char alpha)
+    {
+        return static_cast<unsigned char>(alpha / 255.0f * 255.0f);
+    }
+
+    void regionAverageScalar(const float* const* r, const float* const* g, const float* const* b, int radius,
+                             const RegionTap* taps, int tapCount, float threshold, int x0, int x1,
+                             float* outR, float* outG, float* outB)
+    {
+        const float* centerR = r[radius];
+        const float* centerG = g[radius];
+        const float* centerB = b[radius];
+        for (int x = x0; x < x1; x++)
+        {
+            float sumR = 0.0f, sumG = 0.0f, sumB = 0.0f, totalWeight = 0.0f;
+            for (int t = 0; t < tapCount; t++)
+            {
+                const RegionTap& tap = taps[t];
+                float nr = r[tap.dy + radius][x + tap.dx];
+                float ng = g[tap.dy + radius][x + tap.dx];
+                float nb = b[tap.dy + radius][x + tap.dx];
+                float difference = std::fabs(nr - centerR[x]) + std::fabs(ng - centerG[x]) + std::fabs(nb - centerB[x]);
+                if (1.0f - difference / 3.0f > threshold)
+                {
+                    sumR += nr * tap.weight;
+                    sumG += ng * tap.weight;
+                    sumB += nb * tap.weight;
+                    totalWeight += tap.weight;
+                }
+            }
+            if (totalWeight > 0.0f)
+            {
+                outR[x] = sumR / totalWeight;
+                outG[x] = sumG / totalWeight;
+                outB[x] = sumB / totalWeight;
+            }
+            else
+            {
+                outR[x] = centerR[x];
+                outG[x] = centerG[x];
+                outB[x] = centerB[x];
+            }
+        }
+    }
+
+    void sobelEdgesScalar(const float* const* luminance, float threshold, int x0, int x1, uint8_t* edges)
+    {
+        const float* top = luminance[0];
+        const float* middle = luminance[1];
+        const float* bottom = luminance[2];
+        for (int x = x0; x < x1; x++)
+        {
+            float sobelX = (top[x + 1] + 2.0f * middle[x + 1] + bottom[x + 1]) - (top[x - 1] + 2.0f * middle[x - 1] + bottom[x - 1]);
+            float sobelY = (bottom[x - 1] + 2.0f * bottom[x] + bottom[x + 1]) - (top[x - 1] + 2.0f * top[x] + top[x + 1]);
+            edges[x] = std::sqrt(sobelX * sobelX + sobelY * sobelY) > threshold;
+        }
+    }
+
+    void grayRowScalar(const unsigned char* rgba, unsigned char* out, int count, const float* weights)
+    {
+        for (int i = 0; i < count; i++, rgba += 4, out += 4)
+        {
+            float gray = rgba[0] * weights[0] + rgba[1] * weights[1] + rgba[2] * weights[2];
+            unsigned char value = static_cast<unsigned char>(std::min(gray, 255.0f));
+            out[0] = out[1] = out[2] = value;
+            out[3] = 255;
+        }
+    }
+
+    void unpackRowScalar(const unsigned char* rgba, int count, float* r, float* g, float* b, float* luminance)
+    {
+        for (int i = 0; i < count; i++, rgba += 4)
+        {
+            r[i] = rgba[0] / 255.0f;
+            g[i] = rgba[1] / 255.0f;
+            b[i] = rgba[2] / 255.0f;
+            luminance[i] = r[i] * LUMA_R + g[i] * LUMA_G + b[i] * LUMA_B;
+        }
+    }
+
+    void quantizeRowScalar(const float* r, const float* g, const float* b, int levels, const uint8_t* edges,
+                           const float* texture, const unsigned char* rgba, int x0, int x1, unsigned char* out)
+    {
+        const float* planes[3] = { r, g, b };
+        float scale = static_cast<float>(levels);
+        for (int x = x0; x < x1; x++)
+        {
+            for (int c = 0; c < 3; c++)
+            {
+                float value = std::floor(planes[c][x] * scale) / scale;
+                if (edges && edges[x])
+                    value = value * (1.0f - EDGE_MIX) + EDGE_COLOR[c] * EDGE_MIX;
+                out[x * 4 + c] = packChannel(value + texture[x]);
+            }
+            out[x * 4 + 3] = packAlpha(rgba[x * 4 + 3]);
+        }
+    }
+
+    void maskBlendRowScalar(const unsigned char* mask, const float* luminance, const unsigned char* rgba, int count,
+                            unsigned char* out)
+    {
+        for (int x = 0; x < count; x++)
+        {
+            if (mask && mask[x * 4 + 3] >= 128)
+                continue;
+            out[x * 4 + 0] = out[x * 4 + 1] = out[x * 4 + 2] = packChannel(luminance[x]);
+            out[x * 4 + 3] = packAlpha(rgba[x * 4 + 3]);
+        }
+    }
+
+#ifdef NPLAYER_CPU_NEON
+    void regionAverageNeon(const float* const* r, const float* const* g, const float* const* b, int radius,
+                           const RegionTap* taps, int tapCount, float threshold, int x0, int x1,
+                           float* outR, float* outG, float* outB)
+    {
+        const float32x4_t zero = vdupq_n_f32(0.0f), one = vdupq_n_f32(1.0f), three = vdupq_n_f32(3.0f);
+        const float32x4_t limit = vdupq_n_f32(threshold);
+        int x = x0;
+        for (; x + 4 <= x1; x += 4)
+        {
+            float32x4_t centerR = vld1q_f32(r[radius] + x);
+            float32x4_t centerG = vld1q_f32(g[radius] + x);
+            float32x4_t centerB = vld1q_f32(b[radius] + x);
+            float32x4_t sumR = zero, sumG = zero, sumB = zero, totalWeight = zero;
+            for (int t = 0; t < tapCount; t++)
+            {
+                const RegionTap& tap = taps[t];
+                float32x4_t nr = vld1q_f32(r[tap.dy + radius] + x + tap.dx);
+                float32x4_t ng = vld1q_f32(g[tap.dy + radius] + x + tap.dx);
+                float32x4_t nb = vld1q_f32(b[tap.dy + radius] + x + tap.dx);
+                float32x4_t difference = vaddq_f32(vaddq_f32(vabsq_f32(vsubq_f32(nr, centerR)), vabsq_f32(vsubq_f32(ng, centerG))),
+                                                   vabsq_f32(vsubq_f32(nb, centerB)));
+                uint32x4_t similar = vcgtq_f32(vsubq_f32(one, vdivq_f32(difference, three)), limit);
+                float32x4_t weight = vbslq_f32(similar, vdupq_n_f32(tap.weight), zero);
+                sumR = vaddq_f32(sumR, vmulq_f32(nr, weight));
+                sumG = vaddq_f32(sumG, vmulq_f32(ng, weight));
+                sumB = vaddq_f32(sumB, vmulq_f32(nb, weight));
+                totalWeight = vaddq_f32(totalWeight, weight);
+            }
+            uint32x4_t any = vcgtq_f32(totalWeight, zero);
+            vst1q_f32(outR + x, vbslq_f32(any, vdivq_f32(sumR, totalWeight), centerR));
+            vst1q_f32(outG + x, vbslq_f32(any, vdivq_f32(sumG, totalWeight), centerG));
+            vst1q_f32(outB + x, vbslq_f32(any, vdivq_f32(sumB, totalWeight), centerB));
+        }
+        regionAverageScalar(r, g, b, radius, taps, tapCount, threshold, x, x1, outR, outG, outB);
+    }
+
+    void sobelEdgesNeon(const float* const* luminance, float threshold, int x0, int x1, uint8_t* edges)
+    {
+        const float* top = luminance[0];
+        const float* middle = luminance[1];
+        const float* bottom = luminance[2];
+        const float32x4_t two = vdupq_n_f32(2.0f), limit = vdupq_n_f32(threshold);
+        int x = x0;
+        for (; x + 4 <= x1; x += 4)
+        {
+            float32x4_t topLeft = vld1q_f32(top + x - 1), topCenter = vld1q_f32(top + x), topRight = vld1q_f32(top + x + 1);
+            float32x4_t left = vld1q_f32(middle + x - 1), right = vld1q_f32(middle + x + 1);
+            float32x4_t bottomLeft = vld1q_f32(bottom + x - 1), bottomCenter = vld1q_f32(bottom + x);
+            float32x4_t bottomRight = vld1q_f32(bottom + x + 1);
+            float32x4_t sobelX = vsubq_f32(vaddq_f32(vaddq_f32(topRight, vmulq_f32(two, right)), bottomRight),
+                                           vaddq_f32(vaddq_f32(topLeft, vmulq_f32(two, left)), bottomLeft));
+            float32x4_t sobelY = vsubq_f32(vaddq_f32(vaddq_f32(bottomLeft, vmulq_f32(two, bottomCenter)), bottomRight),
+                                           vaddq_f32(vaddq_f32(topLeft, vmulq_f32(two, topCenter)), topRight));
+            float32x4_t magnitude = vsqrtq_f32(vaddq_f32(vmulq_f32(sobelX, sobelX), vmulq_f32(sobelY, sobelY)));
+            uint32_t mask[4];
+            vst1q_u32(mask, vcgtq_f32(magnitude, limit));
+            for (int i = 0; i < 4; i++)
+                edges[x + i] = mask[i] & 1;
+        }
+        sobelEdgesScalar(luminance, threshold, x, x1, edges);
+    }
+
+    // Eight RGBA pixels deinterleaved, one channel widened to four floats per half
+    void widenChannel(uint8x8_t channel, float32x4_t& low, float32x4_t& high)
+    {
+        uint16x8_t wide = vmovl_u8(channel);
+        low = vcvtq_f32_u32(vmovl_u16(vget_low_u16(wide)));
+        high = vcvtq_f32_u32(vmovl_u16(vget_high_u16(wide)));
+    }
+
+    void grayRowNeon(const unsigned char* rgba, unsigned char* out, int count, const float* weights)
+    {
+        const float32x4_t weightR = vdupq_n_f32(weights[0]), weightG = vdupq_n_f32(weights[1]);
+        const float32x4_t weightB = vdupq_n_f32(weights[2]), maximum = vdupq_n_f32(255.0f);
+        int i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            uint8x8x4_t pixels = vld4_u8(rgba + i * 4);
+            float32x4_t gray[2];
+            float32x4_t r[2], g[2], b[2];
+            widenChannel(pixels.val[0], r[0], r[1]);
+            widenChannel(pixels.val[1], g[0], g[1]);
+            widenChannel(pixels.val[2], b[0], b[1]);
+            for (int half = 0; half < 2; half++)
+                gray[half] = vminq_f32(vaddq_f32(vaddq_f32(vmulq_f32(r[half], weightR), vmulq_f32(g[half], weightG)),
+                                                 vmulq_f32(b[half], weightB)), maximum);
+            uint16x8_t value = vcombine_u16(vmovn_u32(vcvtq_u32_f32(gray[0])), vmovn_u32(vcvtq_u32_f32(gray[1])));
+            uint8x8x4_t result;
+            result.val[0] = result.val[1] = result.val[2] = vmovn_u16(value);
+            result.val[3] = vdup_n_u8(255);
+            vst4_u8(out + i * 4, result);
+        }
+        grayRowScalar(rgba + i * 4, out + i * 4, count - i, weights);
+    }
+
+    void unpackRowNeon(const unsigned char* rgba, int count, float* r, float* g, float* b, float* luminance)
+    {
+        const float32x4_t scale = vdupq_n_f32(255.0f);
+        const float32x4_t lumaR = vdupq_n_f32(LUMA_R), lumaG = vdupq_n_f32(LUMA_G), lumaB = vdupq_n_f32(LUMA_B);
+        int i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            uint8x8x4_t pixels = vld4_u8(rgba + i * 4);
+            float32x4_t red[2], green[2], blue[2];
+            widenChannel(pixels.val[0], red[0], red[1]);
+            widenChannel(pixels.val[1], green[0], green[1]);
+            widenChannel(pixels.val[2], blue[0], blue[1]);
+            for (int half = 0; half < 2; half++)
+            {
+                float32x4_t pr = vdivq_f32(red[half], scale);
+                float32x4_t pg = vdivq_f32(green[half], scale);
+                float32x4_t pb = vdivq_f32(blue[half], scale);
+                vst1q_f32(r + i + half * 4, pr);
+                vst1q_f32(g + i + half * 4, pg);
+                vst1q_f32(b + i + half * 4, pb);
+                vst1q_f32(luminance + i + half * 4,
+                          vaddq_f32(vaddq_f32(vmulq_f32(pr, lumaR), vmulq_f32(pg, lumaG)), vmulq_f32(pb, lumaB)));
+            }
+        }
+        unpackRowScalar(rgba + i * 4, count - i, r + i, g + i, b + i, luminance + i);
+    }
+
+    // Four floats to packPixel bytes
+    uint32x4_t packChannelNeon(float32x4_t value)
+    {
+        return vcvtq_u32_f32(vmulq_f32(vminq_f32(vmaxq_f32(value, vdupq_n_f32(0.0f)), vdupq_n_f32(1.0f)), vdupq_n_f32(255.0f)));
+    }
+
+    uint8x8_t narrowChannel(uint32x4_t low, uint32x4_t high)
+    {
+        return vmovn_u16(vcombine_u16(vmovn_u32(low), vmovn_u32(high)));
+    }
+
+    uint8x8_t packAlphaNeon(uint8x8_t alpha)
+    {
+        const float32x4_t scale = vdupq_n_f32(255.0f);
+        float32x4_t low, high;
+        widenChannel(alpha, low, high);
+        return narrowChannel(vcvtq_u32_f32(vmulq_f32(vdivq_f32(low, scale), scale)),
+                             vcvtq_u32_f32(vmulq_f32(vdivq_f32(high, scale), scale)));
+    }
+
+    void quantizeRowNeon(const float* r, const float* g, const float* b, int levels, const uint8_t* edges,
+                         const float* texture, const unsigned char* rgba, int x0, int x1, unsigned char* out)
+    {
+        const float* planes[3] = { r, g, b };
+        const float32x4_t scale = vdupq_n_f32(static_cast<float>(levels)), keep = vdupq_n_f32(1.0f - EDGE_MIX);
+        int x = x0;
+        for (; x + 8 <= x1; x += 8)
+        {
+            uint32x4_t isEdge[2] = { vdupq_n_u32(0), vdupq_n_u32(0) };
+            if (edges)
+            {
+                uint16x8_t edge = vmovl_u8(vld1_u8(edges + x));
+                isEdge[0] = vtstq_u32(vmovl_u16(vget_low_u16(edge)), vdupq_n_u32(1));
+                isEdge[1] = vtstq_u32(vmovl_u16(vget_high_u16(edge)), vdupq_n_u32(1));
+            }
+            uint8x8x4_t result;
+            for (int c = 0; c < 3; c++)
+            {
+                const float32x4_t edgeColor = vdupq_n_f32(EDGE_COLOR[c] * EDGE_MIX);
+                uint32x4_t packed[2];
+                for (int half = 0; half < 2; half++)
+                {
+                    float32x4_t value = vdivq_f32(vrndmq_f32(vmulq_f32(vld1q_f32(planes[c] + x + half * 4), scale)), scale);
+                    value = vbslq_f32(isEdge[half], vaddq_f32(vmulq_f32(value, keep), edgeColor), value);
+                    packed[half] = packChannelNeon(vaddq_f32(value, vld1q_f32(texture + x + half * 4)));
+                }
+                result.val[c] = narrowChannel(packed[0], packed[1]);
+            }
+            result.val[3] = packAlphaNeon(vld4_u8(rgba + x * 4).val[3]);
+            vst4_u8(out + x * 4, result);
+        }
+        quantizeRowScalar(r, g, b, levels, edges, texture, rgba, x, x1, out);
+    }
+
+    void maskBlendRowNeon(const unsigned char* mask, const float* luminance, const unsigned char* rgba, int count,
+                          unsigned char* out)
+    {
+        int x = 0;
+        for (; x + 8 <= count; x += 8)
+        {
+            uint8x8_t masked = mask ? vcge_u8(vld4_u8(mask + x * 4).val[3], vdup_n_u8(128)) : vdup_n_u8(0);
+            uint8x8_t gray = narrowChannel(packChannelNeon(vld1q_f32(luminance + x)), packChannelNeon(vld1q_f32(luminance + x + 4)));
+            uint8x8x4_t current = vld4_u8(out + x * 4);
+            uint8x8x4_t result;
+            for (int c = 0; c < 3; c++)
+                result.val[c] = vbsl_u8(masked, current.val[c], gray);
+            result.val[3] = vbsl_u8(masked, current.val[3], packAlphaNeon(vld4_u8(rgba + x * 4).val[3]));
+            vst4_u8(out + x * 4, result);
+        }
+        maskBlendRowScalar(mask ? mask + x * 4 : nullptr, luminance + x, rgba + x * 4, count - x, out + x * 4);
+    }
+
+    const CpuKernels NEON_KERNELS = { "NEON", regionAverageNeon, sobelEdgesNeon, grayRowNeon, unpackRowNeon,
+                                      quantizeRowNeon, maskBlendRowNeon };
+#endif
+
+    const CpuKernels SCALAR_KERNELS = { "scalar", regionAverageScalar, sobelEdgesScalar, grayRowScalar, unpackRowScalar,
+                                        quantizeRowScalar, maskBlendRowScalar };
+
+    const CpuKernels& selectCpuKernels()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        if (__builtin_cpu_supports("avx2") && avx2CpuKernels())
+            return *avx2CpuKernels();
+#endif
+        if (neonCpuKernels())
+            return *neonCpuKernels();
+        return SCALAR_KERNELS;
+    }
+}
+
+const CpuKernels& cpuKernels()
+{
+    static const CpuKernels& kernels = selectCpuKernels();
+    return kernels;
+}
+
+const CpuKernels& scalarCpuKernels()
+{
+    return SCALAR_KERNELS;
+}
+
+const CpuKernels* neonCpuKernels()
+{
+#ifdef NPLAYER_CPU_NEON
+    return &NEON_KERNELS;
+#else
+    return nullptr;
+#endif
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+
+/*
+Row kernels of the CPU backend (see cpu_pipeline). Colours are float planes in [0, 1], one per
+channel, with every row padded on both sides by repeating its edge pixel, so reading x + dx for
+|dx| up to the padding needs no bounds check; rows past the top and bottom of the frame are
+clamped by whoever hands out the row pointers, the same clamp-to-edge the shaders' getColor does.
+
+Each kernel exists as plain C++ and as AVX2 (x86, picked at run time) and NEON (AArch64) versions.
+The vector versions do the same float operations in the same order, no fused multiply-add, so
+every version produces the same bytes.
+*/
+
+// One tap of the region average, only taps with a non-zero weight are listed, in shader order
+struct RegionTap {
+    int dx, dy;
+    float weight;
+};
+
+struct CpuKernels {
+    const char* name;
+
+    /*
+    applyRegionColor's average of the similar neighbours for x in [x0, x1) of one row, before the
+    colour grading. r / g / b are the row pointers for dy = -radius .. radius (index dy + radius).
+    Writes the weighted average, or the centre colour when no tap is similar, at outR[x] ...
+    */
+    void (*regionAverage)(const float* const* r, const float* const* g, const float* const* b, int radius,
+                          const RegionTap* taps, int tapCount, float threshold, int x0, int x1,
+                          float* outR, float* outG, float* outB);
+    // Sobel magnitude of the luminance rows y - 1, y, y + 1 over threshold, 1 or 0 at edges[x] for x in [x0, x1)
+    void (*sobelEdges)(const float* const* luminance, float threshold, int x0, int x1, uint8_t* edges);
+    // count RGBA pixels to grey, trunc(r * weights[0] + g * weights[1] + b * weights[2]) on the bytes, alpha 255
+    void (*grayRow)(const unsigned char* rgba, unsigned char* out, int count, const float* weights);
+    // count RGBA pixels to [0, 1] planes, plus their luminance (0.299, 0.587, 0.114)
+    void (*unpackRow)(const unsigned char* rgba, int count, float* r, float* g, float* b, float* luminance);
+    /*
+    Cel shading of graded colours for x in [x0, x1) : floor(c * levels) / levels, mixed 70% towards
+    the outline colour (0.1, 0.1, 0.15) where edges[x] is set (edges may be null), plus texture[x],
+    packed to RGBA at out[x] with the alpha of rgba[x].
+    */
+    void (*quantizeRow)(const float* r, const float* g, const float* b, int levels, const uint8_t* edges,
+                        const float* texture, const unsigned char* rgba, int x0, int x1, unsigned char* out);
+    // person's background : every one of count pixels whose mask alpha is not over 0.5 (all of them
+    // when mask is null) becomes its luminance in grey with the alpha of rgba, the others keep out
+    void (*maskBlendRow)(const unsigned char* mask, const float* luminance, const unsigned char* rgba, int count,
+                         unsigned char* out);
+};
+
+// The fastest set this CPU can run, chosen once
+const CpuKernels& cpuKernels();
+
+const CpuKernels& scalarCpuKernels();
+// nullptr when not built in. Only call avx2CpuKernels once the CPU is known to have AVX2, its
+// translation unit is compiled for it.
+const CpuKernels* avx2CpuKernels();
+const CpuKernels* neonCpuKernels();
@@ -0,0 +1,205 @@
+#include "cpu_kernels.hpp"
+
+// Built with -mavx2 (see CMakeLists.txt), cpuKernels only hands these out after checking the CPU
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+
+namespace {
+    const float LUMA_R = 0.299f, LUMA_G = 0.587f, LUMA_B = 0.114f;
+    const float EDGE_COLOR[3] = { 0.1f, 0.1f, 0.15f };
+    const float EDGE_MIX = 0.7f;
+
+    inline __m256 absolute(__m256 value)
+    {
+        return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), value);
+    }
+
+    void regionAverageAvx2(const float* const* r, const float* const* g, const float* const* b, int radius,
+                           const RegionTap* taps, int tapCount, float threshold, int x0, int x1,
+                           float* outR, float* outG, float* outB)
+    {
+        const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f), three = _mm256_set1_ps(3.0f);
+        const __m256 limit = _mm256_set1_ps(threshold);
+        int x = x0;
+        for (; x + 8 <= x1; x += 8)
+        {
+            __m256 centerR = _mm256_loadu_ps(r[radius] + x);
+            __m256 centerG = _mm256_loadu_ps(g[radius] + x);
+            __m256 centerB = _mm256_loadu_ps(b[radius] + x);
+            __m256 sumR = zero, sumG = zero, sumB = zero, totalWeight = zero;
+            for (int t = 0; t < tapCount; t++)
+            {
+                const RegionTap& tap = taps[t];
+                __m256 nr = _mm256_loadu_ps(r[tap.dy + radius] + x + tap.dx);
+                __m256 ng = _mm256_loadu_ps(g[tap.dy + radius] + x + tap.dx);
+                __m256 nb = _mm256_loadu_ps(b[tap.dy + radius] + x + tap.dx);
+                __m256 difference = _mm256_add_ps(_mm256_add_ps(absolute(_mm256_sub_ps(nr, centerR)),
+                                                                absolute(_mm256_sub_ps(ng, centerG))),
+                                                  absolute(_mm256_sub_ps(nb, centerB)));
+                __m256 similar = _mm256_cmp_ps(_mm256_sub_ps(one, _mm256_div_ps(difference, three)), limit, _CMP_GT_OQ);
+                __m256 weight = _mm256_and_ps(similar, _mm256_set1_ps(tap.weight));
+                sumR = _mm256_add_ps(sumR, _mm256_mul_ps(nr, weight));
+                sumG = _mm256_add_ps(sumG, _mm256_mul_ps(ng, weight));
+                sumB = _mm256_add_ps(sumB, _mm256_mul_ps(nb, weight));
+                totalWeight = _mm256_add_ps(totalWeight, weight);
+            }
+            __m256 any = _mm256_cmp_ps(totalWeight, zero, _CMP_GT_OQ);
+            _mm256_storeu_ps(outR + x, _mm256_blendv_ps(centerR, _mm256_div_ps(sumR, totalWeight), any));
+            _mm256_storeu_ps(outG + x, _mm256_blendv_ps(centerG, _mm256_div_ps(sumG, totalWeight), any));
+            _mm256_storeu_ps(outB + x, _mm256_blendv_ps(centerB, _mm256_div_ps(sumB, totalWeight), any));
+        }
+        scalarCpuKernels().regionAverage(r, g, b, radius, taps, tapCount, threshold, x, x1, outR, outG, outB);
+    }
+
+    void sobelEdgesAvx2(const float* const* luminance, float threshold, int x0, int x1, uint8_t* edges)
+    {
+        const float* top = luminance[0];
+        const float* middle = luminance[1];
+        const float* bottom = luminance[2];
+        const __m256 two = _mm256_set1_ps(2.0f), limit = _mm256_set1_ps(threshold);
+        int x = x0;
+        for (; x + 8 <= x1; x += 8)
+        {
+            __m256 topLeft = _mm256_loadu_ps(top + x - 1), topCenter = _mm256_loadu_ps(top + x);
+            __m256 topRight = _mm256_loadu_ps(top + x + 1);
+            __m256 left = _mm256_loadu_ps(middle + x - 1), right = _mm256_loadu_ps(middle + x + 1);
+            __m256 bottomLeft = _mm256_loadu_ps(bottom + x - 1), bottomCenter = _mm256_loadu_ps(bottom + x);
+            __m256 bottomRight = _mm256_loadu_ps(bottom + x + 1);
+            __m256 sobelX = _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(topRight, _mm256_mul_ps(two, right)), bottomRight),
+                                          _mm256_add_ps(_mm256_add_ps(topLeft, _mm256_mul_ps(two, left)), bottomLeft));
+            __m256 sobelY = _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(bottomLeft, _mm256_mul_ps(two, bottomCenter)), bottomRight),
+                                          _mm256_add_ps(_mm256_add_ps(topLeft, _mm256_mul_ps(two, topCenter)), topRight));
+            __m256 magnitude = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(sobelX, sobelX), _mm256_mul_ps(sobelY, sobelY)));
+            int mask = _mm256_movemask_ps(_mm256_cmp_ps(magnitude, limit, _CMP_GT_OQ));
+            for (int i = 0; i < 8; i++)
+                edges[x + i] = (mask >> i) & 1;
+        }
+        scalarCpuKernels().sobelEdges(luminance, threshold, x, x1, edges);
+    }
+
+    // Eight RGBA pixels to one float per pixel of the channel at byte offset 0 / 8 / 16 of each pixel
+    inline __m256 channel(__m256i pixels, int shift)
+    {
+        return _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(pixels, shift), _mm256_set1_epi32(0xFF)));
+    }
+
+    void grayRowAvx2(const unsigned char* rgba, unsigned char* out, int count, const float* weights)
+    {
+        const __m256 weightR = _mm256_set1_ps(weights[0]), weightG = _mm256_set1_ps(weights[1]);
+        const __m256 weightB = _mm256_set1_ps(weights[2]), maximum = _mm256_set1_ps(255.0f);
+        const __m256i alphaMask = _mm256_set1_epi32(static_cast<int>(0xFF000000u));
+        int i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rgba + i * 4));
+            __m256 gray = _mm256_min_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(channel(pixels, 0), weightR),
+                                                                    _mm256_mul_ps(channel(pixels, 8), weightG)),
+                                                      _mm256_mul_ps(channel(pixels, 16), weightB)), maximum);
+            __m256i value = _mm256_cvttps_epi32(gray);
+            __m256i result = _mm256_or_si256(_mm256_or_si256(value, _mm256_slli_epi32(value, 8)), _mm256_slli_epi32(value, 16));
+            result = _mm256_or_si256(result, alphaMask);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i * 4), result);
+        }
+        scalarCpuKernels().grayRow(rgba + i * 4, out + i * 4, count - i, weights);
+    }
+
+    void unpackRowAvx2(const unsigned char* rgba, int count, float* r, float* g, float* b, float* luminance)
+    {
+        const __m256 scale = _mm256_set1_ps(255.0f);
+        const __m256 lumaR = _mm256_set1_ps(LUMA_R), lumaG = _mm256_set1_ps(LUMA_G), lumaB = _mm256_set1_ps(LUMA_B);
+        int i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rgba + i * 4));
+            __m256 pr = _mm256_div_ps(channel(pixels, 0), scale);
+            __m256 pg = _mm256_div_ps(channel(pixels, 8), scale);
+            __m256 pb = _mm256_div_ps(channel(pixels, 16), scale);
+            _mm256_storeu_ps(r + i, pr);
+            _mm256_storeu_ps(g + i, pg);
+            _mm256_storeu_ps(b + i, pb);
+            _mm256_storeu_ps(luminance + i, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(pr, lumaR), _mm256_mul_ps(pg, lumaG)),
+                                                          _mm256_mul_ps(pb, lumaB)));
+        }
+        scalarCpuKernels().unpackRow(rgba + i * 4, count - i, r + i, g + i, b + i, luminance + i);
+    }
+
+    // Eight floats to packPixel bytes, one per 32-bit lane
+    inline __m256i packChannel(__m256 value)
+    {
+        __m256 clamped = _mm256_min_ps(_mm256_max_ps(value, _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+        return _mm256_cvttps_epi32(_mm256_mul_ps(clamped, _mm256_set1_ps(255.0f)));
+    }
+
+    // Alpha bytes of eight RGBA pixels through unpackPixel / packPixel, in the top byte of each lane
+    inline __m256i packAlpha(__m256i pixels)
+    {
+        const __m256 scale = _mm256_set1_ps(255.0f);
+        __m256 alpha = _mm256_cvtepi32_ps(_mm256_srli_epi32(pixels, 24));
+        return _mm256_slli_epi32(_mm256_cvttps_epi32(_mm256_mul_ps(_mm256_div_ps(alpha, scale), scale)), 24);
+    }
+
+    void quantizeRowAvx2(const float* r, const float* g, const float* b, int levels, const uint8_t* edges,
+                         const float* texture, const unsigned char* rgba, int x0, int x1, unsigned char* out)
+    {
+        const float* planes[3] = { r, g, b };
+        const __m256 scale = _mm256_set1_ps(static_cast<float>(levels)), keep = _mm256_set1_ps(1.0f - EDGE_MIX);
+        int x = x0;
+        for (; x + 8 <= x1; x += 8)
+        {
+            __m256 isEdge = _mm256_setzero_ps();
+            if (edges)
+            {
+                __m128i edge = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(edges + x));
+                isEdge = _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_cvtepu8_epi32(edge), _mm256_setzero_si256()));
+            }
+            __m256 textureValue = _mm256_loadu_ps(texture + x);
+            __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rgba + x * 4));
+            __m256i result = packAlpha(pixels);
+            for (int c = 0; c < 3; c++)
+            {
+                __m256 value = _mm256_div_ps(_mm256_floor_ps(_mm256_mul_ps(_mm256_loadu_ps(planes[c] + x), scale)), scale);
+                __m256 outlined = _mm256_add_ps(_mm256_mul_ps(value, keep), _mm256_set1_ps(EDGE_COLOR[c] * EDGE_MIX));
+                value = _mm256_blendv_ps(value, outlined, isEdge);
+                result = _mm256_or_si256(result, _mm256_slli_epi32(packChannel(_mm256_add_ps(value, textureValue)), c * 8));
+            }
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + x * 4), result);
+        }
+        scalarCpuKernels().quantizeRow(r, g, b, levels, edges, texture, rgba, x, x1, out);
+    }
+
+    void maskBlendRowAvx2(const unsigned char* mask, const float* luminance, const unsigned char* rgba, int count,
+                          unsigned char* out)
+    {
+        int x = 0;
+        for (; x + 8 <= count; x += 8)
+        {
+            __m256i masked = _mm256_setzero_si256();
+            if (mask)
+            {
+                __m256i maskPixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(mask + x * 4));
+                masked = _mm256_cmpgt_epi32(_mm256_srli_epi32(maskPixels, 24), _mm256_set1_epi32(127));
+            }
+            __m256i gray = packChannel(_mm256_loadu_ps(luminance + x));
+            gray = _mm256_or_si256(_mm256_or_si256(gray, _mm256_slli_epi32(gray, 8)), _mm256_slli_epi32(gray, 16));
+            gray = _mm256_or_si256(gray, packAlpha(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(rgba + x * 4))));
+            __m256i current = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(out + x * 4));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + x * 4), _mm256_blendv_epi8(gray, current, masked));
+        }
+        scalarCpuKernels().maskBlendRow(mask ? mask + x * 4 : nullptr, luminance + x, rgba + x * 4, count - x, out + x * 4);
+    }
+
+    const CpuKernels AVX2_KERNELS = { "AVX2", regionAverageAvx2, sobelEdgesAvx2, grayRowAvx2, unpackRowAvx2,
+                                      quantizeRowAvx2, maskBlendRowAvx2 };
+}
+
+const CpuKernels* avx2CpuKernels()
+{
+    return &AVX2_KERNELS;
+}
+#else
+const CpuKernels* avx2CpuKernels()
+{
+    return nullptr;
+}
+#endif
@@ -0,0 +1,388 @@
+#include "cpu_pipeline.hpp"
+#include "config.h"
+#include <stdexcept>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+namespace {
+    // Bands smaller than this cost more in thread start up than they save
+    const int MIN_BAND_ROWS = 16;
+    // Steps per unit of the pow tables, which cover [0, POW_TABLE_RANGE)
+    const int POW_TABLE_STEPS = 4096;
+    const int POW_TABLE_RANGE = 2;
+    const float EDGE_THRESHOLD = 0.15f;
+    // grayscale.comp's weights, applied to the bytes
+    const float GRAY_WEIGHTS[3] = { 0.3f, 0.59f, 0.11f };
+    const float LUMA_R = 0.299f, LUMA_G = 0.587f, LUMA_B = 0.114f;
+
+    template <typename Body>
+    void forEachBand(int bands, const Body& body)
+    {
+        std::vector<std::thread> threads;
+        for (int band = 1; band < bands; band++)
+            threads.emplace_back(body, band);
+        body(0);
+        for (std::thread& thread : threads)
+            thread.join();
+    }
+
+    int bandStart(int band, int bands, int height)
+    {
+        return static_cast<int>(static_cast<long long>(height) * band / bands);
+    }
+
+    // Frames being shaded right now, --workers runs a pipeline per worker side by side
+    std::atomic<int> activeRuns(0);
+
+    struct ActiveRun {
+        ActiveRun() { activeRuns++; }
+        ~ActiveRun() { activeRuns--; }
+    };
+
+    // The cores split between the frames in flight, so N workers don't start a thread per core each
+    int threadCount()
+    {
+        int cores = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+        return std::max(1, cores / std::max(1, activeRuns.load()));
+    }
+
+    // pow(s, exponent) for the colour curves, interpolated. Saturating colours in [0, 1] by 1.7
+    // keeps them below 1.7, so the table covers every value the shaders can produce.
+    class PowTable {
+    public:
+        explicit PowTable(float exponent) : exponent(exponent), values(POW_TABLE_STEPS * POW_TABLE_RANGE + 1)
+        {
+            for (size_t i = 0; i < values.size(); i++)
+                values[i] = std::pow(static_cast<float>(i) / POW_TABLE_STEPS, exponent);
+        }
+
+        float operator()(float s) const
+        {
+            // pow of a negative base is undefined in GLSL, GPUs give 0 after the clamp
+            if (!(s > 0.0f))
+                return 0.0f;
+            if (s >= POW_TABLE_RANGE)
+                return std::pow(s, exponent);
+            float position = s * POW_TABLE_STEPS;
+            int index = static_cast<int>(position);
+            float fraction = position - index;
+            return values[index] + (values[index + 1] - values[index]) * fraction;
+        }
+
+    private:
+        float exponent;
+        std::vector<float> values;
+    };
+
+    float clamp01(float value)
+    {
+        return std::min(std::max(value, 0.0f), 1.0f);
+    }
+
+    // GLSL mix, x * (1 - a) + y * a
+    float mix(float x, float y, float a)
+    {
+        return x * (1.0f - a) + y * a;
+    }
+
+    // ghibli.comp's enhanceGhibliColor, in place
+    void enhanceGhibli(float& red, float& green, float& blue)
+    {
+        static const PowTable pow08(0.8f), pow085(0.85f);
+        float r = red, g = green, b = blue;
+        float adjusted[3];
+        float luminance = r * LUMA_R + g * LUMA_G + b * LUMA_B;
+        adjusted[0] = pow08(mix(luminance, r, 1.7f)) * 2.0f;
+        adjusted[1] = pow08(mix(luminance, g, 1.7f)) * 2.0f;
+        adjusted[2] = pow085(mix(luminance, b, 1.7f)) * 2.0f;
+
+        if (b > r && b > g)
+        {
+            adjusted[2] *= 1.1f;
+            adjusted[0] *= 0.9f;
+            adjusted[1] *= 0.95f;
+        }
+        else if (r > 0.5f && g > 0.5f && b < 0.5f)
+        {
+            adjusted[0] *= 1.45f;
+            adjusted[1] *= 1.1f;
+        }
+        else if (g > r && g > b)
+        {
+            adjusted[1] *= 1.15f;
+            adjusted[0] *= 1.1f;
+        }
+        red = clamp01(adjusted[0]);
+        green = clamp01(adjusted[1]);
+        blue = clamp01(adjusted[2]);
+    }
+
+    // person.comp's milder enhanceGhibliColor, in place
+    void enhancePerson(float& red, float& green, float& blue)
+    {
+        float r = red, g = green, b = blue;
+        float adjusted[3];
+        float luminance = r * LUMA_R + g * LUMA_G + b * LUMA_B;
+        adjusted[0] = mix(luminance, r, 1.3f) * 1.2f;
+        adjusted[1] = mix(luminance, g, 1.3f) * 1.2f;
+        adjusted[2] = mix(luminance, b, 1.3f) * 1.2f;
+
+        if (b > r && b > g)
+            adjusted[2] *= 1.05f;
+        else if (r > 0.5f && g > 0.5f && b < 0.5f)
+        {
+            adjusted[0] *= 1.1f;
+            adjusted[1] *= 1.05f;
+        }
+        else if (g > r && g > b)
+            adjusted[1] *= 1.1f;
+        red = clamp01(adjusted[0]);
+        green = clamp01(adjusted[1]);
+        blue = clamp01(adjusted[2]);
+    }
+
+    uint32_t specConstantValue(const ShaderReflection& reflection, const SpecializationConstants& specConstants,
+                               uint32_t constantId, uint32_t fallback)
+    {
+        auto it = specConstants.find(constantId);
+        if (it != specConstants.end())
+            return it->second;
+        const ReflectedSpecConstant* constant = reflection.findSpecConstant(constantId);
+        return constant ? constant->defaultValue : fallback;
+    }
+}
+
+CpuPipeline::CpuPipeline(const std::string& shaderName, const ShaderReflection& reflection,
+                         const SpecializationConstants& specConstants)
+    : width(0), height(0)
+{
+    std::string effectName = shaderName;
+    for (const std::string suffix : { "_tiled", "_image" })
+    {
+        if (effectName.size() > suffix.size() &&
+            effectName.compare(effectName.size() - suffix.size(), suffix.size(), suffix) == 0)
+            effectName.erase(effectName.size() - suffix.size());
+    }
+    if (effectName == "grayscale")
+        effect = Effect::Grayscale;
+    else if (effectName == "ghibli")
+        effect = Effect::Ghibli;
+    else if (effectName == "person")
+        effect = Effect::Person;
+    else
+        throw std::runtime_error("No CPU implementation of " + shaderName + " (grayscale, ghibli and person have one)");
+
+    radius = static_cast<int32_t>(specConstantValue(reflection, specConstants, Config::SPEC_RADIUS, 3));
+    uint32_t thresholdBits = specConstantValue(reflection, specConstants, Config::SPEC_SIMILARITY_THRESHOLD,
+                                               specConstantFloat(0.95f));
+    std::memcpy(&similarityThreshold, &thresholdBits, sizeof(similarityThreshold));
+    quantizeLevels = static_cast<int32_t>(specConstantValue(reflection, specConstants, Config::SPEC_QUANTIZE_LEVELS,
+                                                            effect == Effect::Person ? 4 : 6));
+    if (effect != Effect::Grayscale && (radius < 1 || quantizeLevels < 1))
+        throw std::runtime_error("RADIUS and QUANTIZE_LEVELS must be at least 1 for " + shaderName);
+
+    // applyRegionColor's weights, in its loop order. Taps at or past the radius weigh nothing.
+    for (int dy = -radius; dy <= radius && effect != Effect::Grayscale; dy++)
+    {
+        for (int dx = -radius; dx <= radius; dx++)
+        {
+            float distance = std::sqrt(static_cast<float>(dx * dx + dy * dy));
+            float weight = std::max(0.0f, static_cast<float>(radius) - distance) / static_cast<float>(radius);
+            if (weight > 0.0f)
+                taps.push_back({ dx, dy, weight });
+        }
+    }
+}
+
+void CpuPipeline::setDimensions(int w, int h)
+{
+    if (w == width && h == height)
+        return;
+    width = w;
+    height = h;
+
+    // uv is computed in float like the shader, the trigonometry in double so the sum formula holds
+    noiseSinX.resize(std::max(width, 0));
+    noiseCosX.resize(std::max(width, 0));
+    for (int x = 0; x < width; x++)
+    {
+        double angle = static_cast<float>(x) / static_cast<float>(width) * 12.9898f;
+        noiseSinX[x] = std::sin(angle);
+        noiseCosX[x] = std::cos(angle);
+    }
+    noiseSinY.resize(std::max(height, 0));
+    noiseCosY.resize(std::max(height, 0));
+    for (int y = 0; y < height; y++)
+    {
+        double angle = static_cast<float>(y) / static_cast<float>(height) * 78.233f;
+        noiseSinY[y] = std::sin(angle);
+        noiseCosY[y] = std::cos(angle);
+    }
+}
+
+std::string CpuPipeline::describe()
+{
+    return std::string(cpuKernels().name) + ", " + std::to_string(threadCount()) + " threads";
+}
+
+void CpuPipeline::paperTextureRow(int y, int x0, int x1, float* texture) const
+{
+    for (int x = x0; x < x1; x++)
+    {
+        double noise = (noiseSinX[x] * noiseCosY[y] + noiseCosX[x] * noiseSinY[y]) * 43758.5453;
+        noise -= std::floor(noise);
+        texture[x] = static_cast<float>(noise) * 0.02f - 0.01f;
+    }
+}
+
+void CpuPipeline::processImage(const std::vector<unsigned char>& inputData, std::vector<unsigned char>& outputData,
+                               const std::vector<unsigned char>& maskData)
+{
+    run(inputData, outputData, &maskData, 0, height);
+}
+
+void CpuPipeline::processImage(const std::vector<unsigned char>& inputData, std::vector<unsigned char>& outputData)
+{
+    run(inputData, outputData, nullptr, 0, 0);
+}
+
+void CpuPipeline::processImage(const std::vector<unsigned char>& inputData, std::vector<unsigned char>& outputData,
+                               const std::vector<unsigned char>& maskData, const DispatchRegion& region)
+{
+    int firstRow = std::max(region.y, 0);
+    int endRow = std::min(region.y + region.height, height);
+    if (region.width <= 0)
+        endRow = firstRow;
+    run(inputData, outputData, &maskData, firstRow, std::max(firstRow, endRow));
+}
+
+void CpuPipeline::run(const std::vector<unsigned char>& inputData, std::vector<unsigned char>& outputData,
+                      const std::vector<unsigned char>* maskData, int maskFirstRow, int maskEndRow)
+{
+    size_t frameSize = static_cast<size_t>(width) * height * 4;
+    if (width <= 0 || height <= 0)
+        throw std::runtime_error("CPU pipeline used before setDimensions");
+    if (inputData.size() != frameSize)
+        throw std::runtime_error("Input frame is " + std::to_string(inputData.size()) + " bytes, expected " +
+                                 std::to_string(frameSize));
+    // Only person reads a mask, the other effects ignore it like their shaders do
+    const unsigned char* mask = nullptr;
+    if (maskData && effect == Effect::Person)
+    {
+        if (maskData->size() != frameSize)
+            throw std::runtime_error("Mask is " + std::to_string(maskData->size()) + " bytes, expected " +
+                                     std::to_string(frameSize));
+        mask = maskData->data();
+    }
+    outputData.resize(frameSize);
+
+    ActiveRun active;
+    int bandCount = std::max(1, std::min(threadCount(), height / MIN_BAND_ROWS));
+    if (static_cast<int>(bands.size()) != bandCount)
+        bands.resize(bandCount);
+    forEachBand(bandCount, [&](int band)
+    {
+        processBand(bands[band], bandStart(band, bandCount, height), bandStart(band + 1, bandCount, height),
+                    inputData.data(), outputData.data(), mask, maskFirstRow, maskEndRow);
+    });
+}
+
+void CpuPipeline::processBand(Band& band, int firstRow, int endRow, const unsigned char* input, unsigned char* output,
+                              const unsigned char* mask, int maskFirstRow, int maskEndRow)
+{
+    const CpuKernels& kernels = cpuKernels();
+    size_t rowBytes = static_cast<size_t>(width) * 4;
+    if (effect == Effect::Grayscale)
+    {
+        for (int y = firstRow; y < endRow; y++)
+            kernels.grayRow(input + y * rowBytes, output + y * rowBytes, width, GRAY_WEIGHTS);
+        return;
+    }
+
+    // Planes of the band's rows plus the region / Sobel reach on each side, rows beyond the frame
+    // are clamped to its edge like getColor does
+    int pad = std::max(radius, 1);
+    int planeFirst = std::max(0, firstRow - pad), planeEnd = std::min(height, endRow + pad);
+    size_t stride = static_cast<size_t>(width) + 2 * pad;
+    size_t planeSize = (planeEnd - planeFirst) * stride;
+    for (std::vector<float>* plane : { &band.r, &band.g, &band.b, &band.luminance })
+        plane->resize(planeSize);
+    for (std::vector<float>* row : { &band.averageR, &band.averageG, &band.averageB })
+        row->resize(width);
+    band.edges.resize(width);
+
+    for (int y = planeFirst; y < planeEnd; y++)
+    {
+        size_t start = (y - planeFirst) * stride + pad;
+        kernels.unpackRow(input + y * rowBytes, width, band.r.data() + start, band.g.data() + start,
+                          band.b.data() + start, band.luminance.data() + start);
+        for (std::vector<float>* plane : { &band.r, &band.g, &band.b, &band.luminance })
+        {
+            float* row = plane->data() + start;
+            std::fill(row - pad, row, row[0]);
+            std::fill(row + width, row + width + pad, row[width - 1]);
+        }
+    }
+    auto rowOf = [&](const std::vector<float>& plane, int y)
+    {
+        return plane.data() + (std::min(std::max(y, 0), height - 1) - planeFirst) * stride + pad;
+    };
+
+    std::vector<const float*> rowsR(2 * radius + 1), rowsG(2 * radius + 1), rowsB(2 * radius + 1);
+    auto regionAverage = [&](int y, int x0, int x1)
+    {
+        for (int dy = -radius; dy <= radius; dy++)
+        {
+            rowsR[dy + radius] = rowOf(band.r, y + dy);
+            rowsG[dy + radius] = rowOf(band.g, y + dy);
+            rowsB[dy + radius] = rowOf(band.b, y + dy);
+        }
+        kernels.regionAverage(rowsR.data(), rowsG.data(), rowsB.data(), radius, taps.data(), static_cast<int>(taps.size()),
+                              similarityThreshold, x0, x1, band.averageR.data(), band.averageG.data(), band.averageB.data());
+    };
+
+    band.texture.resize(width);
+    for (int y = firstRow; y < endRow; y++)
+    {
+        const unsigned char* in = input + y * rowBytes;
+        unsigned char* out = output + y * rowBytes;
+        if (effect == Effect::Ghibli)
+        {
+            regionAverage(y, 0, width);
+            const float* luminanceRows[3] = { rowOf(band.luminance, y - 1), rowOf(band.luminance, y), rowOf(band.luminance, y + 1) };
+            kernels.sobelEdges(luminanceRows, EDGE_THRESHOLD, 0, width, band.edges.data());
+            for (int x = 0; x < width; x++)
+                enhanceGhibli(band.averageR[x], band.averageG[x], band.averageB[x]);
+            paperTextureRow(y, 0, width, band.texture.data());
+            kernels.quantizeRow(band.averageR.data(), band.averageG.data(), band.averageB.data(), quantizeLevels,
+                                band.edges.data(), band.texture.data(), in, 0, width, out);
+            continue;
+        }
+
+        // Person : the stylized effect over the span of masked pixels (alpha > 0.5), then grey
+        // over everything outside the mask
+        const unsigned char* maskRow = mask && y >= maskFirstRow && y < maskEndRow ? mask + y * rowBytes : nullptr;
+        int spanFirst = width, spanEnd = 0;
+        for (int x = 0; maskRow && x < width; x++)
+        {
+            if (maskRow[x * 4 + 3] >= 128)
+            {
+                spanFirst = std::min(spanFirst, x);
+                spanEnd = x + 1;
+            }
+        }
+        if (spanFirst < spanEnd)
+        {
+            regionAverage(y, spanFirst, spanEnd);
+            for (int x = spanFirst; x < spanEnd; x++)
+                enhancePerson(band.averageR[x], band.averageG[x], band.averageB[x]);
+            paperTextureRow(y, spanFirst, spanEnd, band.texture.data());
+            kernels.quantizeRow(band.averageR.data(), band.averageG.data(), band.averageB.data(), quantizeLevels,
+                                nullptr, band.texture.data(), in, spanFirst, spanEnd, out);
+        }
+        kernels.maskBlendRow(maskRow, rowOf(band.luminance, y), in, width, out);
+    }
+}
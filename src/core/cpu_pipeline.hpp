@@ -0,0 +1,65 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include "pipeline.hpp"
+#include "cpu_kernels.hpp"
+
+/*
+CPU implementation of the stylization shaders, what ComputePipeline runs when the engine has no
+Vulkan device. The effect is picked from the shader's name (grayscale, ghibli, person and their
+_tiled / _image variants) and its RADIUS / SIMILARITY_THRESHOLD / QUANTIZE_LEVELS come from the
+specialization constants, or the defaults compiled into the SPIR-V, like on the GPU.
+
+The frame is split into bands of rows processed on separate threads, the cores shared between the
+frames shaded at the same time (one per --workers worker). Each band unpacks its rows
+(plus the effect's radius above and below) into padded float planes once; the region average,
+Sobel, quantization and mask blend run over whole rows with the SIMD kernels of cpu_kernels, only
+the colour grading (pow, one branch per colour family) stays per pixel. Output matches the shaders
+up to float rounding of pow / sin, which can move a value across a quantization step.
+*/
+class CpuPipeline {
+public:
+    // Throws when the shader is not one of the effects above
+    CpuPipeline(const std::string& shaderName, const ShaderReflection& reflection,
+                const SpecializationConstants& specConstants);
+
+    void processImage(const std::vector<unsigned char>& inputData, std::vector<unsigned char>& outputData,
+                      const std::vector<unsigned char>& maskData);
+    void processImage(const std::vector<unsigned char>& inputData, std::vector<unsigned char>& outputData);
+    // Only rows of the region are searched for masked pixels, the rest get the background
+    void processImage(const std::vector<unsigned char>& inputData, std::vector<unsigned char>& outputData,
+                      const std::vector<unsigned char>& maskData, const DispatchRegion& region);
+    void setDimensions(int width, int height);
+    bool supportsRegionDispatch() const { return effect == Effect::Person; }
+
+    // "AVX2, 8 threads"
+    static std::string describe();
+
+private:
+    enum class Effect { Grayscale, Ghibli, Person };
+
+    // Scratch of one band, kept between frames
+    struct Band {
+        std::vector<float> r, g, b, luminance;
+        std::vector<float> averageR, averageG, averageB, texture;
+        std::vector<uint8_t> edges;
+    };
+
+    Effect effect;
+    int radius;
+    float similarityThreshold;
+    int quantizeLevels;
+    std::vector<RegionTap> taps;
+    int width, height;
+    std::vector<Band> bands;
+    // paperTexture's sin(u * 12.9898 + v * 78.233) as sin / cos of both terms
+    std::vector<double> noiseSinX, noiseCosX, noiseSinY, noiseCosY;
+
+    void run(const std::vector<unsigned char>& inputData, std::vector<unsigned char>& outputData,
+             const std::vector<unsigned char>* maskData, int maskFirstRow, int maskEndRow);
+    void processBand(Band& band, int firstRow, int endRow, const unsigned char* input, unsigned char* output,
+                     const unsigned char* mask, int maskFirstRow, int maskEndRow);
+    void paperTextureRow(int y, int x0, int x1, float* texture) const;
+};
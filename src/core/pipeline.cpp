@@ -1,29 +1,98 @@
 #include "pipeline.hpp"
+#include "cpu_pipeline.hpp"
 #include "vulkan_engine.hpp"
 #include "buffer_manager.hpp"
+#include "profiler.hpp"
+#include "config.h"
 #include <stdexcept>
 #include <cstring>
 #include <fstream>
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
 
 #define VK_CHECK(result) if (result != VK_SUCCESS) { \
     fprintf(stderr, "Error: %d at line %d\n", result, __LINE__); \
     exit(1); \
 }
 
-ComputePipeline::ComputePipeline(VulkanEngine& engine, const std::string& shaderPath, int width, int height)
-    : engine(engine), width(width), height(height) 
+ComputePipeline::ComputePipeline(VulkanEngine& engine, const std::string& shaderPath, int width, int height,
+                                 const SpecializationConstants& specConstants)
+    : engine(engine), specConstants(specConstants), width(width), height(height) 
 {
     inputBuffer = outputBuffer = maskBuffer = VK_NULL_HANDLE;
     inputMemory = outputMemory = maskMemory = VK_NULL_HANDLE;
     descriptorSet = VK_NULL_HANDLE;
+    buffersReady = false;
+    inputImage = outputImage = maskImage = VK_NULL_HANDLE;
+    inputImageMemory = outputImageMemory = maskImageMemory = VK_NULL_HANDLE;
+    inputView = outputView = maskView = VK_NULL_HANDLE;
+    sampler = VK_NULL_HANDLE;
+    queryPool = VK_NULL_HANDLE;
+    name = std::filesystem::path(shaderPath).stem().string();
+    inputFormat = outputFormat = PixelFormat::RGBA;
+    maskFormat = MaskFormat::RGBA;
+    yuvMatrix = YuvMatrix::BT601;
+    yuvInputBuffer = VK_NULL_HANDLE;
+    yuvInputMemory = VK_NULL_HANDLE;
+    yuvOutputBuffer = VK_NULL_HANDLE;
+    yuvOutputMemory = VK_NULL_HANDLE;
+    processingScale = 1.0f;
+    edgeAwareUpsample = true;
+    scaledInputBuffer = scaledOutputBuffer = scaledMaskBuffer = VK_NULL_HANDLE;
+    scaledInputMemory = scaledOutputMemory = scaledMaskMemory = VK_NULL_HANDLE;
+    regionDispatch = false;
+    tileCacheEnabled = false;
+    tileCacheThreshold = 0;
+    tileCacheValid = false;
+    referenceInputBuffer = referenceMaskBuffer = tileFlagBuffer = VK_NULL_HANDLE;
+    referenceInputMemory = referenceMaskMemory = tileFlagMemory = VK_NULL_HANDLE;
+
+    // Layouts and dispatch size come from the shader itself rather than being assumed.
+    std::vector<uint32_t> shaderCode = loadSpirvFile(shaderPath);
+    reflection = reflectShader(shaderCode);
+
+    // A specialized workgroup size replaces the shader's default for dispatch sizing
+    for (int i = 0; i < 3; i++) {
+        auto it = specConstants.find(reflection.localSizeSpecIds[i]);
+        if (it != specConstants.end())
+            reflection.localSize[i] = it->second;
+        if (reflection.localSize[i] == 0)
+            throw std::runtime_error("Workgroup size must be non-zero: " + shaderPath);
+    }
+
+    if (engine.isCpuBackend()) {
+        imageMode = false;
+        cpuPipeline = std::make_unique<CpuPipeline>(name, reflection, specConstants);
+        cpuPipeline->setDimensions(width, height);
+        return;
+    }
+
+    const ReflectedBinding* inputBinding = reflection.findBinding(0);
+    imageMode = inputBinding && inputBinding->descriptorType == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    if (imageMode)
+        createSampler();
 
     createDescriptorSetLayout();
     createDescriptorPool();
-    createPipeline(shaderPath);
+    createPipeline(shaderCode);
+
+    commandPool = engine.createCommandPool();
+    VkFenceCreateInfo fenceInfo = {};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    VK_CHECK(vkCreateFence(engine.getDevice(), &fenceInfo, nullptr, &fence));
 }
 
 ComputePipeline::~ComputePipeline() {
+    if (cpuPipeline)
+        return;
     cleanupBuffers();
+    if (sampler != VK_NULL_HANDLE)
+        vkDestroySampler(engine.getDevice(), sampler, nullptr);
+    if (queryPool != VK_NULL_HANDLE)
+        vkDestroyQueryPool(engine.getDevice(), queryPool, nullptr);
+    vkDestroyFence(engine.getDevice(), fence, nullptr);
+    vkDestroyCommandPool(engine.getDevice(), commandPool, nullptr);
     vkDestroyPipeline(engine.getDevice(), pipeline, nullptr);
     vkDestroyPipelineLayout(engine.getDevice(), pipelineLayout, nullptr);
     vkDestroyDescriptorSetLayout(engine.getDevice(), descriptorSetLayout, nullptr);
@@ -33,73 +102,196 @@ ComputePipeline::~ComputePipeline() {
 void ComputePipeline::setDimensions(int w, int h) {
     width = w;
     height = h;
+    if (cpuPipeline)
+        cpuPipeline->setDimensions(w, h);
+}
+
+void ComputePipeline::setInputFormat(PixelFormat format, YuvMatrix matrix) {
+    if (cpuPipeline && format != PixelFormat::RGBA)
+        throw std::runtime_error("YUV input needs a Vulkan device, the CPU backend takes RGBA frames");
+    if (format != PixelFormat::RGBA && !yuvInputKernel)
+        yuvInputKernel = std::make_unique<ComputeKernel>(engine, Config::UTILITY_SHADER_DIR + "yuv_to_rgba.spv");
+    inputFormat = format;
+    yuvMatrix = matrix;
+}
+
+void ComputePipeline::setOutputFormat(PixelFormat format) {
+    if (cpuPipeline && format != PixelFormat::RGBA)
+        throw std::runtime_error("YUV output needs a Vulkan device, the CPU backend writes RGBA frames");
+    if (format != PixelFormat::RGBA && !yuvOutputKernel)
+        yuvOutputKernel = std::make_unique<ComputeKernel>(engine, Config::UTILITY_SHADER_DIR + "rgba_to_yuv.spv");
+    outputFormat = format;
+}
+
+void ComputePipeline::setMaskFormat(MaskFormat format) {
+    if (cpuPipeline && format == MaskFormat::ClassMap)
+        throw std::runtime_error("Class maps need a Vulkan device");
+    if (format == MaskFormat::ClassMap && (imageMode || isScaled()))
+        throw std::runtime_error("Class maps need a full size buffer shader, " + name + " isn't one");
+    maskFormat = format;
+}
+
+bool ComputePipeline::supportsDispatchOffset() const {
+    // class_map.comp's block is as long, its last two words are effects
+    return !cpuPipeline && !imageMode && maskFormat != MaskFormat::ClassMap &&
+           reflection.pushConstantSize >= OFFSET_PUSH_SIZE;
+}
+
+bool ComputePipeline::supportsRegionDispatch() const {
+    if (cpuPipeline)
+        return cpuPipeline->supportsRegionDispatch();
+    return supportsDispatchOffset() && reflection.pushConstantSize >= REGION_PUSH_SIZE;
+}
+
+void ComputePipeline::setTileCache(bool enabled, int threshold) {
+    if (threshold < 0 || threshold > 255)
+        throw std::runtime_error("Tile cache threshold must be in [0, 255], got " + std::to_string(threshold));
+    // Without a dispatch offset the cache is never active, the CPU backend shades every frame
+    if (enabled && !tileDiffKernel && !cpuPipeline)
+        tileDiffKernel = std::make_unique<ComputeKernel>(engine, Config::UTILITY_SHADER_DIR + "tile_diff.spv");
+    tileCacheEnabled = enabled;
+    tileCacheThreshold = threshold;
+    tileCacheValid = false;
+}
+
+bool ComputePipeline::tileCacheActive() const {
+    return tileCacheEnabled && supportsDispatchOffset() && !isScaled() && maskFormat == MaskFormat::RGBA;
+}
+
+size_t ComputePipeline::getMaskSize() const {
+    size_t pixels = static_cast<size_t>(width) * height;
+    return maskFormat == MaskFormat::ClassMap ? pixels : pixels * 4;
+}
+
+bool ComputePipeline::supportsProcessingScale() const {
+    return !cpuPipeline && !imageMode && maskFormat != MaskFormat::ClassMap;
+}
+
+void ComputePipeline::setProcessingScale(float scale, bool edgeAware) {
+    if (scale <= 0.0f || scale > 1.0f)
+        throw std::runtime_error("Processing scale must be in (0, 1], got " + std::to_string(scale));
+    // The CPU backend always shades at full size, so the quality controller's scale steps do nothing there
+    if (cpuPipeline)
+        return;
+    if (scale < 1.0f && imageMode)
+        throw std::runtime_error("Reduced resolution processing needs a buffer shader, " + name + " samples images");
+    // Averaging class ids makes no sense
+    if (scale < 1.0f && maskFormat == MaskFormat::ClassMap)
+        throw std::runtime_error("Reduced resolution processing doesn't support class maps, " + name + " uses one");
+    if (scale < 1.0f && !downsampleKernel) {
+        downsampleKernel = std::make_unique<ComputeKernel>(engine, Config::UTILITY_SHADER_DIR + "downsample.spv");
+        maskDownsampleKernel = std::make_unique<ComputeKernel>(engine, Config::UTILITY_SHADER_DIR + "downsample.spv");
+        upsampleKernel = std::make_unique<ComputeKernel>(engine, Config::UTILITY_SHADER_DIR + "upsample.spv");
+    }
+    processingScale = scale;
+    edgeAwareUpsample = edgeAware;
+}
+
+int ComputePipeline::getProcessingWidth() const {
+    return isScaled() ? std::max(1, static_cast<int>(width * processingScale)) : width;
+}
+
+int ComputePipeline::getProcessingHeight() const {
+    return isScaled() ? std::max(1, static_cast<int>(height * processingScale)) : height;
+}
+
+size_t ComputePipeline::getOutputSize() const {
+    return pixelFormatFrameSize(outputFormat, width, height);
 }
 
 void ComputePipeline::processImage(const std::vector<unsigned char>& inputData, std::vector<unsigned char>& outputData,
                                   const std::vector<unsigned char>& maskData) {
-    cleanupBuffers();
-    createBuffers(inputData, maskData);
-    createDescriptorSet();
+    if (cpuPipeline) {
+        ProfileScope scope("pipeline:execute");
+        cpuPipeline->processImage(inputData, outputData, maskData);
+        return;
+    }
+    {
+        ProfileScope scope("pipeline:upload");
+        prepareBuffers(inputData, maskData, true);
+    }
+    regionDispatch = false;
     runCompute();
+    readOutput(outputData);
+}
 
-    VkMappedMemoryRange range = {};
-    range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-    range.memory = outputMemory;
-    range.offset = 0;
-    range.size = width * height * 4;
-    vkInvalidateMappedMemoryRanges(engine.getDevice(), 1, &range);
-
-    void* mappedMemory;
-    vkMapMemory(engine.getDevice(), outputMemory, 0, width * height * 4, 0, &mappedMemory);
-    outputData.resize(width * height * 4);
-    memcpy(outputData.data(), mappedMemory, width * height * 4);
-    vkUnmapMemory(engine.getDevice(), outputMemory);
-    //void* mappedMemory;
-    //vkMapMemory(engine.getDevice(), outputMemory, 0, width * height * 4, 0, &mappedMemory);
-    //outputData.resize(width * height * 4);
-    //memcpy(outputData.data(), mappedMemory, width * height * 4);
-    //vkUnmapMemory(engine.getDevice(), outputMemory);
+void ComputePipeline::processImage(const std::vector<unsigned char>& inputData, std::vector<unsigned char>& outputData,
+                                   const std::vector<unsigned char>& maskData, const DispatchRegion& region) {
+    if (cpuPipeline) {
+        ProfileScope scope("pipeline:execute");
+        cpuPipeline->processImage(inputData, outputData, maskData, region);
+        return;
+    }
+    {
+        ProfileScope scope("pipeline:upload");
+        prepareBuffers(inputData, maskData, true);
+    }
+    regionDispatch = true;
+    dispatchRegion = region;
+    runCompute();
+    regionDispatch = false;
+    readOutput(outputData);
 }
 
 void ComputePipeline::processImage(const std::vector<unsigned char>& inputData,
                                    std::vector<unsigned char>& outputData) {
     // Overloaded version without mask
-    cleanupBuffers();
-    createBuffers(inputData); // No maskData
-    createDescriptorSet(false); // No mask
+    if (cpuPipeline) {
+        ProfileScope scope("pipeline:execute");
+        cpuPipeline->processImage(inputData, outputData);
+        return;
+    }
+    {
+        ProfileScope scope("pipeline:upload");
+        prepareBuffers(inputData, {}, false); // No mask
+    }
+    regionDispatch = false;
     runCompute();
+    readOutput(outputData);
+}
+
+void ComputePipeline::readOutput(std::vector<unsigned char>& outputData) {
+    ProfileScope scope("pipeline:readback");
+
+    VkDeviceMemory memory = outputFormat == PixelFormat::RGBA ? outputMemory : yuvOutputMemory;
+    size_t outputSize = getOutputSize();
 
     VkMappedMemoryRange range = {};
     range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-    range.memory = outputMemory;
+    range.memory = memory;
     range.offset = 0;
-    range.size = width * height * 4;
+    range.size = VK_WHOLE_SIZE;
     vkInvalidateMappedMemoryRanges(engine.getDevice(), 1, &range);
 
     void* mappedMemory;
-    vkMapMemory(engine.getDevice(), outputMemory, 0, width * height * 4, 0, &mappedMemory);
-    outputData.resize(width * height * 4);
-    memcpy(outputData.data(), mappedMemory, width * height * 4);
-    vkUnmapMemory(engine.getDevice(), outputMemory);
+    vkMapMemory(engine.getDevice(), memory, 0, outputSize, 0, &mappedMemory);
+    outputData.resize(outputSize);
+    memcpy(outputData.data(), mappedMemory, outputSize);
+    vkUnmapMemory(engine.getDevice(), memory);
 }
 
 void ComputePipeline::createDescriptorSetLayout() {
-    std::vector<VkDescriptorSetLayoutBinding> bindings(3);
+    std::vector<VkDescriptorSetLayoutBinding> bindings;
 
-    bindings[0].binding = 0;
-    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-    bindings[0].descriptorCount = 1;
-    bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    for (const auto& reflected : reflection.bindings) {
+        if (reflected.set != 0)
+            throw std::runtime_error("Only descriptor set 0 is supported, shader uses set " + std::to_string(reflected.set));
 
-    bindings[1].binding = 1;
-    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-    bindings[1].descriptorCount = 1;
-    bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        // Buffer shaders use storage buffers throughout. Image shaders sample the input and mask
+        // (bindings 0 and 2) and imageStore into the output (binding 1).
+        VkDescriptorType expected = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        if (imageMode)
+            expected = reflected.binding == 1 ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        if (reflected.descriptorType != expected)
+            throw std::runtime_error("Unsupported descriptor type at binding " + std::to_string(reflected.binding));
 
-    bindings[2].binding = 2;
-    bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-    bindings[2].descriptorCount = 1;
-    bindings[2].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        VkDescriptorSetLayoutBinding binding = {};
+        binding.binding = reflected.binding;
+        binding.descriptorType = reflected.descriptorType;
+        binding.descriptorCount = reflected.descriptorCount;
+        binding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        bindings.push_back(binding);
+    }
 
     VkDescriptorSetLayoutCreateInfo layoutInfo = {};
     layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
@@ -110,36 +302,32 @@ void ComputePipeline::createDescriptorSetLayout() {
 }
 
 void ComputePipeline::createDescriptorPool() {
-    VkDescriptorPoolSize poolSize = {};
-    poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-    poolSize.descriptorCount = 3;
+    std::vector<VkDescriptorPoolSize> poolSizes;
+    for (const auto& reflected : reflection.bindings) {
+        auto it = std::find_if(poolSizes.begin(), poolSizes.end(),
+                               [&](const VkDescriptorPoolSize& p) { return p.type == reflected.descriptorType; });
+        if (it == poolSizes.end())
+            poolSizes.push_back({ reflected.descriptorType, reflected.descriptorCount });
+        else
+            it->descriptorCount += reflected.descriptorCount;
+    }
 
     VkDescriptorPoolCreateInfo poolInfo = {};
-    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
     poolInfo.maxSets = 1;
     poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
-    poolInfo.poolSizeCount = 1;
-    poolInfo.pPoolSizes = &poolSize;
+    poolInfo.poolSizeCount = poolSizes.size();
+    poolInfo.pPoolSizes = poolSizes.data();
 
     VK_CHECK(vkCreateDescriptorPool(engine.getDevice(), &poolInfo, nullptr, &descriptorPool));
 }
 
-void ComputePipeline::createPipeline(const std::string& shaderPath) 
+void ComputePipeline::createPipeline(const std::vector<uint32_t>& shaderCode) 
 {
-    std::ifstream file(shaderPath, std::ios::ate | std::ios::binary);
-    if (!file.is_open()) 
-    throw std::runtime_error("Failed to open shader file: " + shaderPath);
-
-    size_t fileSize = file.tellg();
-    std::vector<char> shaderCode(fileSize);
-    file.seekg(0);
-    file.read(shaderCode.data(), fileSize);
-    file.close();
-
     VkShaderModuleCreateInfo shaderCreateInfo = {};
     shaderCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    shaderCreateInfo.codeSize = shaderCode.size();
-    shaderCreateInfo.pCode = reinterpret_cast<const uint32_t*>(shaderCode.data());
+    shaderCreateInfo.codeSize = shaderCode.size() * sizeof(uint32_t);
+    shaderCreateInfo.pCode = shaderCode.data();
 
     VkShaderModule shaderModule;
     VK_CHECK(vkCreateShaderModule(engine.getDevice(), &shaderCreateInfo, nullptr, &shaderModule));
@@ -147,23 +335,44 @@ void ComputePipeline::createPipeline(const std::string& shaderPath)
     VkPushConstantRange pushConstantRange = {};
     pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
     pushConstantRange.offset = 0;
-    pushConstantRange.size = sizeof(int) * 2; // Only width and height
+    pushConstantRange.size = reflection.pushConstantSize;
 
     VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
     pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
     pipelineLayoutInfo.setLayoutCount = 1;
     pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
-    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pushConstantRangeCount = reflection.pushConstantSize > 0 ? 1 : 0;
     pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
 
     VK_CHECK(vkCreatePipelineLayout(engine.getDevice(), &pipelineLayoutInfo, nullptr, &pipelineLayout));
 
+    // Only pass the constants this shader actually declares; each one is a single 32-bit word.
+    std::vector<VkSpecializationMapEntry> mapEntries;
+    std::vector<uint32_t> specData;
+    for (const auto& [constantId, value] : specConstants) {
+        if (!reflection.findSpecConstant(constantId))
+            continue;
+        VkSpecializationMapEntry entry = {};
+        entry.constantID = constantId;
+        entry.offset = specData.size() * sizeof(uint32_t);
+        entry.size = sizeof(uint32_t);
+        mapEntries.push_back(entry);
+        specData.push_back(value);
+    }
+
+    VkSpecializationInfo specializationInfo = {};
+    specializationInfo.mapEntryCount = mapEntries.size();
+    specializationInfo.pMapEntries = mapEntries.data();
+    specializationInfo.dataSize = specData.size() * sizeof(uint32_t);
+    specializationInfo.pData = specData.data();
+
     VkComputePipelineCreateInfo pipelineInfo = {};
     pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
     pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
     pipelineInfo.stage.module = shaderModule;
     pipelineInfo.stage.pName = "main";
+    pipelineInfo.stage.pSpecializationInfo = mapEntries.empty() ? nullptr : &specializationInfo;
     pipelineInfo.layout = pipelineLayout;
 
     VK_CHECK(vkCreateComputePipelines(engine.getDevice(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline));
@@ -171,37 +380,186 @@ void ComputePipeline::createPipeline(const std::string& shaderPath)
     vkDestroyShaderModule(engine.getDevice(), shaderModule, nullptr);
 }
 
-// Modified createBuffers with optional maskData
-void ComputePipeline::createBuffers(const std::vector<unsigned char>& inputData,
-                                    const std::vector<unsigned char>& maskData) {
+void ComputePipeline::prepareBuffers(const std::vector<unsigned char>& inputData,
+                                     const std::vector<unsigned char>& maskData, bool maskBinding) {
+    // Shaders that don't declare the mask binding never see it, so don't upload it
+    bool withMask = !maskData.empty() && reflection.findBinding(2);
+    BufferLayout layout = { width, height, inputFormat, outputFormat, maskFormat, maskBinding, withMask, processingScale,
+                            tileCacheActive() };
+    if (!buffersReady || !(layout == bufferLayout)) {
+        cleanupBuffers();
+        createBuffers(withMask);
+        createDescriptorSet(maskBinding);
+        bufferLayout = layout;
+        buffersReady = true;
+    }
+    uploadFrame(inputData, maskData);
+}
+
+void ComputePipeline::uploadFrame(const std::vector<unsigned char>& inputData,
+                                  const std::vector<unsigned char>& maskData) {
+    if (inputData.size() < getInputSize())
+        throw std::runtime_error("Input frame is " + std::to_string(inputData.size()) + " bytes, expected " +
+                                 std::to_string(getInputSize()));
+
+    BufferManager bufferManager(engine);
+    if (inputFormat == PixelFormat::RGBA)
+        bufferManager.copyDataToBuffer(inputMemory, inputData.data(), width * height * 4);
+    else
+        bufferManager.copyDataToBuffer(yuvInputMemory, inputData.data(), getInputSize());
+    if (bufferLayout.withMask) {
+        if (maskData.size() < getMaskSize())
+            throw std::runtime_error("Mask is " + std::to_string(maskData.size()) + " bytes, expected " +
+                                     std::to_string(getMaskSize()));
+        bufferManager.copyDataToBuffer(maskMemory, maskData.data(), getMaskSize());
+    }
+}
+
+// Frame data is copied in by uploadFrame, this only allocates
+void ComputePipeline::createBuffers(bool withMask) {
     VkDeviceSize bufferSize = width * height * 4;
     VkPhysicalDeviceProperties properties;
     vkGetPhysicalDeviceProperties(engine.getPhysicalDevice(), &properties);
     VkDeviceSize alignment = properties.limits.minStorageBufferOffsetAlignment;
     bufferSize = (bufferSize + alignment - 1) & ~(alignment - 1);
 
+    // In image mode the host-visible buffers are only staging for the transfer queue copies
+    VkBufferUsageFlags uploadUsage = imageMode ? VK_BUFFER_USAGE_TRANSFER_SRC_BIT : VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    VkBufferUsageFlags readbackUsage = imageMode ? VK_BUFFER_USAGE_TRANSFER_DST_BIT : VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    if (outputFormat != PixelFormat::RGBA)
+        readbackUsage |= VK_BUFFER_USAGE_STORAGE_BUFFER_BIT; // Read by the conversion kernel
+    bool tileCache = tileCacheActive();
+    if (tileCache)
+        uploadUsage |= VK_BUFFER_USAGE_TRANSFER_SRC_BIT; // Copied into the reference buffers
+
     BufferManager bufferManager(engine);
-    bufferManager.createBuffer(bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-                            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                            inputBuffer, inputMemory);
-    bufferManager.copyDataToBuffer(inputMemory, inputData.data(), width * height * 4);
+    if (inputFormat == PixelFormat::RGBA) {
+        bufferManager.createBuffer(bufferSize, uploadUsage,
+                                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                inputBuffer, inputMemory);
+    } else {
+        // Only the YUV planes cross the bus, the RGBA input is produced on the device by the prologue.
+        // Rounded up to whole words since the kernel reads bytes out of uints.
+        bufferManager.createBuffer((getInputSize() + 3) & ~static_cast<VkDeviceSize>(3), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                yuvInputBuffer, yuvInputMemory);
 
-    bufferManager.createBuffer(bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        bufferManager.createBuffer(bufferSize, uploadUsage | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, inputBuffer, inputMemory);
+        yuvInputKernel->bindBuffer(0, yuvInputBuffer);
+        yuvInputKernel->bindBuffer(1, inputBuffer, width * height * 4);
+    }
+
+    bufferManager.createBuffer(bufferSize, readbackUsage,
                             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
                             outputBuffer, outputMemory);
 
-    if (!maskData.empty()) {
-        bufferManager.createBuffer(bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+    if (withMask) {
+        // Class map bytes are read out of whole words
+        VkDeviceSize maskSize = (getMaskSize() + 3) & ~static_cast<VkDeviceSize>(3);
+        maskSize = (maskSize + alignment - 1) & ~(alignment - 1);
+        bufferManager.createBuffer(maskSize, uploadUsage,
                                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
                                 maskBuffer, maskMemory);
-        bufferManager.copyDataToBuffer(maskMemory, maskData.data(), width * height * 4);
+    }
+
+    if (imageMode)
+        createImages(withMask);
+
+    if (isScaled()) {
+        // Only ever touched by the device : the downsampled input / mask and the effect's output
+        VkDeviceSize scaledSize = static_cast<VkDeviceSize>(getProcessingWidth()) * getProcessingHeight() * 4;
+        scaledSize = (scaledSize + alignment - 1) & ~(alignment - 1);
+        bufferManager.createBuffer(scaledSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                   scaledInputBuffer, scaledInputMemory);
+        bufferManager.createBuffer(scaledSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                   scaledOutputBuffer, scaledOutputMemory);
+        downsampleKernel->bindBuffer(0, inputBuffer, width * height * 4);
+        downsampleKernel->bindBuffer(1, scaledInputBuffer);
+        upsampleKernel->bindBuffer(0, scaledOutputBuffer);
+        upsampleKernel->bindBuffer(1, outputBuffer, width * height * 4);
+        upsampleKernel->bindBuffer(2, inputBuffer, width * height * 4);
+        upsampleKernel->bindBuffer(3, scaledInputBuffer);
+
+        if (withMask) {
+            bufferManager.createBuffer(scaledSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                       scaledMaskBuffer, scaledMaskMemory);
+            maskDownsampleKernel->bindBuffer(0, maskBuffer, width * height * 4);
+            maskDownsampleKernel->bindBuffer(1, scaledMaskBuffer);
+        }
+    }
+
+    if (tileCache) {
+        VkBufferUsageFlags referenceUsage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        bufferManager.createBuffer(bufferSize, referenceUsage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                   referenceInputBuffer, referenceInputMemory);
+        if (withMask)
+            bufferManager.createBuffer(bufferSize, referenceUsage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                       referenceMaskBuffer, referenceMaskMemory);
+
+        size_t tileCount = static_cast<size_t>((width + CACHE_TILE_SIZE - 1) / CACHE_TILE_SIZE) *
+                           ((height + CACHE_TILE_SIZE - 1) / CACHE_TILE_SIZE);
+        bufferManager.createBuffer(tileCount * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                   tileFlagBuffer, tileFlagMemory);
+
+        // Without a mask both mask bindings point at the input, tile_diff doesn't read them
+        tileDiffKernel->bindBuffer(0, inputBuffer, width * height * 4);
+        tileDiffKernel->bindBuffer(1, referenceInputBuffer, width * height * 4);
+        tileDiffKernel->bindBuffer(2, withMask ? maskBuffer : inputBuffer, width * height * 4);
+        tileDiffKernel->bindBuffer(3, withMask ? referenceMaskBuffer : inputBuffer, width * height * 4);
+        tileDiffKernel->bindBuffer(4, tileFlagBuffer);
+    }
+
+    if (outputFormat != PixelFormat::RGBA) {
+        if (!supportsYuvOutput(width, height))
+            throw std::runtime_error("YUV output needs a width divisible by 8 and an even height, got " +
+                                     std::to_string(width) + "x" + std::to_string(height));
+        bufferManager.createBuffer(getOutputSize(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                yuvOutputBuffer, yuvOutputMemory);
+        yuvOutputKernel->bindBuffer(0, outputBuffer, width * height * 4);
+        yuvOutputKernel->bindBuffer(1, yuvOutputBuffer);
     }
 }
 
-// Overloaded version of createBuffers (no mask)
-void ComputePipeline::createBuffers(const std::vector<unsigned char>& inputData) {
-    std::vector<unsigned char> dummy;
-    createBuffers(inputData, dummy);
+void ComputePipeline::createImages(bool withMask) {
+    BufferManager bufferManager(engine);
+    bufferManager.createImage(width, height, VK_FORMAT_R8G8B8A8_UNORM,
+                              VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+                              inputImage, inputImageMemory);
+    inputView = bufferManager.createImageView(inputImage, VK_FORMAT_R8G8B8A8_UNORM);
+
+    bufferManager.createImage(width, height, VK_FORMAT_R8G8B8A8_UNORM,
+                              VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                              outputImage, outputImageMemory);
+    outputView = bufferManager.createImageView(outputImage, VK_FORMAT_R8G8B8A8_UNORM);
+
+    if (withMask) {
+        bufferManager.createImage(width, height, VK_FORMAT_R8G8B8A8_UNORM,
+                                  VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+                                  maskImage, maskImageMemory);
+        maskView = bufferManager.createImageView(maskImage, VK_FORMAT_R8G8B8A8_UNORM);
+    }
+}
+
+void ComputePipeline::createSampler() {
+    // Hardware clamp-to-edge replaces the shaders' manual coordinate clamping
+    VkSamplerCreateInfo samplerInfo = {};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.maxAnisotropy = 1.0f;
+    samplerInfo.minLod = 0.0f;
+    samplerInfo.maxLod = 0.0f;
+    samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK;
+    samplerInfo.unnormalizedCoordinates = VK_FALSE;
+
+    VK_CHECK(vkCreateSampler(engine.getDevice(), &samplerInfo, nullptr, &sampler));
 }
 
 // Modified createDescriptorSet with optional mask toggle
@@ -214,32 +572,57 @@ void ComputePipeline::createDescriptorSet(bool useMask) {
 
     VK_CHECK(vkAllocateDescriptorSets(engine.getDevice(), &allocInfo, &descriptorSet));
 
-    std::vector<VkDescriptorBufferInfo> bufferInfos(3);
-    bufferInfos[0].buffer = inputBuffer;
-    bufferInfos[0].offset = 0;
-    bufferInfos[0].range = width * height * 4;
+    // Binding 0 is the input frame, 1 the output frame and 2 the (optional) mask.
+    std::vector<VkDescriptorBufferInfo> bufferInfos(reflection.bindings.size());
+    std::vector<VkDescriptorImageInfo> imageInfos(reflection.bindings.size());
+    std::vector<VkWriteDescriptorSet> descriptorWrites(reflection.bindings.size());
+    for (size_t i = 0; i < reflection.bindings.size(); i++) {
+        uint32_t binding = reflection.bindings[i].binding;
+        if (binding > 2)
+            throw std::runtime_error("Shader uses unsupported binding " + std::to_string(binding));
+        if (binding == 2 && useMask && !maskBuffer)
+            throw std::runtime_error("Mask buffer is null in createDescriptorSet");
 
-    bufferInfos[1].buffer = outputBuffer;
-    bufferInfos[1].offset = 0;
-    bufferInfos[1].range = width * height * 4;
-
-    if (useMask) {
-        if (!maskBuffer) throw std::runtime_error("Mask buffer is null in createDescriptorSet");
-        bufferInfos[2].buffer = maskBuffer;
-    } else {
-        bufferInfos[2].buffer = inputBuffer; // Dummy fallback: same as input
-    }
-    bufferInfos[2].offset = 0;
-    bufferInfos[2].range = width * height * 4;
-
-    std::vector<VkWriteDescriptorSet> descriptorWrites(3);
-    for (int i = 0; i < 3; i++) {
+        descriptorWrites[i] = {};
         descriptorWrites[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
         descriptorWrites[i].dstSet = descriptorSet;
-        descriptorWrites[i].dstBinding = i;
-        descriptorWrites[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        descriptorWrites[i].dstBinding = binding;
+        descriptorWrites[i].descriptorType = reflection.bindings[i].descriptorType;
         descriptorWrites[i].descriptorCount = 1;
-        descriptorWrites[i].pBufferInfo = &bufferInfos[i];
+
+        if (imageMode) {
+            imageInfos[i].sampler = binding == 1 ? VK_NULL_HANDLE : sampler;
+            if (binding == 0)
+                imageInfos[i].imageView = inputView;
+            else if (binding == 1)
+                imageInfos[i].imageView = outputView;
+            else
+                imageInfos[i].imageView = useMask ? maskView : inputView; // Dummy fallback: same as input
+            imageInfos[i].imageLayout = binding == 1 ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            descriptorWrites[i].pImageInfo = &imageInfos[i];
+        } else if (isScaled()) {
+            if (binding == 0)
+                bufferInfos[i].buffer = scaledInputBuffer;
+            else if (binding == 1)
+                bufferInfos[i].buffer = scaledOutputBuffer;
+            else
+                bufferInfos[i].buffer = useMask ? scaledMaskBuffer : scaledInputBuffer;
+            bufferInfos[i].offset = 0;
+            bufferInfos[i].range = static_cast<VkDeviceSize>(getProcessingWidth()) * getProcessingHeight() * 4;
+            descriptorWrites[i].pBufferInfo = &bufferInfos[i];
+        } else {
+            if (binding == 0)
+                bufferInfos[i].buffer = inputBuffer;
+            else if (binding == 1)
+                bufferInfos[i].buffer = outputBuffer;
+            else
+                bufferInfos[i].buffer = useMask ? maskBuffer : inputBuffer; // Dummy fallback: same as input
+            bufferInfos[i].offset = 0;
+            bufferInfos[i].range = width * height * 4;
+            if (binding == 2 && useMask)
+                bufferInfos[i].range = (getMaskSize() + 3) & ~static_cast<VkDeviceSize>(3);
+            descriptorWrites[i].pBufferInfo = &bufferInfos[i];
+        }
     }
 
     vkUpdateDescriptorSets(engine.getDevice(), descriptorWrites.size(), descriptorWrites.data(), 0, nullptr);
@@ -250,10 +633,10 @@ void ComputePipeline::createDescriptorSet() {
     createDescriptorSet(true);
 }
 
-void ComputePipeline::runCompute() {
+VkCommandBuffer ComputePipeline::beginCommands() {
     VkCommandBufferAllocateInfo allocInfo = {};
     allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    allocInfo.commandPool = engine.getCommandPool();
+    allocInfo.commandPool = commandPool;
     allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
     allocInfo.commandBufferCount = 1;
 
@@ -265,48 +648,438 @@ void ComputePipeline::runCompute() {
     beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
     VK_CHECK(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+    return commandBuffer;
+}
 
-    VkMemoryBarrier barrierBefore = {};
-    barrierBefore.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
-    barrierBefore.srcAccessMask = VK_ACCESS_HOST_WRITE_BIT;
-    barrierBefore.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+// Ends, submits and waits for the command buffer, then hands it back to the pool
+void ComputePipeline::submitCommands(VkCommandBuffer commandBuffer) {
+    VK_CHECK(vkEndCommandBuffer(commandBuffer));
 
-    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_HOST_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-                         0, 1, &barrierBefore, 0, nullptr, 0, nullptr);
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+
+    engine.submit(submitInfo, fence);
+    VK_CHECK(vkWaitForFences(engine.getDevice(), 1, &fence, VK_TRUE, UINT64_MAX));
+    VK_CHECK(vkResetFences(engine.getDevice(), 1, &fence));
+
+    vkFreeCommandBuffers(engine.getDevice(), commandPool, 1, &commandBuffer);
+}
+
+void ComputePipeline::runCompute() {
+    ProfileScope scope("pipeline:execute");
+
+    // With a cached previous frame the uploads and the tile comparison go first, on their own,
+    // since the host needs the dirty tiles before it can record the effect
+    bool tileCache = tileCacheActive();
+    bool cached = tileCache && tileCacheValid;
+    if (cached)
+        findDirtyTiles();
+
+    // Timestamps are only recorded while profiling and when the queue supports them
+    bool timed = Profiler::instance().isEnabled() && engine.getTimestampPeriod() > 0.0f;
+    if (timed && queryPool == VK_NULL_HANDLE) {
+        VkQueryPoolCreateInfo queryPoolInfo = {};
+        queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        queryPoolInfo.queryCount = TIMESTAMP_COUNT;
+        VK_CHECK(vkCreateQueryPool(engine.getDevice(), &queryPoolInfo, nullptr, &queryPool));
+    }
+
+    VkCommandBuffer commandBuffer = beginCommands();
+
+    if (timed) {
+        vkCmdResetQueryPool(commandBuffer, queryPool, 0, TIMESTAMP_COUNT);
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, 0);
+    }
+
+    if (!cached)
+        recordUploads(commandBuffer);
+    if (isScaled())
+        recordDownsample(commandBuffer);
+    if (timed)
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 1);
 
     vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
     vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
 
     //float pushConstants[3] = { static_cast<float>(width), static_cast<float>(height), 1.0f }; // Brightness default
     //vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants), pushConstants);
-    int pushConstants[2] = { width, height };
-    vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants), pushConstants);
-    uint32_t groupSizeX = (width + 15) / 16;
-    uint32_t groupSizeY = (height + 15) / 16;
+    if (cached)
+        recordCachedEffect(commandBuffer);
+    else
+        recordEffect(commandBuffer);
+    if (tileCache)
+        recordReferenceUpdate(commandBuffer);
+    if (isScaled())
+        recordUpsample(commandBuffer);
+    if (timed)
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 2);
+
+    recordReadback(commandBuffer);
+    if (timed)
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 3);
+
+    double submitMs = Profiler::instance().nowMs();
+    submitCommands(commandBuffer);
+    tileCacheValid = tileCache;
+
+    if (timed)
+        recordGpuTimings(submitMs);
+}
+
+// Pixels around a pixel that its effect reads : the RADIUS neighbourhood plus one for edge filters
+int ComputePipeline::tileCacheHalo() const {
+    int radius = 0;
+    auto value = specConstants.find(Config::SPEC_RADIUS);
+    if (value != specConstants.end())
+        radius = static_cast<int>(value->second);
+    else if (const ReflectedSpecConstant* constant = reflection.findSpecConstant(Config::SPEC_RADIUS))
+        radius = static_cast<int>(constant->defaultValue);
+    return radius + 1;
+}
+
+// Uploads the frame, runs tile_diff against the reference buffers and turns the flags into runs
+// of dirty tiles per tile row, dilated so every tile whose neighbourhood changed is reshaded
+void ComputePipeline::findDirtyTiles() {
+    ProfileScope scope("pipeline:tile-diff");
+    int tilesX = (width + CACHE_TILE_SIZE - 1) / CACHE_TILE_SIZE;
+    int tilesY = (height + CACHE_TILE_SIZE - 1) / CACHE_TILE_SIZE;
+
+    VkCommandBuffer commandBuffer = beginCommands();
+    recordUploads(commandBuffer);
+    // One 16x16 workgroup per tile, see tile_diff.comp
+    uint32_t pushConstants[4] = { static_cast<uint32_t>(width), static_cast<uint32_t>(height),
+                                  static_cast<uint32_t>(tileCacheThreshold), bufferLayout.withMask ? 1u : 0u };
+    tileDiffKernel->record(commandBuffer, pushConstants, sizeof(pushConstants), tilesX * 16, tilesY * 16);
+
+    VkMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+                         0, 1, &barrier, 0, nullptr, 0, nullptr);
+    submitCommands(commandBuffer);
+
+    std::vector<uint32_t> flags(static_cast<size_t>(tilesX) * tilesY);
+    void* mappedMemory;
+    VK_CHECK(vkMapMemory(engine.getDevice(), tileFlagMemory, 0, flags.size() * sizeof(uint32_t), 0, &mappedMemory));
+    memcpy(flags.data(), mappedMemory, flags.size() * sizeof(uint32_t));
+    vkUnmapMemory(engine.getDevice(), tileFlagMemory);
+
+    int dilation = (tileCacheHalo() + CACHE_TILE_SIZE - 1) / CACHE_TILE_SIZE;
+    std::vector<bool> dirty(flags.size(), false);
+    for (int ty = 0; ty < tilesY; ty++) {
+        for (int tx = 0; tx < tilesX; tx++) {
+            if (!flags[static_cast<size_t>(ty) * tilesX + tx])
+                continue;
+            for (int y = std::max(0, ty - dilation); y <= std::min(tilesY - 1, ty + dilation); y++)
+                for (int x = std::max(0, tx - dilation); x <= std::min(tilesX - 1, tx + dilation); x++)
+                    dirty[static_cast<size_t>(y) * tilesX + x] = true;
+        }
+    }
+
+    dirtySpans.clear();
+    size_t dirtyCount = 0;
+    for (int ty = 0; ty < tilesY; ty++) {
+        for (int tx = 0; tx < tilesX;) {
+            if (!dirty[static_cast<size_t>(ty) * tilesX + tx]) {
+                tx++;
+                continue;
+            }
+            int end = tx;
+            while (end < tilesX && dirty[static_cast<size_t>(ty) * tilesX + end])
+                end++;
+            int x = tx * CACHE_TILE_SIZE;
+            int y = ty * CACHE_TILE_SIZE;
+            dirtySpans.push_back({ x, y, std::min(end * CACHE_TILE_SIZE, width) - x, std::min(CACHE_TILE_SIZE, height - y) });
+            dirtyCount += end - tx;
+            tx = end;
+        }
+    }
+
+    tileCacheStats.frames++;
+    tileCacheStats.tiles += flags.size();
+    tileCacheStats.cleanTiles += flags.size() - dirtyCount;
+}
+
+// The full effect over the dirty spans only, clean tiles keep what the output buffer holds
+void ComputePipeline::recordCachedEffect(VkCommandBuffer commandBuffer) {
+    int pushConstants[5] = { width, height, 0, 0, 0 };
+    uint32_t pushSize = std::min<uint32_t>(sizeof(pushConstants), reflection.pushConstantSize);
+    for (const DispatchRegion& span : dirtySpans) {
+        pushConstants[2] = span.x;
+        pushConstants[3] = span.y;
+        vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, pushSize, pushConstants);
+        uint32_t groupSizeX = (span.width + reflection.localSize[0] - 1) / reflection.localSize[0];
+        uint32_t groupSizeY = (span.height + reflection.localSize[1] - 1) / reflection.localSize[1];
+        vkCmdDispatch(commandBuffer, groupSizeX, groupSizeY, 1);
+    }
+}
+
+// What the output now corresponds to : the whole frame after a full dispatch, else the dirty spans
+void ComputePipeline::recordReferenceUpdate(VkCommandBuffer commandBuffer) {
+    std::vector<VkBufferCopy> regions;
+    if (!tileCacheValid) {
+        regions.push_back({ 0, 0, static_cast<VkDeviceSize>(width) * height * 4 });
+    } else {
+        for (const DispatchRegion& span : dirtySpans) {
+            for (int y = span.y; y < span.y + span.height; y++) {
+                VkDeviceSize offset = (static_cast<VkDeviceSize>(y) * width + span.x) * 4;
+                regions.push_back({ offset, offset, static_cast<VkDeviceSize>(span.width) * 4 });
+            }
+        }
+    }
+    if (regions.empty())
+        return;
+
+    // The input was written by the host or the YUV prologue
+    VkMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_HOST_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    vkCmdCopyBuffer(commandBuffer, inputBuffer, referenceInputBuffer, regions.size(), regions.data());
+    if (bufferLayout.withMask)
+        vkCmdCopyBuffer(commandBuffer, maskBuffer, referenceMaskBuffer, regions.size(), regions.data());
+
+    // Read by the next frame's tile_diff
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void ComputePipeline::recordGpuTimings(double submitMs) {
+    uint64_t timestamps[TIMESTAMP_COUNT];
+    VK_CHECK(vkGetQueryPoolResults(engine.getDevice(), queryPool, 0, TIMESTAMP_COUNT, sizeof(timestamps), timestamps,
+                                   sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+
+    // GPU ticks -> ms, placed on the CPU timeline relative to the submit for the trace
+    double msPerTick = engine.getTimestampPeriod() / 1.0e6;
+    const char* phases[TIMESTAMP_COUNT - 1] = { "upload", "dispatch", "readback" };
+    Profiler& profiler = Profiler::instance();
+    for (uint32_t i = 0; i + 1 < TIMESTAMP_COUNT; i++) {
+        double startMs = submitMs + (timestamps[i] - timestamps[0]) * msPerTick;
+        double durationMs = (timestamps[i + 1] - timestamps[i]) * msPerTick;
+        profiler.record("gpu:" + name + ":" + phases[i], startMs, durationMs, true);
+    }
+}
+
+static void transitionImage(VkCommandBuffer commandBuffer, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout,
+                            VkAccessFlags srcAccess, VkAccessFlags dstAccess,
+                            VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage) {
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstAccessMask = dstAccess;
+    barrier.oldLayout = oldLayout;
+    barrier.newLayout = newLayout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+    vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+static void copyBufferToImage(VkCommandBuffer commandBuffer, VkBuffer buffer, VkImage image, int width, int height) {
+    VkBufferImageCopy region = {};
+    region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+    region.imageExtent = { static_cast<uint32_t>(width), static_cast<uint32_t>(height), 1 };
+    vkCmdCopyBufferToImage(commandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+}
+
+void ComputePipeline::recordUploads(VkCommandBuffer commandBuffer) {
+    // Host writes are first read by the staging copies (image mode) or the shaders
+    bool yuvInput = inputFormat != PixelFormat::RGBA;
+    VkPipelineStageFlags consumerStage = imageMode ? VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    VkAccessFlags consumerAccess = imageMode ? VK_ACCESS_TRANSFER_READ_BIT : VK_ACCESS_SHADER_READ_BIT;
+    if (yuvInput) {
+        consumerStage |= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+        consumerAccess |= VK_ACCESS_SHADER_READ_BIT;
+    }
+
+    VkMemoryBarrier barrierBefore = {};
+    barrierBefore.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrierBefore.srcAccessMask = VK_ACCESS_HOST_WRITE_BIT;
+    barrierBefore.dstAccessMask = consumerAccess;
+
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_HOST_BIT, consumerStage,
+                         0, 1, &barrierBefore, 0, nullptr, 0, nullptr);
+
+    if (yuvInput) {
+        // Prologue : YUV planes -> RGBA input buffer, one invocation per pixel
+        uint32_t pushConstants[4] = { static_cast<uint32_t>(width), static_cast<uint32_t>(height),
+                                      inputFormat == PixelFormat::NV12 ? 1u : 0u,
+                                      yuvMatrix == YuvMatrix::BT709 ? 1u : 0u };
+        yuvInputKernel->record(commandBuffer, pushConstants, sizeof(pushConstants), width, height);
+
+        VkMemoryBarrier converted = {};
+        converted.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        converted.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        converted.dstAccessMask = imageMode ? VK_ACCESS_TRANSFER_READ_BIT : VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             imageMode ? VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             0, 1, &converted, 0, nullptr, 0, nullptr);
+    }
+
+    if (!imageMode)
+        return;
+
+    // Staging buffers -> optimal-tiling images, then into the layouts the shader expects
+    std::vector<std::pair<VkBuffer, VkImage>> uploads = { { inputBuffer, inputImage } };
+    if (maskImage != VK_NULL_HANDLE)
+        uploads.push_back({ maskBuffer, maskImage });
+
+    for (const auto& [buffer, image] : uploads) {
+        transitionImage(commandBuffer, image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                        0, VK_ACCESS_TRANSFER_WRITE_BIT,
+                        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+        copyBufferToImage(commandBuffer, buffer, image, width, height);
+        transitionImage(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                        VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+                        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+    }
+
+    transitionImage(commandBuffer, outputImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+                    0, VK_ACCESS_SHADER_WRITE_BIT,
+                    VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+}
+
+// Full resolution input (and mask) -> processing resolution, ahead of the effect
+void ComputePipeline::recordDownsample(VkCommandBuffer commandBuffer) {
+    int pushConstants[4] = { width, height, getProcessingWidth(), getProcessingHeight() };
+    downsampleKernel->record(commandBuffer, pushConstants, sizeof(pushConstants), pushConstants[2], pushConstants[3]);
+    if (scaledMaskBuffer != VK_NULL_HANDLE)
+        maskDownsampleKernel->record(commandBuffer, pushConstants, sizeof(pushConstants), pushConstants[2], pushConstants[3]);
+
+    VkMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+// Effect at processing resolution. With a region the first dispatch is the backgroundOnly pass
+// over the whole frame and the second redoes only the workgroups covering the region, so the
+// expensive branch costs object area rather than frame area and the output matches a single pass.
+void ComputePipeline::recordEffect(VkCommandBuffer commandBuffer) {
+    int processingWidth = getProcessingWidth();
+    int processingHeight = getProcessingHeight();
+    bool region = regionDispatch && supportsRegionDispatch();
+
+    // { width, height } followed by the region block or the caller's words, zero filled up to the
+    // shader's block size. Shaders with the short block only see the first two values.
+    std::vector<int> pushConstants(std::max<size_t>(5, 2 + pushConstantWords.size()), 0);
+    pushConstants[0] = processingWidth;
+    pushConstants[1] = processingHeight;
+    if (region)
+        pushConstants[4] = 1;
+    else
+        std::copy(pushConstantWords.begin(), pushConstantWords.end(), pushConstants.begin() + 2);
+    uint32_t pushSize = std::min<uint32_t>(pushConstants.size() * sizeof(int), reflection.pushConstantSize);
+    if (pushSize > 0)
+        vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, pushSize, pushConstants.data());
+
+    // One invocation per pixel, workgroup size as declared by the shader's local_size
+    uint32_t groupSizeX = (processingWidth + reflection.localSize[0] - 1) / reflection.localSize[0];
+    uint32_t groupSizeY = (processingHeight + reflection.localSize[1] - 1) / reflection.localSize[1];
     vkCmdDispatch(commandBuffer, groupSizeX, groupSizeY, 1);
+    if (!region)
+        return;
+
+    // Region in processing coordinates : every low resolution pixel whose footprint touches it,
+    // plus one pixel for the downsample's rounding
+    int x0 = static_cast<int>(std::floor(dispatchRegion.x * processingScale)) - (isScaled() ? 1 : 0);
+    int y0 = static_cast<int>(std::floor(dispatchRegion.y * processingScale)) - (isScaled() ? 1 : 0);
+    int x1 = static_cast<int>(std::ceil((dispatchRegion.x + dispatchRegion.width) * processingScale)) + (isScaled() ? 1 : 0);
+    int y1 = static_cast<int>(std::ceil((dispatchRegion.y + dispatchRegion.height) * processingScale)) + (isScaled() ? 1 : 0);
+    x0 = std::max(x0, 0);
+    y0 = std::max(y0, 0);
+    x1 = std::min(x1, processingWidth);
+    y1 = std::min(y1, processingHeight);
+    if (x1 <= x0 || y1 <= y0)
+        return;
+
+    // Both passes write the same output pixels inside the region
+    VkMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    pushConstants[2] = x0;
+    pushConstants[3] = y0;
+    pushConstants[4] = 0;
+    vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, REGION_PUSH_SIZE, pushConstants.data());
+    groupSizeX = (x1 - x0 + reflection.localSize[0] - 1) / reflection.localSize[0];
+    groupSizeY = (y1 - y0 + reflection.localSize[1] - 1) / reflection.localSize[1];
+    vkCmdDispatch(commandBuffer, groupSizeX, groupSizeY, 1);
+}
+
+// Effect output at processing resolution -> outputBuffer, so readback and YUV output see a full frame
+void ComputePipeline::recordUpsample(VkCommandBuffer commandBuffer) {
+    VkMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    int pushConstants[5] = { width, height, getProcessingWidth(), getProcessingHeight(), edgeAwareUpsample ? 1 : 0 };
+    upsampleKernel->record(commandBuffer, pushConstants, sizeof(pushConstants), width, height);
+}
+
+void ComputePipeline::recordReadback(VkCommandBuffer commandBuffer) {
+    // Whoever wrote the RGBA result last : the effect shader, or the image -> buffer copy
+    VkPipelineStageFlags producerStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    VkAccessFlags producerAccess = VK_ACCESS_SHADER_WRITE_BIT;
+
+    if (imageMode) {
+        transitionImage(commandBuffer, outputImage, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                        VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+                        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+        VkBufferImageCopy region = {};
+        region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+        region.imageExtent = { static_cast<uint32_t>(width), static_cast<uint32_t>(height), 1 };
+        vkCmdCopyImageToBuffer(commandBuffer, outputImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, outputBuffer, 1, &region);
+
+        producerStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        producerAccess = VK_ACCESS_TRANSFER_WRITE_BIT;
+    }
 
     VkMemoryBarrier memoryBarrier = {};
     memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
-    memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
-    memoryBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
 
-    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
-                         0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+    if (outputFormat != PixelFormat::RGBA) {
+        memoryBarrier.srcAccessMask = producerAccess;
+        memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, producerStage, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
 
-    VK_CHECK(vkEndCommandBuffer(commandBuffer));
+        // One invocation per 8x2 block, see rgba_to_yuv.comp
+        uint32_t pushConstants[3] = { static_cast<uint32_t>(width), static_cast<uint32_t>(height),
+                                      outputFormat == PixelFormat::NV12 ? 1u : 0u };
+        yuvOutputKernel->record(commandBuffer, pushConstants, sizeof(pushConstants), width / 8, height / 2);
 
-    VkSubmitInfo submitInfo = {};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &commandBuffer;
-
-    VK_CHECK(vkQueueSubmit(engine.getComputeQueue(), 1, &submitInfo, VK_NULL_HANDLE));
-    VK_CHECK(vkQueueWaitIdle(engine.getComputeQueue()));
+        producerStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+        producerAccess = VK_ACCESS_SHADER_WRITE_BIT;
+    }
 
-    vkFreeCommandBuffers(engine.getDevice(), engine.getCommandPool(), 1, &commandBuffer);
+    memoryBarrier.srcAccessMask = producerAccess;
+    memoryBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, producerStage, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
 }
 
 void ComputePipeline::cleanupBuffers() {
+    buffersReady = false;
     if (descriptorSet != VK_NULL_HANDLE) {
         vkFreeDescriptorSets(engine.getDevice(), descriptorPool, 1, &descriptorSet);
         descriptorSet = VK_NULL_HANDLE;
@@ -335,4 +1108,59 @@ void ComputePipeline::cleanupBuffers() {
         vkFreeMemory(engine.getDevice(), maskMemory, nullptr);
         maskMemory = VK_NULL_HANDLE;
     }
+    if (yuvInputBuffer != VK_NULL_HANDLE) {
+        vkDestroyBuffer(engine.getDevice(), yuvInputBuffer, nullptr);
+        yuvInputBuffer = VK_NULL_HANDLE;
+    }
+    if (yuvInputMemory != VK_NULL_HANDLE) {
+        vkFreeMemory(engine.getDevice(), yuvInputMemory, nullptr);
+        yuvInputMemory = VK_NULL_HANDLE;
+    }
+    if (yuvOutputBuffer != VK_NULL_HANDLE) {
+        vkDestroyBuffer(engine.getDevice(), yuvOutputBuffer, nullptr);
+        yuvOutputBuffer = VK_NULL_HANDLE;
+    }
+    if (yuvOutputMemory != VK_NULL_HANDLE) {
+        vkFreeMemory(engine.getDevice(), yuvOutputMemory, nullptr);
+        yuvOutputMemory = VK_NULL_HANDLE;
+    }
+    tileCacheValid = false;
+    VkBuffer* scaledBuffers[] = { &scaledInputBuffer, &scaledOutputBuffer, &scaledMaskBuffer,
+                                  &referenceInputBuffer, &referenceMaskBuffer, &tileFlagBuffer };
+    for (VkBuffer* buffer : scaledBuffers) {
+        if (*buffer != VK_NULL_HANDLE) {
+            vkDestroyBuffer(engine.getDevice(), *buffer, nullptr);
+            *buffer = VK_NULL_HANDLE;
+        }
+    }
+    VkDeviceMemory* scaledMemories[] = { &scaledInputMemory, &scaledOutputMemory, &scaledMaskMemory,
+                                         &referenceInputMemory, &referenceMaskMemory, &tileFlagMemory };
+    for (VkDeviceMemory* memory : scaledMemories) {
+        if (*memory != VK_NULL_HANDLE) {
+            vkFreeMemory(engine.getDevice(), *memory, nullptr);
+            *memory = VK_NULL_HANDLE;
+        }
+    }
+
+    VkImageView* views[] = { &inputView, &outputView, &maskView };
+    for (VkImageView* view : views) {
+        if (*view != VK_NULL_HANDLE) {
+            vkDestroyImageView(engine.getDevice(), *view, nullptr);
+            *view = VK_NULL_HANDLE;
+        }
+    }
+    VkImage* images[] = { &inputImage, &outputImage, &maskImage };
+    for (VkImage* image : images) {
+        if (*image != VK_NULL_HANDLE) {
+            vkDestroyImage(engine.getDevice(), *image, nullptr);
+            *image = VK_NULL_HANDLE;
+        }
+    }
+    VkDeviceMemory* memories[] = { &inputImageMemory, &outputImageMemory, &maskImageMemory };
+    for (VkDeviceMemory* memory : memories) {
+        if (*memory != VK_NULL_HANDLE) {
+            vkFreeMemory(engine.getDevice(), *memory, nullptr);
+            *memory = VK_NULL_HANDLE;
+        }
+    }
 }
\ No newline at end of file
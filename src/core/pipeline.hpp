@@ -3,17 +3,117 @@
 #include <vulkan/vulkan.h>
 #include <vector>
 #include <string>
+#include <map>
+#include <cstring>
+#include <memory>
+#include "shader_reflection.hpp"
+#include "compute_kernel.hpp"
 class VulkanEngine;
+class CpuPipeline;
 
+// Specialization constant values keyed by constant_id. Every value is passed as a raw 32-bit
+// word, use specConstantFloat() for float constants and 0/1 for bools.
+using SpecializationConstants = std::map<uint32_t, uint32_t>;
+
+inline uint32_t specConstantFloat(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+// Layout of frames crossing the host boundary : packed RGBA, or 4:2:0 YUV converted on the GPU
+enum class PixelFormat { RGBA, I420, NV12 };
+enum class YuvMatrix { BT601, BT709 };
+// Binding 2 : an RGBA mask per class, or one byte per pixel naming the class (class_map.comp)
+enum class MaskFormat { RGBA, ClassMap };
+
+// Bytes in one tightly packed frame, chroma planes rounded up for odd sizes like ffmpeg's rawvideo
+inline size_t pixelFormatFrameSize(PixelFormat format, int width, int height)
+{
+    if (format == PixelFormat::RGBA)
+        return static_cast<size_t>(width) * height * 4;
+    return static_cast<size_t>(width) * height + 2 * static_cast<size_t>((width + 1) / 2) * ((height + 1) / 2);
+}
+
+// Pixel rectangle in frame coordinates, an empty one (width or height 0) covers nothing
+struct DispatchRegion {
+    int x, y, width, height;
+};
+
+// Temporal tile cache counters, tiles only count frames that had a previous one to compare with
+struct TileCacheStats {
+    size_t frames = 0;
+    size_t tiles = 0;
+    size_t cleanTiles = 0;
+};
+
+/*
+Runs one compute shader over frames. On an engine without a Vulkan device (VulkanEngine::isCpuBackend)
+the effect runs on the CPU instead (see cpu_pipeline), which only covers the stylization shaders at
+full size with RGBA frames and masks : YUV formats and class maps need the device, processing
+scale and the tile cache are ignored.
+*/
 class ComputePipeline {
 public:
-    ComputePipeline(VulkanEngine& engine, const std::string& shaderPath, int width, int height);
+    ComputePipeline(VulkanEngine& engine, const std::string& shaderPath, int width, int height,
+                    const SpecializationConstants& specConstants = {});
     ~ComputePipeline();
 
     void processImage(const std::vector<unsigned char>& inputData, std::vector<unsigned char>& outputData,
                       const std::vector<unsigned char>& maskData);
     void processImage(const std::vector<unsigned char>& inputData, std::vector<unsigned char>& outputData);
+    // Masked effect over the region only : one cheap backgroundOnly pass over the whole frame, then
+    // the full effect dispatched over the workgroups covering the region. The region must hold every
+    // masked pixel. Shaders that don't support it (see supportsRegionDispatch) ignore the region.
+    void processImage(const std::vector<unsigned char>& inputData, std::vector<unsigned char>& outputData,
+                      const std::vector<unsigned char>& maskData, const DispatchRegion& region);
     void setDimensions(int width, int height);
+    const ShaderReflection& getReflection() const { return reflection; }
+    // Told apart by the reflected push block : buffer shaders whose block goes on past { width, height }
+    // with { offsetX, offsetY } take a dispatch offset, those adding backgroundOnly a region as well
+    bool supportsDispatchOffset() const;
+    bool supportsRegionDispatch() const;
+
+    /*
+    Temporal tile cache for static footage. tile_diff.comp compares every 32x32 tile of the frame
+    (and mask) with the frame the current output was shaded from, the dirty set is dilated by the
+    effect's RADIUS and only dirty tiles are dispatched; clean tiles keep last frame's result,
+    which is still in the output buffer. threshold (0..255) is the largest per channel change a
+    tile may see and stay clean, 0 gives output identical to shading every frame. Full size
+    RGBA-masked buffer shaders with a dispatch offset only, others keep shading the whole frame.
+    */
+    void setTileCache(bool enabled, int threshold = 0);
+    const TileCacheStats& getTileCacheStats() const { return tileCacheStats; }
+
+    // YUV input is uploaded as decoded and expanded to RGBA by yuv_to_rgba before the effect
+    void setInputFormat(PixelFormat format, YuvMatrix matrix = YuvMatrix::BT601);
+    PixelFormat getInputFormat() const { return inputFormat; }
+    size_t getInputSize() const { return pixelFormatFrameSize(inputFormat, width, height); }
+
+    // YUV output runs rgba_to_yuv after the effect and only reads back 1.5 bytes per pixel
+    void setOutputFormat(PixelFormat format);
+    PixelFormat getOutputFormat() const { return outputFormat; }
+    size_t getOutputSize() const;
+    // The conversion shader packs 8x2 pixel blocks into whole words
+    static bool supportsYuvOutput(int width, int height) { return width % 8 == 0 && height % 2 == 0; }
+
+    // Class maps are w * h bytes, packed four to a word on the device. Full size buffer shaders only.
+    void setMaskFormat(MaskFormat format);
+    MaskFormat getMaskFormat() const { return maskFormat; }
+    size_t getMaskSize() const;
+
+    // Words pushed after { width, height } for shaders that take extra parameters
+    void setPushConstantWords(const std::vector<uint32_t>& words) { pushConstantWords = words; }
+
+    // Runs the effect at this fraction of the frame size : downsample.comp shrinks the input (and
+    // mask) on the device and upsample.comp brings the result back before readback, bilinear or
+    // guided by the full resolution input. Buffer shaders only, 1 turns it off.
+    void setProcessingScale(float scale, bool edgeAware = true);
+    float getProcessingScale() const { return processingScale; }
+    // False for image shaders and class map masks, which setProcessingScale refuses below 1, and for
+    // the CPU backend, which ignores it
+    bool supportsProcessingScale() const;
 
 private:
     VulkanEngine& engine;
@@ -24,15 +124,117 @@ private:
     VkBuffer inputBuffer, outputBuffer, maskBuffer;
     VkDeviceMemory inputMemory, outputMemory, maskMemory;
     VkDescriptorSet descriptorSet;
+    // Per pipeline so pipelines on different worker threads never share a pool
+    VkCommandPool commandPool;
+    VkFence fence;
+
+    // Image path : used when the shader samples its input (binding 0 is a sampler2D) and writes
+    // a storage image. The buffers above then only act as upload / readback staging.
+    bool imageMode;
+    VkImage inputImage, outputImage, maskImage;
+    VkDeviceMemory inputImageMemory, outputImageMemory, maskImageMemory;
+    VkImageView inputView, outputView, maskView;
+    VkSampler sampler;
+
+    // GPU timestamps : start, after uploads, after dispatch, after readback copy
+    static const uint32_t TIMESTAMP_COUNT = 4;
+    VkQueryPool queryPool;
+    std::string name;
+
+    PixelFormat inputFormat;
+    YuvMatrix yuvMatrix;
+    std::unique_ptr<ComputeKernel> yuvInputKernel;
+    VkBuffer yuvInputBuffer;
+    VkDeviceMemory yuvInputMemory;
+
+    MaskFormat maskFormat;
+    std::vector<uint32_t> pushConstantWords;
+
+    PixelFormat outputFormat;
+    std::unique_ptr<ComputeKernel> yuvOutputKernel;
+    VkBuffer yuvOutputBuffer;
+    VkDeviceMemory yuvOutputMemory;
+
+    // Reduced resolution processing, the effect's descriptor set points at the scaled buffers
+    float processingScale;
+    bool edgeAwareUpsample;
+    std::unique_ptr<ComputeKernel> downsampleKernel, maskDownsampleKernel, upsampleKernel;
+    VkBuffer scaledInputBuffer, scaledOutputBuffer, scaledMaskBuffer;
+    VkDeviceMemory scaledInputMemory, scaledOutputMemory, scaledMaskMemory;
+
+    // Tile cache : reference copies of the input / mask the cached output came from, and the
+    // dirty flags tile_diff writes for the host
+    static const int CACHE_TILE_SIZE = 32;
+    bool tileCacheEnabled;
+    int tileCacheThreshold;
+    bool tileCacheValid;
+    std::unique_ptr<ComputeKernel> tileDiffKernel;
+    VkBuffer referenceInputBuffer, referenceMaskBuffer, tileFlagBuffer;
+    VkDeviceMemory referenceInputMemory, referenceMaskMemory, tileFlagMemory;
+    std::vector<DispatchRegion> dirtySpans;
+    TileCacheStats tileCacheStats;
+
+    // Region for the next runCompute, set per frame by the region overload of processImage
+    // Push block sizes of { width, height, offsetX, offsetY } and of that plus backgroundOnly
+    static const uint32_t OFFSET_PUSH_SIZE = 4 * sizeof(int);
+    static const uint32_t REGION_PUSH_SIZE = 5 * sizeof(int);
+    bool regionDispatch;
+    DispatchRegion dispatchRegion;
+
+    ShaderReflection reflection;
+    SpecializationConstants specConstants;
     int width, height;
 
+    // Set instead of any Vulkan object when the engine has no device
+    std::unique_ptr<CpuPipeline> cpuPipeline;
+
+    // What the current buffers and descriptor set were built for. Frames that match only copy
+    // their data in, so a steady stream of same sized frames allocates nothing after the first.
+    struct BufferLayout {
+        int width, height;
+        PixelFormat inputFormat, outputFormat;
+        MaskFormat maskFormat;
+        bool maskBinding, withMask;
+        float processingScale;
+        bool tileCache;
+
+        bool operator==(const BufferLayout& other) const {
+            return width == other.width && height == other.height && inputFormat == other.inputFormat &&
+                   outputFormat == other.outputFormat && maskFormat == other.maskFormat && maskBinding == other.maskBinding && withMask == other.withMask &&
+                   processingScale == other.processingScale && tileCache == other.tileCache;
+        }
+    };
+    bool buffersReady;
+    BufferLayout bufferLayout;
+
     void createDescriptorSetLayout();
     void createDescriptorPool();
-    void createPipeline(const std::string& shaderPath);
-    void createBuffers(const std::vector<unsigned char>& inputData, const std::vector<unsigned char>& maskData);
-    void createBuffers(const std::vector<unsigned char>& inputData);
+    void createPipeline(const std::vector<uint32_t>& shaderCode);
+    void createBuffers(bool withMask);
+    void prepareBuffers(const std::vector<unsigned char>& inputData, const std::vector<unsigned char>& maskData,
+                        bool maskBinding);
+    void uploadFrame(const std::vector<unsigned char>& inputData, const std::vector<unsigned char>& maskData);
     void createDescriptorSet();
     void createDescriptorSet(bool useMask);
+    void createImages(bool withMask);
+    void createSampler();
+    void recordUploads(VkCommandBuffer commandBuffer);
+    void recordReadback(VkCommandBuffer commandBuffer);
+    bool isScaled() const { return processingScale < 1.0f; }
+    int getProcessingWidth() const;
+    int getProcessingHeight() const;
+    void recordDownsample(VkCommandBuffer commandBuffer);
+    void recordUpsample(VkCommandBuffer commandBuffer);
+    void recordEffect(VkCommandBuffer commandBuffer);
+    bool tileCacheActive() const;
+    int tileCacheHalo() const;
+    void findDirtyTiles();
+    void recordCachedEffect(VkCommandBuffer commandBuffer);
+    void recordReferenceUpdate(VkCommandBuffer commandBuffer);
+    VkCommandBuffer beginCommands();
+    void submitCommands(VkCommandBuffer commandBuffer);
     void runCompute();
+    void readOutput(std::vector<unsigned char>& outputData);
+    void recordGpuTimings(double submitMs);
     void cleanupBuffers();
 };
\ No newline at end of file
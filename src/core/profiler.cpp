@@ -0,0 +1,149 @@
+#include "profiler.hpp"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <stdexcept>
+#include <thread>
+
+Profiler& Profiler::instance()
+{
+    static Profiler profiler;
+    return profiler;
+}
+
+Profiler::Profiler() : enabled(false), traceEnabled(false), epoch(std::chrono::steady_clock::now()) {}
+
+void Profiler::setEnabled(bool enabled)
+{
+    this->enabled = enabled;
+}
+
+void Profiler::setTraceEnabled(bool enabled)
+{
+    traceEnabled = enabled;
+    if (enabled)
+        this->enabled = true;
+}
+
+double Profiler::nowMs() const
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+void Profiler::record(const std::string& stage, double startMs, double durationMs, bool gpu)
+{
+    if (!enabled)
+        return;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    samples[stage].push_back(durationMs);
+    if (traceEnabled)
+        events.push_back({ stage, startMs, durationMs, gpu, std::hash<std::thread::id>()(std::this_thread::get_id()) });
+}
+
+// Nearest-rank percentile of an already sorted sample set
+static double percentile(const std::vector<double>& sorted, double p)
+{
+    size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * sorted.size()));
+    return sorted[std::min(sorted.size() - 1, rank > 0 ? rank - 1 : 0)];
+}
+
+std::map<std::string, Profiler::StageStats> Profiler::summarize() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::map<std::string, StageStats> stats;
+    for (const auto& [stage, values] : samples)
+    {
+        if (values.empty())
+            continue;
+        std::vector<double> sorted = values;
+        std::sort(sorted.begin(), sorted.end());
+        double total = 0.0;
+        for (double v : sorted)
+            total += v;
+
+        stats[stage] = { sorted.size(), total / sorted.size(), percentile(sorted, 50),
+                         percentile(sorted, 95), percentile(sorted, 99), sorted.back() };
+    }
+    return stats;
+}
+
+void Profiler::printSummary(std::ostream& out) const
+{
+    std::map<std::string, StageStats> stats = summarize();
+    if (stats.empty())
+        return;
+
+    out << "\nTiming summary (ms)\n";
+    out << std::left << std::setw(36) << "stage" << std::right
+        << std::setw(8) << "count" << std::setw(10) << "mean" << std::setw(10) << "p50"
+        << std::setw(10) << "p95" << std::setw(10) << "p99" << std::setw(10) << "max" << "\n";
+
+    out << std::fixed << std::setprecision(3);
+    for (const auto& [stage, s] : stats)
+    {
+        out << std::left << std::setw(36) << stage << std::right
+            << std::setw(8) << s.count << std::setw(10) << s.mean << std::setw(10) << s.p50
+            << std::setw(10) << s.p95 << std::setw(10) << s.p99 << std::setw(10) << s.max << "\n";
+    }
+    out << std::defaultfloat;
+}
+
+void Profiler::reset()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    samples.clear();
+    events.clear();
+}
+
+static std::string escapeJson(const std::string& text)
+{
+    std::string escaped;
+    for (char c : text) {
+        if (c == '"' || c == '\\')
+            escaped += '\\';
+        escaped += c;
+    }
+    return escaped;
+}
+
+void Profiler::writeChromeTrace(const std::string& path) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::ofstream file(path);
+    if (!file)
+        throw std::runtime_error("Failed to open trace file: " + path);
+
+    // Trace Event Format, complete ("X") events with microsecond timestamps.
+    // CPU threads go under pid 0, the GPU queue gets its own pid so it shows as a separate lane.
+    std::map<size_t, int> threadIds;
+    file << "{\"traceEvents\":[\n";
+    file << std::fixed << std::setprecision(3);
+    for (size_t i = 0; i < events.size(); i++)
+    {
+        const Event& e = events[i];
+        int tid = 0;
+        if (!e.gpu) {
+            auto it = threadIds.find(e.thread);
+            if (it == threadIds.end())
+                it = threadIds.emplace(e.thread, static_cast<int>(threadIds.size())).first;
+            tid = it->second;
+        }
+        file << "{\"name\":\"" << escapeJson(e.stage) << "\",\"cat\":\"" << (e.gpu ? "gpu" : "cpu")
+             << "\",\"ph\":\"X\",\"ts\":" << e.startMs * 1000.0 << ",\"dur\":" << e.durationMs * 1000.0
+             << ",\"pid\":" << (e.gpu ? 1 : 0) << ",\"tid\":" << tid << "}"
+             << (i + 1 < events.size() ? ",\n" : "\n");
+    }
+    file << "],\n\"displayTimeUnit\":\"ms\"}\n";
+}
+
+ProfileScope::ProfileScope(const std::string& stage) : stage(stage), startMs(Profiler::instance().nowMs()) {}
+
+ProfileScope::~ProfileScope()
+{
+    Profiler& profiler = Profiler::instance();
+    if (profiler.isEnabled())
+        profiler.record(stage, startMs, profiler.nowMs() - startMs);
+}
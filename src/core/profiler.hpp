@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/*
+Process-wide timing collector. CPU stages are measured with ProfileScope (steady_clock), GPU
+stages are fed in by ComputePipeline from VkQueryPool timestamps. Samples are kept per stage so
+the summary can report p50/p95/p99; individual events are only kept when a Chrome trace
+(chrome://tracing / Perfetto) was requested. Everything is a no-op until enabled.
+*/
+class Profiler {
+public:
+    struct StageStats {
+        size_t count;
+        double mean, p50, p95, p99, max;
+    };
+
+    static Profiler& instance();
+
+    void setEnabled(bool enabled);
+    bool isEnabled() const { return enabled; }
+    void setTraceEnabled(bool enabled);
+
+    // Milliseconds since the profiler was created, on the steady clock
+    double nowMs() const;
+
+    // gpu selects the GPU lane in the trace, startMs is on the nowMs() timeline
+    void record(const std::string& stage, double startMs, double durationMs, bool gpu = false);
+
+    std::map<std::string, StageStats> summarize() const;
+    void printSummary(std::ostream& out) const;
+    // Drops every sample and event collected so far, e.g. between benchmark cases
+    void reset();
+    void writeChromeTrace(const std::string& path) const;
+
+private:
+    struct Event {
+        std::string stage;
+        double startMs;
+        double durationMs;
+        bool gpu;
+        size_t thread;
+    };
+
+    Profiler();
+
+    std::atomic<bool> enabled;
+    std::atomic<bool> traceEnabled;
+    std::chrono::steady_clock::time_point epoch;
+    mutable std::mutex mutex;
+    std::map<std::string, std::vector<double>> samples;
+    std::vector<Event> events;
+};
+
+// Records the lifetime of the scope as one sample of the named CPU stage
+class ProfileScope {
+public:
+    explicit ProfileScope(const std::string& stage);
+    ~ProfileScope();
+
+private:
+    std::string stage;
+    double startMs;
+};
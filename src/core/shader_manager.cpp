@@ -29,23 +29,47 @@ void ShaderManager::loadShadersFromDirectory()
     }
     file.close();
 
+    // Optimized variants are named "<class>_tiled.spv" (shared memory) and "<class>_image.spv"
+    // (sampled images). When several exist for a class the earliest suffix here wins, the plain
+    // "<class>.spv" is the last resort.
+    const std::vector<std::string> variantSuffixes = { "_tiled", "_image" };
+    std::unordered_map<std::string, size_t> chosenRank;
+
     for (const auto& entry : fs::directory_iterator(shaderDir)) 
     {
-        if (entry.is_regular_file()) 
+        if (entry.is_regular_file() && entry.path().extension() == ".spv") 
         {
             std::string shaderName = entry.path().stem().string();
+            size_t rank = variantSuffixes.size();
+            for (size_t i = 0; i < variantSuffixes.size(); i++) {
+                const std::string& suffix = variantSuffixes[i];
+                if (shaderName.size() > suffix.size() &&
+                    shaderName.compare(shaderName.size() - suffix.size(), suffix.size(), suffix) == 0) {
+                    shaderName.erase(shaderName.size() - suffix.size());
+                    rank = i;
+                    break;
+                }
+            }
+
             if (std::find(classLabels.begin(), classLabels.end(), shaderName) != classLabels.end()) 
             {
-                std::string shaderPath = entry.path().string();
+                auto chosen = chosenRank.find(shaderName);
+                if (chosen != chosenRank.end() && chosen->second <= rank)
+                    continue;
+                chosenRank[shaderName] = rank;
                 shadersAvailable.insert(shaderName);
-                pipelines[shaderName] = std::make_shared<ComputePipeline>(engine, shaderPath, 0, 0);
+                shaderPaths[shaderName] = entry.path().string();
             }
         }
     }
+
+    for (const auto& [shaderName, shaderPath] : shaderPaths)
+        pipelines[shaderName] = std::make_shared<ComputePipeline>(engine, shaderPath, 0, 0);
 }
 
 void ShaderManager::loadShader(const std::string& shaderPath) 
 {
+    shaderPaths["classic"] = shaderPath;
     pipelines["classic"] = std::make_shared<ComputePipeline>(engine, shaderPath, 0, 0);
 }
 
@@ -57,14 +81,119 @@ std::shared_ptr<ComputePipeline> ShaderManager::getPipeline(const std::string& n
     throw std::runtime_error("Shader not found: " + name);
 }
 
+std::shared_ptr<ComputePipeline> ShaderManager::getPipeline(const std::string& name, const SpecializationConstants& constants)
+{
+    if (constants.empty())
+        return getPipeline(name);
+
+    std::string key = name;
+    for (const auto& [constantId, value] : constants)
+        key += "|" + std::to_string(constantId) + "=" + std::to_string(value);
+
+    auto it = variants.find(key);
+    if (it != variants.end())
+        return it->second;
+
+    auto path = shaderPaths.find(name);
+    if (path == shaderPaths.end())
+        throw std::runtime_error("Shader not found: " + name);
+
+    auto pipeline = std::make_shared<ComputePipeline>(engine, path->second, width, height, constants);
+    auto scale = processingScales.find(name);
+    if (scale == processingScales.end())
+        scale = processingScales.find("");
+    if (scale != processingScales.end())
+        pipeline->setProcessingScale(scale->second);
+    if (tileCache)
+        pipeline->setTileCache(true, tileCacheThreshold);
+    variants[key] = pipeline;
+    return pipeline;
+}
+
+std::shared_ptr<ComputePipeline> ShaderManager::getPipeline(const std::string& name, const Config::ShaderTier& tier)
+{
+    SpecializationConstants constants;
+    if (tier.localSizeX > 0) constants[Config::SPEC_LOCAL_SIZE_X] = tier.localSizeX;
+    if (tier.localSizeY > 0) constants[Config::SPEC_LOCAL_SIZE_Y] = tier.localSizeY;
+    if (tier.radius > 0) constants[Config::SPEC_RADIUS] = static_cast<uint32_t>(tier.radius);
+    if (tier.similarityThreshold > 0.0f) constants[Config::SPEC_SIMILARITY_THRESHOLD] = specConstantFloat(tier.similarityThreshold);
+    if (tier.quantizeLevels > 0) constants[Config::SPEC_QUANTIZE_LEVELS] = static_cast<uint32_t>(tier.quantizeLevels);
+    return getPipeline(name, constants);
+}
+
 void ShaderManager::setDimensions(int width, int height) 
 {
+    this->width = width;
+    this->height = height;
     for (auto& pair : pipelines) 
         pair.second->setDimensions(width, height);
+    for (auto& pair : variants) 
+        pair.second->setDimensions(width, height);
+    if (classMapPipeline)
+        classMapPipeline->setDimensions(width, height);
     
 }
 
+void ShaderManager::setProcessingScale(const std::string& name, float scale)
+{
+    if (!name.empty() && pipelines.find(name) == pipelines.end())
+        throw std::runtime_error("Shader not found: " + name);
+
+    for (auto& pair : pipelines)
+        if (name.empty() || pair.first == name)
+            pair.second->setProcessingScale(scale);
+    // Variant keys are "<name>|<constants>"
+    for (auto& pair : variants)
+        if (name.empty() || pair.first.compare(0, name.size() + 1, name + "|") == 0)
+            pair.second->setProcessingScale(scale);
+    processingScales[name] = scale;
+}
+
+void ShaderManager::setTileCache(bool enabled, int threshold)
+{
+    for (auto& pair : pipelines)
+        pair.second->setTileCache(enabled, threshold);
+    for (auto& pair : variants)
+        pair.second->setTileCache(enabled, threshold);
+    tileCache = enabled;
+    tileCacheThreshold = threshold;
+}
+
+TileCacheStats ShaderManager::getTileCacheStats() const
+{
+    TileCacheStats total;
+    auto add = [&total](const std::shared_ptr<ComputePipeline>& pipeline) {
+        const TileCacheStats& stats = pipeline->getTileCacheStats();
+        total.frames += stats.frames;
+        total.tiles += stats.tiles;
+        total.cleanTiles += stats.cleanTiles;
+    };
+    for (const auto& pair : pipelines)
+        add(pair.second);
+    for (const auto& pair : variants)
+        add(pair.second);
+    return total;
+}
+
 std::set<std::string> ShaderManager::getAvailableClasses()
 {
     return ShaderManager::shadersAvailable;
+}
+
+std::string ShaderManager::getShaderPath(const std::string& name) const
+{
+    auto path = shaderPaths.find(name);
+    if (path == shaderPaths.end())
+        throw std::runtime_error("Shader not found: " + name);
+    return path->second;
+}
+
+std::shared_ptr<ComputePipeline> ShaderManager::getClassMapPipeline()
+{
+    if (!classMapPipeline)
+    {
+        classMapPipeline = std::make_shared<ComputePipeline>(engine, Config::UTILITY_SHADER_DIR + "class_map.spv", width, height);
+        classMapPipeline->setMaskFormat(MaskFormat::ClassMap);
+    }
+    return classMapPipeline;
 }
\ No newline at end of file
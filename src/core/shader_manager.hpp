@@ -4,6 +4,7 @@
 #include <filesystem>
 #include "pipeline.hpp"
 #include "vulkan_engine.hpp"
+#include "config.h"
 #include <set>
 namespace fs = std::filesystem;
 
@@ -16,12 +17,35 @@ public:
     void loadShader(const std::string& shaderName); 
 
     std::shared_ptr<ComputePipeline> getPipeline(const std::string& name);
+    // Variants of a loaded shader with the given specialization constants, created on first use
+    std::shared_ptr<ComputePipeline> getPipeline(const std::string& name, const SpecializationConstants& constants);
+    std::shared_ptr<ComputePipeline> getPipeline(const std::string& name, const Config::ShaderTier& tier);
     void setDimensions(int width, int height);
+    // Run a shader (empty name : every shader) at a fraction of the frame size and upscale on the
+    // GPU, see ComputePipeline::setProcessingScale. Also applies to variants created later.
+    void setProcessingScale(const std::string& name, float scale);
+    // Temporal tile cache on every shader, see ComputePipeline::setTileCache. Also applies to
+    // variants created later.
+    void setTileCache(bool enabled, int threshold = 0);
+    // Summed over every pipeline and variant
+    TileCacheStats getTileCacheStats() const;
     std::set<std::string> getAvailableClasses();
+    // SPIR-V file behind a loaded shader ("classic" in single shader mode)
+    std::string getShaderPath(const std::string& name) const;
+    // class_map.comp from the utility folder, every class in one pass (see MaskGenerator::generateClassMap).
+    // Created on first use, always at full size.
+    std::shared_ptr<ComputePipeline> getClassMapPipeline();
     std::set<std::string> shadersAvailable;
 private:
     VulkanEngine& engine;
     std::unordered_map<std::string, std::shared_ptr<ComputePipeline>> pipelines;
-    
+    std::unordered_map<std::string, std::string> shaderPaths;
+    std::unordered_map<std::string, std::shared_ptr<ComputePipeline>> variants;
+    std::unordered_map<std::string, float> processingScales;
+    std::shared_ptr<ComputePipeline> classMapPipeline;
+    int width = 0, height = 0;
+    bool tileCache = false;
+    int tileCacheThreshold = 0;
+
 };
 
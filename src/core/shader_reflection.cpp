@@ -0,0 +1,344 @@
+#include "shader_reflection.hpp"
+#include <unordered_map>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <fstream>
+
+namespace {
+
+// Subset of the SPIR-V specification we care about.
+const uint32_t SPIRV_MAGIC = 0x07230203;
+
+enum Op : uint32_t {
+    OpExecutionMode = 16,
+    OpTypeBool = 20,
+    OpTypeInt = 21,
+    OpTypeFloat = 22,
+    OpTypeVector = 23,
+    OpTypeMatrix = 24,
+    OpTypeImage = 25,
+    OpTypeSampler = 26,
+    OpTypeSampledImage = 27,
+    OpTypeArray = 28,
+    OpTypeRuntimeArray = 29,
+    OpTypeStruct = 30,
+    OpTypePointer = 32,
+    OpConstant = 43,
+    OpConstantComposite = 44,
+    OpSpecConstantTrue = 48,
+    OpSpecConstantFalse = 49,
+    OpSpecConstant = 50,
+    OpSpecConstantComposite = 51,
+    OpVariable = 59,
+    OpDecorate = 71,
+    OpMemberDecorate = 72,
+    OpExecutionModeId = 331,
+};
+
+enum Decoration : uint32_t {
+    DecorationSpecId = 1,
+    DecorationBlock = 2,
+    DecorationBufferBlock = 3,
+    DecorationArrayStride = 6,
+    DecorationMatrixStride = 7,
+    DecorationBuiltIn = 11,
+    DecorationBinding = 33,
+    DecorationDescriptorSet = 34,
+    DecorationOffset = 35,
+};
+
+enum StorageClass : uint32_t {
+    StorageClassUniformConstant = 0,
+    StorageClassUniform = 2,
+    StorageClassPushConstant = 9,
+    StorageClassStorageBuffer = 12,
+};
+
+const uint32_t ExecutionModeLocalSize = 17;
+const uint32_t ExecutionModeLocalSizeId = 38;
+const uint32_t BuiltInWorkgroupSize = 25;
+const uint32_t DimBuffer = 5;
+
+struct Instruction {
+    uint32_t opcode;
+    std::vector<uint32_t> operands; // Everything after the result id
+};
+
+struct Module {
+    std::unordered_map<uint32_t, Instruction> types;
+    std::unordered_map<uint32_t, std::vector<uint32_t>> constants; // id -> literal words or constituent ids
+    std::unordered_map<uint32_t, std::unordered_map<uint32_t, uint32_t>> decorations;
+    std::unordered_map<uint32_t, std::unordered_map<uint32_t, uint32_t>> memberOffsets;
+    std::unordered_map<uint32_t, std::unordered_map<uint32_t, uint32_t>> memberMatrixStrides;
+    std::vector<std::pair<uint32_t, Instruction>> variables;
+
+    bool hasDecoration(uint32_t id, uint32_t decoration) const {
+        auto it = decorations.find(id);
+        return it != decorations.end() && it->second.count(decoration);
+    }
+
+    uint32_t decoration(uint32_t id, uint32_t decoration, uint32_t fallback) const {
+        auto it = decorations.find(id);
+        if (it == decorations.end()) return fallback;
+        auto value = it->second.find(decoration);
+        return value == it->second.end() ? fallback : value->second;
+    }
+
+    uint32_t constantValue(uint32_t id) const {
+        auto it = constants.find(id);
+        if (it == constants.end() || it->second.empty())
+            throw std::runtime_error("SPIR-V reflection: unknown constant id " + std::to_string(id));
+        return it->second[0];
+    }
+
+    const Instruction& type(uint32_t id) const {
+        auto it = types.find(id);
+        if (it == types.end())
+            throw std::runtime_error("SPIR-V reflection: unknown type id " + std::to_string(id));
+        return it->second;
+    }
+
+    uint32_t typeSize(uint32_t id) const {
+        const Instruction& t = type(id);
+        switch (t.opcode) {
+            case OpTypeBool:
+                return 4;
+            case OpTypeInt:
+            case OpTypeFloat:
+                return t.operands[0] / 8;
+            case OpTypeVector:
+            case OpTypeMatrix:
+                return typeSize(t.operands[0]) * t.operands[1];
+            case OpTypeArray: {
+                uint32_t stride = decoration(id, DecorationArrayStride, typeSize(t.operands[0]));
+                return stride * constantValue(t.operands[1]);
+            }
+            case OpTypeRuntimeArray:
+                return 0;
+            case OpTypeStruct: {
+                uint32_t size = 0;
+                auto offsets = memberOffsets.find(id);
+                auto strides = memberMatrixStrides.find(id);
+                for (uint32_t m = 0; m < t.operands.size(); m++) {
+                    uint32_t offset = 0;
+                    if (offsets != memberOffsets.end() && offsets->second.count(m))
+                        offset = offsets->second.at(m);
+                    uint32_t memberSize = typeSize(t.operands[m]);
+                    // Matrix columns are padded to the declared stride (std140 / std430)
+                    if (strides != memberMatrixStrides.end() && strides->second.count(m))
+                        memberSize = strides->second.at(m) * type(t.operands[m]).operands[1];
+                    size = std::max(size, offset + memberSize);
+                }
+                return size;
+            }
+            default:
+                throw std::runtime_error("SPIR-V reflection: cannot size type opcode " + std::to_string(t.opcode));
+        }
+    }
+};
+
+VkDescriptorType descriptorTypeFor(const Module& module, uint32_t storageClass, uint32_t typeId)
+{
+    const Instruction& t = module.type(typeId);
+
+    if (storageClass == StorageClassStorageBuffer)
+        return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+
+    if (storageClass == StorageClassUniform)
+        return module.hasDecoration(typeId, DecorationBufferBlock) ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER
+                                                                   : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+
+    switch (t.opcode) {
+        case OpTypeSampler:
+            return VK_DESCRIPTOR_TYPE_SAMPLER;
+        case OpTypeSampledImage:
+            return VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        case OpTypeImage: {
+            // Operands : sampled type, dim, depth, arrayed, ms, sampled, format
+            bool isBuffer = t.operands[1] == DimBuffer;
+            bool isStorage = t.operands[5] == 2;
+            if (isBuffer)
+                return isStorage ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+            return isStorage ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+        }
+        default:
+            throw std::runtime_error("SPIR-V reflection: unsupported resource type opcode " + std::to_string(t.opcode));
+    }
+}
+
+} // namespace
+
+const ReflectedBinding* ShaderReflection::findBinding(uint32_t binding, uint32_t set) const
+{
+    for (const auto& b : bindings)
+        if (b.binding == binding && b.set == set)
+            return &b;
+    return nullptr;
+}
+
+const ReflectedSpecConstant* ShaderReflection::findSpecConstant(uint32_t constantId) const
+{
+    for (const auto& c : specConstants)
+        if (c.constantId == constantId)
+            return &c;
+    return nullptr;
+}
+
+ShaderReflection reflectShader(const std::vector<uint32_t>& spirv)
+{
+    if (spirv.size() < 5 || spirv[0] != SPIRV_MAGIC)
+        throw std::runtime_error("SPIR-V reflection: invalid module header");
+
+    Module module;
+    ShaderReflection reflection;
+    uint32_t localSizeIds[3] = { 0, 0, 0 };
+
+    size_t pos = 5;
+    while (pos < spirv.size())
+    {
+        uint32_t wordCount = spirv[pos] >> 16;
+        uint32_t opcode = spirv[pos] & 0xFFFF;
+        if (wordCount == 0 || pos + wordCount > spirv.size())
+            throw std::runtime_error("SPIR-V reflection: truncated instruction");
+
+        const uint32_t* w = &spirv[pos];
+
+        switch (opcode) {
+            case OpExecutionMode:
+                if (w[2] == ExecutionModeLocalSize) {
+                    reflection.localSize[0] = w[3];
+                    reflection.localSize[1] = w[4];
+                    reflection.localSize[2] = w[5];
+                }
+                break;
+            case OpExecutionModeId:
+                if (w[2] == ExecutionModeLocalSizeId) {
+                    localSizeIds[0] = w[3];
+                    localSizeIds[1] = w[4];
+                    localSizeIds[2] = w[5];
+                }
+                break;
+            case OpTypeBool:
+            case OpTypeInt:
+            case OpTypeFloat:
+            case OpTypeVector:
+            case OpTypeMatrix:
+            case OpTypeImage:
+            case OpTypeSampler:
+            case OpTypeSampledImage:
+            case OpTypeArray:
+            case OpTypeRuntimeArray:
+            case OpTypeStruct:
+            case OpTypePointer:
+                module.types[w[1]] = Instruction{ opcode, std::vector<uint32_t>(w + 2, w + wordCount) };
+                break;
+            case OpConstant:
+            case OpConstantComposite:
+            case OpSpecConstant:
+            case OpSpecConstantComposite:
+                module.constants[w[2]] = std::vector<uint32_t>(w + 3, w + wordCount);
+                break;
+            case OpSpecConstantTrue:
+            case OpSpecConstantFalse:
+                module.constants[w[2]] = { opcode == OpSpecConstantTrue ? 1u : 0u };
+                break;
+            case OpVariable:
+                module.variables.emplace_back(w[2], Instruction{ w[3], { w[1] } });
+                break;
+            case OpDecorate:
+                module.decorations[w[1]][w[2]] = wordCount > 3 ? w[3] : 0;
+                break;
+            case OpMemberDecorate:
+                if (w[3] == DecorationOffset)
+                    module.memberOffsets[w[1]][w[2]] = w[4];
+                else if (w[3] == DecorationMatrixStride)
+                    module.memberMatrixStrides[w[1]][w[2]] = w[4];
+                break;
+            default:
+                break;
+        }
+        pos += wordCount;
+    }
+
+    for (const auto& [id, var] : module.variables)
+    {
+        uint32_t storageClass = var.opcode;
+        const Instruction& pointer = module.type(var.operands[0]);
+        uint32_t pointee = pointer.operands[1];
+
+        if (storageClass == StorageClassPushConstant) {
+            reflection.pushConstantSize = std::max(reflection.pushConstantSize, module.typeSize(pointee));
+            continue;
+        }
+
+        if (storageClass != StorageClassUniformConstant && storageClass != StorageClassUniform &&
+            storageClass != StorageClassStorageBuffer)
+            continue;
+        if (!module.hasDecoration(id, DecorationBinding))
+            continue;
+
+        uint32_t count = 1;
+        const Instruction& pointeeType = module.type(pointee);
+        if (pointeeType.opcode == OpTypeArray) {
+            count = module.constantValue(pointeeType.operands[1]);
+            pointee = pointeeType.operands[0];
+        } else if (pointeeType.opcode == OpTypeRuntimeArray) {
+            pointee = pointeeType.operands[0];
+        }
+
+        ReflectedBinding binding;
+        binding.set = module.decoration(id, DecorationDescriptorSet, 0);
+        binding.binding = module.decoration(id, DecorationBinding, 0);
+        binding.descriptorType = descriptorTypeFor(module, storageClass, pointee);
+        binding.descriptorCount = count;
+        reflection.bindings.push_back(binding);
+    }
+
+    std::sort(reflection.bindings.begin(), reflection.bindings.end(),
+              [](const ReflectedBinding& a, const ReflectedBinding& b)
+              { return a.set != b.set ? a.set < b.set : a.binding < b.binding; });
+
+    for (const auto& [id, value] : module.constants) {
+        if (module.hasDecoration(id, DecorationSpecId))
+            reflection.specConstants.push_back({ module.decoration(id, DecorationSpecId, 0), value[0] });
+    }
+    std::sort(reflection.specConstants.begin(), reflection.specConstants.end(),
+              [](const ReflectedSpecConstant& a, const ReflectedSpecConstant& b) { return a.constantId < b.constantId; });
+
+    // LocalSizeId and a constant decorated as the WorkgroupSize builtin both override LocalSize.
+    // Their components may be specialization constants, in which case we remember the id too.
+    auto resolveLocalSize = [&](int i, uint32_t constantId) {
+        reflection.localSize[i] = module.constantValue(constantId);
+        reflection.localSizeSpecIds[i] = module.decoration(constantId, DecorationSpecId, ShaderReflection::NO_SPEC_ID);
+    };
+    if (localSizeIds[0] != 0) {
+        for (int i = 0; i < 3; i++)
+            resolveLocalSize(i, localSizeIds[i]);
+    }
+    for (const auto& [id, constituents] : module.constants) {
+        if (module.decoration(id, DecorationBuiltIn, ~0u) == BuiltInWorkgroupSize && constituents.size() == 3) {
+            for (int i = 0; i < 3; i++)
+                resolveLocalSize(i, constituents[i]);
+        }
+    }
+
+    return reflection;
+}
+
+std::vector<uint32_t> loadSpirvFile(const std::string& path)
+{
+    std::ifstream file(path, std::ios::ate | std::ios::binary);
+    if (!file.is_open()) 
+        throw std::runtime_error("Failed to open shader file: " + path);
+
+    size_t fileSize = file.tellg();
+    if (fileSize % sizeof(uint32_t) != 0)
+        throw std::runtime_error("Shader file is not a valid SPIR-V binary: " + path);
+
+    std::vector<uint32_t> shaderCode(fileSize / sizeof(uint32_t));
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(shaderCode.data()), fileSize);
+    file.close();
+    return shaderCode;
+}
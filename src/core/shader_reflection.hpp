@@ -0,0 +1,43 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <cstdint>
+#include <string>
+
+/*
+Minimal SPIR-V reflection for compute shaders. We only walk the instruction stream far enough
+to recover what ComputePipeline needs to build its layouts : the descriptor bindings, the size
+of the push constant block, the specialization constants and the workgroup size declared with
+local_size_x/y/z (or local_size_x_id/y_id/z_id when it is specializable).
+*/
+
+struct ReflectedBinding {
+    uint32_t set;
+    uint32_t binding;
+    VkDescriptorType descriptorType;
+    uint32_t descriptorCount;
+};
+
+struct ReflectedSpecConstant {
+    uint32_t constantId;   // layout(constant_id = N)
+    uint32_t defaultValue; // Raw 32-bit pattern of the default (floats are bit-cast, bools are 0/1)
+};
+
+struct ShaderReflection {
+    static const uint32_t NO_SPEC_ID = ~0u;
+
+    std::vector<ReflectedBinding> bindings; // Sorted by (set, binding)
+    std::vector<ReflectedSpecConstant> specConstants; // Sorted by constantId
+    uint32_t pushConstantSize = 0;
+    uint32_t localSize[3] = { 1, 1, 1 };
+    uint32_t localSizeSpecIds[3] = { NO_SPEC_ID, NO_SPEC_ID, NO_SPEC_ID };
+
+    const ReflectedBinding* findBinding(uint32_t binding, uint32_t set = 0) const;
+    const ReflectedSpecConstant* findSpecConstant(uint32_t constantId) const;
+};
+
+ShaderReflection reflectShader(const std::vector<uint32_t>& spirv);
+
+// Reads a .spv file into 32-bit words, throws if it is missing or not word aligned
+std::vector<uint32_t> loadSpirvFile(const std::string& path);
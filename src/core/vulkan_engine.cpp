@@ -1,26 +1,57 @@
 #include "vulkan_engine.hpp"
+#include "cpu_pipeline.hpp"
 #include <iostream>
+#include <stdexcept>
 
+// Throws rather than exits, so a machine without a usable device can still fall back to the CPU
 #define VK_CHECK(result) if (result != VK_SUCCESS) { \
-    fprintf(stderr, "Error: %d at line %d\n", result, __LINE__); \
-    exit(1); \
+    throw std::runtime_error("Vulkan error " + std::to_string(result) + " at line " + std::to_string(__LINE__)); \
 }
 
-VulkanEngine::VulkanEngine() 
+VulkanEngine::VulkanEngine(bool cpuBackend)
+    : instance(VK_NULL_HANDLE), physicalDevice(VK_NULL_HANDLE), device(VK_NULL_HANDLE), computeQueue(VK_NULL_HANDLE),
+      computeQueueFamilyIndex(0), commandPool(VK_NULL_HANDLE), timestampPeriod(0.0f)
 {
-    createInstance();
-    setupDevice();
+    if (!cpuBackend)
+    {
+        try
+        {
+            createInstance();
+            setupDevice();
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "Vulkan unavailable (" << e.what() << "), falling back to the CPU backend" << std::endl;
+            release();
+        }
+    }
+    if (isCpuBackend())
+    {
+        deviceName = "CPU backend (" + CpuPipeline::describe() + ")";
+        std::cout << "Selected Device: " << deviceName << std::endl;
+    }
 }
 
 VulkanEngine::~VulkanEngine() 
 {
     if (device) 
-    {
         vkDeviceWaitIdle(device);
+    release();
+}
+
+void VulkanEngine::release()
+{
+    if (commandPool != VK_NULL_HANDLE)
         vkDestroyCommandPool(device, commandPool, nullptr);
+    if (device != VK_NULL_HANDLE)
         vkDestroyDevice(device, nullptr);
+    if (instance != VK_NULL_HANDLE)
         vkDestroyInstance(instance, nullptr);
-    }
+    commandPool = VK_NULL_HANDLE;
+    device = VK_NULL_HANDLE;
+    instance = VK_NULL_HANDLE;
+    physicalDevice = VK_NULL_HANDLE;
+    computeQueue = VK_NULL_HANDLE;
 }
 
 void VulkanEngine::createInstance() 
@@ -50,23 +81,45 @@ void VulkanEngine::setupDevice()
     for (int i = 0; i < deviceCount; i++) 
         std::cout << "Device " << i+1 << " with handle " << devices[i] << std::endl;
     
-    for (auto device : devices) 
+    if (deviceCount == 0)
+        throw std::runtime_error("No Vulkan capable device found");
+
+    /*
+    Prefer a discrete GPU, but fall back to integrated, virtual and finally CPU devices so we
+    still run on laptops and under software ICDs such as lavapipe / SwiftShader on CI machines.
+    */
+    const VkPhysicalDeviceType preference[] = {
+        VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU,
+        VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU,
+        VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU,
+        VK_PHYSICAL_DEVICE_TYPE_CPU,
+        VK_PHYSICAL_DEVICE_TYPE_OTHER
+    };
+    physicalDevice = VK_NULL_HANDLE;
+    for (VkPhysicalDeviceType type : preference) 
     {
-        VkPhysicalDeviceProperties properties;
-        vkGetPhysicalDeviceProperties(device, &properties);
-        if (properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU) 
+        for (auto device : devices) 
         {
-            physicalDevice = device;
-            std::cout << "Selected Device: " << properties.deviceName << std::endl;
-            break;
+            VkPhysicalDeviceProperties properties;
+            vkGetPhysicalDeviceProperties(device, &properties);
+            if (properties.deviceType == type) 
+            {
+                physicalDevice = device;
+                deviceName = properties.deviceName;
+                break;
+            }
         }
+        if (physicalDevice != VK_NULL_HANDLE)
+            break;
     }
+    std::cout << "Selected Device: " << deviceName << std::endl;
 
     uint32_t queueFamilyCount = 0;
     vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
     std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
     vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
 
+    computeQueueFamilyIndex = queueFamilyCount;
     for (uint32_t i = 0; i < queueFamilyCount; i++) 
     {
         if (queueFamilies[i].queueFlags & VK_QUEUE_COMPUTE_BIT) 
@@ -75,6 +128,13 @@ void VulkanEngine::setupDevice()
             break;
         }
     }
+    if (computeQueueFamilyIndex == queueFamilyCount)
+        throw std::runtime_error("No compute queue on " + deviceName);
+
+    VkPhysicalDeviceProperties selectedProperties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &selectedProperties);
+    timestampPeriod = queueFamilies[computeQueueFamilyIndex].timestampValidBits > 0
+                          ? selectedProperties.limits.timestampPeriod : 0.0f;
 
     float queuePriority = 1.0f;
     VkDeviceQueueCreateInfo queueCreateInfo = {};
@@ -92,9 +152,22 @@ void VulkanEngine::setupDevice()
 
     vkGetDeviceQueue(device, computeQueueFamilyIndex, 0, &computeQueue);
 
+    commandPool = createCommandPool();
+}
+
+VkCommandPool VulkanEngine::createCommandPool()
+{
     VkCommandPoolCreateInfo poolInfo = {};
     poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
     poolInfo.queueFamilyIndex = computeQueueFamilyIndex;
 
-    VK_CHECK(vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool));
+    VkCommandPool pool;
+    VK_CHECK(vkCreateCommandPool(device, &poolInfo, nullptr, &pool));
+    return pool;
+}
+
+void VulkanEngine::submit(const VkSubmitInfo& submitInfo, VkFence fence)
+{
+    std::lock_guard<std::mutex> lock(queueMutex);
+    VK_CHECK(vkQueueSubmit(computeQueue, 1, &submitInfo, fence));
 }
\ No newline at end of file
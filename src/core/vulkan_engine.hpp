@@ -3,18 +3,32 @@
 #include <vulkan/vulkan.h>
 #include <vector>
 #include <string>
+#include <mutex>
 
 class VulkanEngine {
 public:
-    VulkanEngine();
+    // When Vulkan can't be initialised (no driver, no device, no compute queue), or cpuBackend asks
+    // for it, the engine comes up without a device and pipelines run their effect on the CPU
+    explicit VulkanEngine(bool cpuBackend = false);
     ~VulkanEngine();
 
+    bool isCpuBackend() const { return device == VK_NULL_HANDLE; }
+
     VkInstance getInstance() const { return instance; }
     VkDevice getDevice() const { return device; }
     VkPhysicalDevice getPhysicalDevice() const { return physicalDevice; }
     VkQueue getComputeQueue() const { return computeQueue; }
     uint32_t getComputeQueueFamily() const { return computeQueueFamilyIndex; }
     VkCommandPool getCommandPool() const { return commandPool; }
+    // Nanoseconds per timestamp tick, 0 when the compute queue cannot write timestamps
+    float getTimestampPeriod() const { return timestampPeriod; }
+    const std::string& getDeviceName() const { return deviceName; }
+
+    // Command pools are single threaded, so every pipeline / worker gets its own on the compute family
+    VkCommandPool createCommandPool();
+    // vkQueueSubmit needs external synchronisation, this is the one place that takes the queue.
+    // Wait on the fence rather than the queue so other workers' submissions are not waited for.
+    void submit(const VkSubmitInfo& submitInfo, VkFence fence);
 
 private:
     VkInstance instance;
@@ -23,7 +37,11 @@ private:
     VkQueue computeQueue;
     uint32_t computeQueueFamilyIndex;
     VkCommandPool commandPool;
+    float timestampPeriod;
+    std::string deviceName;
+    std::mutex queueMutex;
 
     void createInstance();
     void setupDevice();
+    void release();
 };
\ No newline at end of file
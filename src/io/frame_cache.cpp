@@ -0,0 +1,328 @@
+#include "frame_cache.hpp"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+namespace fs = std::filesystem;
+
+namespace {
+    const uint64_t PRIME1 = 0x9E3779B185EBCA87ULL;
+    const uint64_t PRIME2 = 0xC2B2AE3D27D4EB4FULL;
+    const uint64_t PRIME3 = 0x165667B19E3779F9ULL;
+    const uint64_t PRIME4 = 0x85EBCA77C2B2AE63ULL;
+    const uint64_t PRIME5 = 0x27D4EB2F165667C5ULL;
+
+    const char ENTRY_MAGIC[4] = { 'N', 'P', 'F', 'C' };
+    const uint32_t ENTRY_VERSION = 1;
+    const char* ENTRY_EXTENSION = ".npf";
+    // Eviction goes a little below the limit so the next stores don't rescan the directory
+    const double EVICTION_TARGET = 0.9;
+
+    struct EntryHeader {
+        char magic[4];
+        uint32_t version;
+        uint32_t width, height;
+        uint64_t payloadSize;
+    };
+
+    uint64_t rotl(uint64_t value, int bits) { return (value << bits) | (value >> (64 - bits)); }
+
+    uint64_t read64(const unsigned char* p) { uint64_t value; memcpy(&value, p, 8); return value; }
+    uint32_t read32(const unsigned char* p) { uint32_t value; memcpy(&value, p, 4); return value; }
+
+    uint64_t mixLane(uint64_t lane, uint64_t input)
+    {
+        lane += input * PRIME2;
+        return rotl(lane, 31) * PRIME1;
+    }
+
+    uint64_t mergeLane(uint64_t hash, uint64_t lane)
+    {
+        hash ^= mixLane(0, lane);
+        return hash * PRIME1 + PRIME4;
+    }
+
+    bool samePixel(const unsigned char* rgba, size_t a, size_t b)
+    {
+        return rgba[a * 4] == rgba[b * 4] && rgba[a * 4 + 1] == rgba[b * 4 + 1] && rgba[a * 4 + 2] == rgba[b * 4 + 2];
+    }
+
+    /*
+    Packets of RGB pixels : a control byte below 128 is followed by control + 1 literal pixels,
+    from 128 up it is followed by one pixel repeated control - 126 times (2..129).
+    */
+    void encodeRuns(const std::vector<unsigned char>& rgba, size_t pixels, std::vector<unsigned char>& out)
+    {
+        const unsigned char* data = rgba.data();
+        size_t i = 0;
+        while (i < pixels)
+        {
+            size_t run = 1;
+            while (i + run < pixels && run < 129 && samePixel(data, i, i + run))
+                run++;
+            if (run >= 2)
+            {
+                out.push_back(static_cast<unsigned char>(126 + run));
+                out.insert(out.end(), data + i * 4, data + i * 4 + 3);
+                i += run;
+                continue;
+            }
+
+            size_t start = i, count = 0;
+            while (i < pixels && count < 128 && !(i + 1 < pixels && samePixel(data, i, i + 1)))
+            {
+                i++;
+                count++;
+            }
+            out.push_back(static_cast<unsigned char>(count - 1));
+            for (size_t p = start; p < start + count; p++)
+                out.insert(out.end(), data + p * 4, data + p * 4 + 3);
+        }
+    }
+
+    bool decodeRuns(const std::vector<unsigned char>& in, size_t pixels, std::vector<unsigned char>& rgba)
+    {
+        rgba.resize(pixels * 4);
+        size_t pos = 0, pixel = 0;
+        while (pixel < pixels)
+        {
+            if (pos >= in.size())
+                return false;
+            unsigned char control = in[pos++];
+            bool repeat = control >= 128;
+            size_t count = repeat ? control - 126 : control + 1;
+            size_t bytes = repeat ? 3 : count * 3;
+            if (pixel + count > pixels || pos + bytes > in.size())
+                return false;
+            for (size_t k = 0; k < count; k++, pixel++)
+            {
+                const unsigned char* source = in.data() + pos + (repeat ? 0 : k * 3);
+                rgba[pixel * 4 + 0] = source[0];
+                rgba[pixel * 4 + 1] = source[1];
+                rgba[pixel * 4 + 2] = source[2];
+                rgba[pixel * 4 + 3] = 255;
+            }
+            pos += bytes;
+        }
+        return pos == in.size();
+    }
+}
+
+// The xxHash64 algorithm
+uint64_t hashBytes(const void* data, size_t size, uint64_t seed)
+{
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    const unsigned char* end = p + size;
+    uint64_t hash;
+
+    if (size >= 32)
+    {
+        uint64_t lanes[4] = { seed + PRIME1 + PRIME2, seed + PRIME2, seed, seed - PRIME1 };
+        const unsigned char* limit = end - 32;
+        do
+        {
+            for (int lane = 0; lane < 4; lane++, p += 8)
+                lanes[lane] = mixLane(lanes[lane], read64(p));
+        } while (p <= limit);
+
+        hash = rotl(lanes[0], 1) + rotl(lanes[1], 7) + rotl(lanes[2], 12) + rotl(lanes[3], 18);
+        for (uint64_t lane : lanes)
+            hash = mergeLane(hash, lane);
+    }
+    else
+        hash = seed + PRIME5;
+
+    hash += size;
+    for (; p + 8 <= end; p += 8)
+    {
+        hash ^= mixLane(0, read64(p));
+        hash = rotl(hash, 27) * PRIME1 + PRIME4;
+    }
+    if (p + 4 <= end)
+    {
+        hash ^= static_cast<uint64_t>(read32(p)) * PRIME1;
+        hash = rotl(hash, 23) * PRIME2 + PRIME3;
+        p += 4;
+    }
+    for (; p < end; p++)
+    {
+        hash ^= *p * PRIME5;
+        hash = rotl(hash, 11) * PRIME1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= PRIME2;
+    hash ^= hash >> 29;
+    hash *= PRIME3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+uint64_t hashFile(const std::string& path, uint64_t seed)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        throw std::runtime_error("Failed to open " + path + " for hashing");
+    std::vector<char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    return hashBytes(bytes.data(), bytes.size(), seed);
+}
+
+FrameCache::FrameCache(const std::string& directory, uint64_t maxBytes)
+    : directory(directory), maxBytes(maxBytes), totalBytes(0), tempCounter(0)
+{
+    fs::create_directories(directory);
+    for (const auto& entry : fs::directory_iterator(directory))
+    {
+        if (!entry.is_regular_file())
+            continue;
+        // Leftovers of an interrupted store
+        if (entry.path().extension() == ".tmp")
+            fs::remove(entry.path());
+        else if (entry.path().extension() == ENTRY_EXTENSION)
+            totalBytes += entry.file_size();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    evict();
+}
+
+std::string FrameCache::entryPath(const FrameCacheKey& key) const
+{
+    std::ostringstream name;
+    name << std::hex << std::setfill('0') << std::setw(16) << key.inputHash << "_" << std::setw(16) << key.shaderHash
+         << "_" << std::setw(16) << key.maskHash << std::dec << "_" << key.width << "x" << key.height << ENTRY_EXTENSION;
+    return (fs::path(directory) / name.str()).string();
+}
+
+bool FrameCache::load(const FrameCacheKey& key, std::vector<unsigned char>& rgbaData)
+{
+    std::string path = entryPath(key);
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stats.misses++;
+        return false;
+    }
+
+    EntryHeader header;
+    std::vector<unsigned char> payload;
+    std::vector<unsigned char> pixels;
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    bool valid = file && memcmp(header.magic, ENTRY_MAGIC, sizeof(ENTRY_MAGIC)) == 0 && header.version == ENTRY_VERSION &&
+                 header.width == static_cast<uint32_t>(key.width) && header.height == static_cast<uint32_t>(key.height);
+    if (valid)
+    {
+        payload.resize(header.payloadSize);
+        file.read(reinterpret_cast<char*>(payload.data()), payload.size());
+        valid = file && decodeRuns(payload, static_cast<size_t>(key.width) * key.height, pixels);
+    }
+    file.close();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!valid)
+    {
+        std::error_code error;
+        uint64_t size = fs::file_size(path, error);
+        if (!error && fs::remove(path, error))
+            totalBytes -= std::min(totalBytes, size);
+        stats.misses++;
+        return false;
+    }
+
+    // Recently used, see evict
+    std::error_code error;
+    fs::last_write_time(path, fs::file_time_type::clock::now(), error);
+    rgbaData = std::move(pixels);
+    stats.hits++;
+    stats.bytesRead += sizeof(header) + payload.size();
+    return true;
+}
+
+void FrameCache::store(const FrameCacheKey& key, const std::vector<unsigned char>& rgbaData)
+{
+    size_t pixelCount = static_cast<size_t>(key.width) * key.height;
+    if (rgbaData.size() < pixelCount * 4)
+        throw std::runtime_error("Frame cache entry smaller than its " + std::to_string(key.width) + "x" +
+                                 std::to_string(key.height) + " key");
+
+    std::vector<unsigned char> payload;
+    payload.reserve(pixelCount);
+    encodeRuns(rgbaData, pixelCount, payload);
+
+    EntryHeader header;
+    memcpy(header.magic, ENTRY_MAGIC, sizeof(ENTRY_MAGIC));
+    header.version = ENTRY_VERSION;
+    header.width = key.width;
+    header.height = key.height;
+    header.payloadSize = payload.size();
+
+    std::string path = entryPath(key);
+    std::string tempPath;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tempPath = path + "." + std::to_string(tempCounter++) + ".tmp";
+    }
+    {
+        std::ofstream file(tempPath, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(payload.data()), payload.size());
+        if (!file)
+            throw std::runtime_error("Failed to write frame cache entry " + tempPath);
+    }
+
+    uint64_t entrySize = sizeof(header) + payload.size();
+    std::lock_guard<std::mutex> lock(mutex);
+    std::error_code error;
+    uint64_t replaced = fs::exists(path, error) ? fs::file_size(path, error) : 0;
+    fs::rename(tempPath, path);
+    totalBytes = totalBytes - std::min(totalBytes, replaced) + entrySize;
+    stats.stores++;
+    stats.bytesWritten += entrySize;
+    evict(path);
+}
+
+// Oldest modification time first until the directory fits again, never the entry just stored
+void FrameCache::evict(const std::string& keep)
+{
+    if (totalBytes <= maxBytes)
+        return;
+    uint64_t target = static_cast<uint64_t>(maxBytes * EVICTION_TARGET);
+
+    std::vector<std::pair<fs::file_time_type, fs::path>> entries;
+    for (const auto& entry : fs::directory_iterator(directory))
+        if (entry.is_regular_file() && entry.path().extension() == ENTRY_EXTENSION)
+            entries.emplace_back(entry.last_write_time(), entry.path());
+    std::sort(entries.begin(), entries.end());
+
+    for (const auto& [time, path] : entries)
+    {
+        if (totalBytes <= target)
+            break;
+        if (path == keep)
+            continue;
+        std::error_code error;
+        uint64_t size = fs::file_size(path, error);
+        if (!error && fs::remove(path, error))
+        {
+            totalBytes -= std::min(totalBytes, size);
+            stats.evictions++;
+        }
+    }
+}
+
+FrameCacheStats FrameCache::getStats() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+uint64_t FrameCache::getSize() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return totalBytes;
+}
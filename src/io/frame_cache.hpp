@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// 64 bit content hash (xxHash64 style, four lanes), not cryptographic. Chain calls through seed.
+uint64_t hashBytes(const void* data, size_t size, uint64_t seed = 0);
+uint64_t hashFile(const std::string& path, uint64_t seed = 0);
+
+// Everything a processed frame depends on
+struct FrameCacheKey {
+    uint64_t inputHash;     // Input frame bytes
+    uint64_t shaderHash;    // SPIR-V of the effects and the settings that change their output
+    uint64_t maskHash;      // Masks / class map the effects ran with, 0 without
+    int width, height;
+};
+
+struct FrameCacheStats {
+    size_t hits = 0, misses = 0, stores = 0, evictions = 0;
+    uint64_t bytesRead = 0, bytesWritten = 0;
+};
+
+/*
+On-disk content-addressed cache of processed frames, so reruns over the same clip with the same
+effects skip the frames whose inputs didn't change. One file per key named after it, holding the
+RGB pixels run length encoded (stylized frames are full of flat areas; alpha isn't kept since the
+results end up in PPMs). Hits refresh the file's modification time and the oldest files are
+evicted once the directory grows past maxBytes, which makes it an LRU across runs. Safe to share
+between frame workers : entries are written to a temporary file and renamed into place.
+*/
+class FrameCache {
+public:
+    FrameCache(const std::string& directory, uint64_t maxBytes);
+
+    // False on a miss (or a damaged entry, which is dropped), rgbaData is untouched then
+    bool load(const FrameCacheKey& key, std::vector<unsigned char>& rgbaData);
+    void store(const FrameCacheKey& key, const std::vector<unsigned char>& rgbaData);
+
+    FrameCacheStats getStats() const;
+    uint64_t getSize() const;
+
+private:
+    std::string directory;
+    uint64_t maxBytes;
+    uint64_t totalBytes;
+    size_t tempCounter;
+    FrameCacheStats stats;
+    mutable std::mutex mutex;
+
+    std::string entryPath(const FrameCacheKey& key) const;
+    void evict(const std::string& keep = ""); // Called with mutex held
+};
@@ -0,0 +1,242 @@
+#include "frame_codec.hpp"
+#include "ppm_handler.hpp"
+#include "qoi.hpp"
+#include "lz4.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+    const char LZ4_MAGIC[4] = { 'N', 'P', 'L', '4' };
+    // Bands below this many rows cost more in thread start up than they save. The band count only
+    // depends on the frame, how many threads work on the bands depends on the machine and load
+    const int LZ4_MIN_BAND_ROWS = 64;
+    const int LZ4_MAX_BANDS = 8;
+
+    // Codec calls in flight, --workers saves and loads frames from several threads at once
+    std::atomic<int> activeCalls(0);
+
+    struct ActiveCall {
+        ActiveCall() { activeCalls++; }
+        ~ActiveCall() { activeCalls--; }
+    };
+
+    struct Lz4FrameHeader {
+        char magic[4];
+        uint32_t width, height;
+        uint32_t bandCount;     // Followed by bandCount uint32 compressed band sizes, then the bands
+    };
+
+    int bandCount(int height)
+    {
+        return std::max(1, std::min(LZ4_MAX_BANDS, height / LZ4_MIN_BAND_ROWS));
+    }
+
+    // The cores split between the calls in flight, a worker per core leaves one thread each
+    int threadCount(int bands)
+    {
+        int cores = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+        return std::max(1, std::min(bands, cores / std::max(1, activeCalls.load())));
+    }
+
+    int bandStart(int band, int bands, int height)
+    {
+        return static_cast<int>(static_cast<int64_t>(height) * band / bands);
+    }
+
+    // Runs body(band) for every band on threadCount(bands) threads, the calling thread included
+    template <typename Body>
+    void forEachBand(int bands, const Body& body)
+    {
+        int threadTotal = threadCount(bands);
+        auto run = [&](int first)
+        {
+            for (int band = first; band < bands; band += threadTotal)
+                body(band);
+        };
+        std::vector<std::thread> threads;
+        for (int thread = 1; thread < threadTotal; thread++)
+            threads.emplace_back(run, thread);
+        run(0);
+        for (std::thread& thread : threads)
+            thread.join();
+    }
+
+    std::vector<uint8_t> readFile(const std::string& path)
+    {
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file)
+            throw std::runtime_error("Error: Check filename or path again.");
+        std::vector<uint8_t> bytes(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        if (!file.read(reinterpret_cast<char*>(bytes.data()), bytes.size()))
+            throw std::runtime_error("Error reading frame " + path);
+        return bytes;
+    }
+
+    void writeFile(const std::string& path, const std::vector<std::vector<uint8_t>>& parts)
+    {
+        std::ofstream file(path, std::ios::binary);
+        if (!file)
+            throw std::runtime_error("Failed to save output image");
+        for (const std::vector<uint8_t>& part : parts)
+            file.write(reinterpret_cast<const char*>(part.data()), part.size());
+        if (!file)
+            throw std::runtime_error("Error writing data to the file");
+    }
+
+    void saveLz4Frame(const std::string& path, const std::vector<unsigned char>& rgbaData, int width, int height)
+    {
+        ActiveCall call;
+        int bands = bandCount(height);
+        // Header and size table first, then one buffer per band
+        std::vector<std::vector<uint8_t>> parts(bands + 1);
+        forEachBand(bands, [&](int band)
+        {
+            int firstRow = bandStart(band, bands, height), endRow = bandStart(band + 1, bands, height);
+            size_t pixels = static_cast<size_t>(endRow - firstRow) * width;
+            const unsigned char* rgba = rgbaData.data() + static_cast<size_t>(firstRow) * width * 4;
+            std::vector<uint8_t> rgb(pixels * 3);
+            for (size_t i = 0; i < pixels; i++)
+            {
+                rgb[i * 3 + 0] = rgba[i * 4 + 0];
+                rgb[i * 3 + 1] = rgba[i * 4 + 1];
+                rgb[i * 3 + 2] = rgba[i * 4 + 2];
+            }
+            lz4Compress(rgb.data(), rgb.size(), parts[band + 1]);
+        });
+
+        Lz4FrameHeader header;
+        memcpy(header.magic, LZ4_MAGIC, sizeof(LZ4_MAGIC));
+        header.width = width;
+        header.height = height;
+        header.bandCount = bands;
+        std::vector<uint8_t>& head = parts[0];
+        head.resize(sizeof(header) + bands * sizeof(uint32_t));
+        memcpy(head.data(), &header, sizeof(header));
+        for (int band = 0; band < bands; band++)
+        {
+            uint32_t size = static_cast<uint32_t>(parts[band + 1].size());
+            memcpy(head.data() + sizeof(header) + band * sizeof(uint32_t), &size, sizeof(size));
+        }
+        writeFile(path, parts);
+    }
+
+    void loadLz4Frame(const std::string& path, const std::vector<uint8_t>& bytes, std::vector<unsigned char>& rgbaData,
+                      int& width, int& height)
+    {
+        ActiveCall call;
+        Lz4FrameHeader header;
+        memcpy(&header, bytes.data(), sizeof(header));
+        int bands = static_cast<int>(header.bandCount);
+        if (header.width == 0 || header.height == 0 || header.width > 1u << 15 || header.height > 1u << 15 ||
+            bands <= 0 || static_cast<uint32_t>(bands) > header.height ||
+            bytes.size() < sizeof(header) + bands * sizeof(uint32_t))
+            throw std::runtime_error("Invalid LZ4 frame " + path);
+
+        // Where each band starts in the file
+        std::vector<size_t> offsets(bands + 1, sizeof(header) + bands * sizeof(uint32_t));
+        for (int band = 0; band < bands; band++)
+        {
+            uint32_t size;
+            memcpy(&size, bytes.data() + sizeof(header) + band * sizeof(uint32_t), sizeof(size));
+            offsets[band + 1] = offsets[band] + size;
+        }
+        if (offsets[bands] > bytes.size())
+            throw std::runtime_error("Truncated LZ4 frame " + path);
+
+        width = static_cast<int>(header.width);
+        height = static_cast<int>(header.height);
+        rgbaData.resize(static_cast<size_t>(width) * height * 4);
+        std::vector<char> valid(bands, 0);
+        forEachBand(bands, [&](int band)
+        {
+            int firstRow = bandStart(band, bands, height), endRow = bandStart(band + 1, bands, height);
+            size_t pixels = static_cast<size_t>(endRow - firstRow) * width;
+            std::vector<uint8_t> rgb(pixels * 3);
+            if (!lz4Decompress(bytes.data() + offsets[band], offsets[band + 1] - offsets[band], rgb.data(), rgb.size()))
+                return;
+            unsigned char* rgba = rgbaData.data() + static_cast<size_t>(firstRow) * width * 4;
+            for (size_t i = 0; i < pixels; i++)
+            {
+                rgba[i * 4 + 0] = rgb[i * 3 + 0];
+                rgba[i * 4 + 1] = rgb[i * 3 + 1];
+                rgba[i * 4 + 2] = rgb[i * 3 + 2];
+                rgba[i * 4 + 3] = 255;
+            }
+            valid[band] = 1;
+        });
+        if (std::find(valid.begin(), valid.end(), 0) != valid.end())
+            throw std::runtime_error("Corrupt LZ4 frame " + path);
+    }
+}
+
+FrameCodec parseFrameCodec(const std::string& name)
+{
+    if (name == "ppm")
+        return FrameCodec::PPM;
+    if (name == "qoi")
+        return FrameCodec::QOI;
+    if (name == "lz4")
+        return FrameCodec::LZ4;
+    throw std::runtime_error("Unknown frame codec " + name + ", expected ppm, qoi or lz4");
+}
+
+const char* frameCodecExtension(FrameCodec codec)
+{
+    switch (codec)
+    {
+    case FrameCodec::QOI:
+        return ".qoi";
+    case FrameCodec::LZ4:
+        return ".lz4";
+    default:
+        return ".ppm";
+    }
+}
+
+void saveFrame(const std::string& path, const std::vector<unsigned char>& rgbaData, int width, int height, FrameCodec codec)
+{
+    if (codec == FrameCodec::PPM)
+        savePPMImage(path.c_str(), rgbaData, width, height);
+    else if (codec == FrameCodec::LZ4)
+        saveLz4Frame(path, rgbaData, width, height);
+    else
+    {
+        std::vector<std::vector<uint8_t>> parts(1);
+        qoiEncode(rgbaData.data(), width, height, 4, parts[0]);
+        writeFile(path, parts);
+    }
+}
+
+void loadFrame(const std::string& path, std::vector<unsigned char>& rgbaData, int& width, int& height)
+{
+    char magic[4] = {};
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+            throw std::runtime_error("Error: Check filename or path again.");
+        file.read(magic, sizeof(magic));
+    }
+
+    if (memcmp(magic, "P6", 2) == 0)
+    {
+        loadPPMImage(path.c_str(), rgbaData, width, height);
+        return;
+    }
+
+    std::vector<uint8_t> bytes = readFile(path);
+    if (memcmp(magic, "qoif", 4) == 0)
+    {
+        if (!qoiDecode(bytes.data(), bytes.size(), rgbaData, width, height))
+            throw std::runtime_error("Corrupt QOI frame " + path);
+    }
+    else if (memcmp(magic, LZ4_MAGIC, sizeof(LZ4_MAGIC)) == 0 && bytes.size() >= sizeof(Lz4FrameHeader))
+        loadLz4Frame(path, bytes, rgbaData, width, height);
+    else
+        throw std::runtime_error("Unsupported file format");
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+/*
+How intermediate frames are stored on disk. PPM is the plain rgb24 dump, QOI the standard QOI
+format (ffmpeg reads both directly), LZ4 our own file : a small header and the frame cut into
+horizontal bands of RGB, each band an independent LZ4 block, so bands are compressed and
+decompressed on several threads (the cores are split between the calls in flight, so
+--workers doesn't start a thread per core in every worker). Frames are passed around as RGBA like loadPPMImage produces,
+alpha isn't stored.
+*/
+enum class FrameCodec { PPM, QOI, LZ4 };
+
+// "ppm", "qoi" or "lz4"
+FrameCodec parseFrameCodec(const std::string& name);
+// ".ppm", ".qoi" or ".lz4"
+const char* frameCodecExtension(FrameCodec codec);
+
+void saveFrame(const std::string& path, const std::vector<unsigned char>& rgbaData, int width, int height, FrameCodec codec);
+// Any of the three, told apart by the file's magic rather than its extension
+void loadFrame(const std::string& path, std::vector<unsigned char>& rgbaData, int& width, int& height);
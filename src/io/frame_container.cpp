@@ -0,0 +1,217 @@
+#include "frame_container.hpp"
+#include "lz4.hpp"
+#include "qoi.hpp"
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+    const char CONTAINER_MAGIC[4] = { 'N', 'P', 'F', 'R' };
+    const uint32_t CONTAINER_VERSION = 1;
+    const uint32_t CHANNELS = 3;
+    // Record stored as is, LZ4 didn't make it smaller
+    const uint32_t RECORD_RAW = 1;
+    // Header compression field : bare rgb24 records (PPM), an LZ4 block or a QOI image per frame
+    const uint32_t COMPRESSION_NONE = 0;
+    const uint32_t COMPRESSION_LZ4 = 1;
+    const uint32_t COMPRESSION_QOI = 2;
+
+    uint32_t headerCompression(FrameCodec codec)
+    {
+        return codec == FrameCodec::LZ4 ? COMPRESSION_LZ4 : codec == FrameCodec::QOI ? COMPRESSION_QOI : COMPRESSION_NONE;
+    }
+
+    struct ContainerHeader {
+        char magic[4];
+        uint32_t version;
+        uint32_t width, height;
+        uint32_t channels;
+        uint32_t compression;
+        uint64_t frameCount;
+        uint64_t frameStride;   // Record size of uncompressed containers, 0 with compression
+        uint64_t indexOffset;
+        uint8_t reserved[16];
+    };
+    static_assert(sizeof(ContainerHeader) == 64, "The container header is 64 bytes");
+
+    struct IndexRecord {
+        uint64_t offset;
+        uint32_t size;
+        uint32_t flags;
+    };
+}
+
+FrameContainerWriter::FrameContainerWriter(const std::string& path, int width, int height, FrameCodec codec)
+    : path(path), file(nullptr), width(width), height(height), codec(codec), offset(sizeof(ContainerHeader))
+{
+    if (width <= 0 || height <= 0)
+        throw std::runtime_error("Invalid container frame size " + std::to_string(width) + "x" + std::to_string(height));
+    file = fopen(path.c_str(), "wb");
+    if (!file)
+        throw std::runtime_error("Failed to create frame container " + path);
+
+    // Placeholder, finish() writes the real one
+    ContainerHeader header = {};
+    if (fwrite(&header, sizeof(header), 1, file) != 1)
+        throw std::runtime_error("Failed to write frame container " + path);
+}
+
+FrameContainerWriter::~FrameContainerWriter()
+{
+    if (file)
+        fclose(file);
+}
+
+void FrameContainerWriter::append(const unsigned char* rgbData)
+{
+    size_t frameSize = static_cast<size_t>(width) * height * CHANNELS;
+    const unsigned char* record = rgbData;
+    IndexEntry entry = { offset, static_cast<uint32_t>(frameSize), RECORD_RAW };
+    if (codec != FrameCodec::PPM)
+    {
+        if (codec == FrameCodec::QOI)
+            qoiEncode(rgbData, width, height, CHANNELS, compressed);
+        else
+            lz4Compress(rgbData, frameSize, compressed);
+        if (compressed.size() < frameSize)
+        {
+            record = compressed.data();
+            entry.size = static_cast<uint32_t>(compressed.size());
+            entry.flags = 0;
+        }
+    }
+
+    if (fwrite(record, 1, entry.size, file) != entry.size)
+        throw std::runtime_error("Failed to write frame " + std::to_string(index.size()) + " to " + path);
+    offset += entry.size;
+    index.push_back(entry);
+}
+
+void FrameContainerWriter::finish()
+{
+    if (!file)
+        return;
+
+    ContainerHeader header = {};
+    memcpy(header.magic, CONTAINER_MAGIC, sizeof(CONTAINER_MAGIC));
+    header.version = CONTAINER_VERSION;
+    header.width = width;
+    header.height = height;
+    header.channels = CHANNELS;
+    header.compression = headerCompression(codec);
+    header.frameCount = index.size();
+    header.frameStride = codec == FrameCodec::PPM ? static_cast<uint64_t>(width) * height * CHANNELS : 0;
+    header.indexOffset = offset;
+
+    bool written = true;
+    for (const IndexEntry& entry : index)
+    {
+        IndexRecord record = { entry.offset, entry.size, entry.flags };
+        written = written && fwrite(&record, sizeof(record), 1, file) == 1;
+    }
+    written = written && fseek(file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, file) == 1;
+    written = fclose(file) == 0 && written;
+    file = nullptr;
+    if (!written)
+        throw std::runtime_error("Failed to finish frame container " + path);
+}
+
+FrameContainer::FrameContainer(const std::string& path)
+    : path(path), mapped(nullptr), mappedSize(0), width(0), height(0), codec(FrameCodec::PPM),
+      frameCount(0), index(nullptr)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("Failed to open frame container " + path);
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(ContainerHeader))
+    {
+        close(fd);
+        throw std::runtime_error("Not a frame container : " + path);
+    }
+    void* memory = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED)
+        throw std::runtime_error("Failed to map frame container " + path);
+    mapped = static_cast<const unsigned char*>(memory);
+    mappedSize = info.st_size;
+    // Frames are mostly read front to back
+    madvise(memory, mappedSize, MADV_SEQUENTIAL);
+
+    ContainerHeader header;
+    memcpy(&header, mapped, sizeof(header));
+    if (memcmp(header.magic, CONTAINER_MAGIC, sizeof(CONTAINER_MAGIC)) != 0 || header.version != CONTAINER_VERSION ||
+        header.channels != CHANNELS || header.width == 0 || header.height == 0 ||
+        header.compression > COMPRESSION_QOI ||
+        header.indexOffset < sizeof(ContainerHeader) || header.indexOffset > mappedSize ||
+        header.frameCount > (mappedSize - header.indexOffset) / sizeof(IndexRecord))
+    {
+        munmap(memory, mappedSize);
+        throw std::runtime_error("Invalid or unfinished frame container " + path);
+    }
+
+    width = static_cast<int>(header.width);
+    height = static_cast<int>(header.height);
+    codec = header.compression == COMPRESSION_LZ4 ? FrameCodec::LZ4 :
+            header.compression == COMPRESSION_QOI ? FrameCodec::QOI : FrameCodec::PPM;
+    frameCount = header.frameCount;
+    index = mapped + header.indexOffset;
+}
+
+FrameContainer::~FrameContainer()
+{
+    if (mapped)
+        munmap(const_cast<unsigned char*>(mapped), mappedSize);
+}
+
+void FrameContainer::readFrame(size_t frame, std::vector<unsigned char>& rgbaData) const
+{
+    if (frame >= frameCount)
+        throw std::runtime_error("Frame " + std::to_string(frame) + " is past the end of " + path);
+
+    IndexRecord record;
+    memcpy(&record, index + frame * sizeof(IndexRecord), sizeof(record));
+    size_t pixels = static_cast<size_t>(width) * height;
+    if (record.offset > mappedSize || record.size > mappedSize - record.offset)
+        throw std::runtime_error("Frame " + std::to_string(frame) + " of " + path + " is out of bounds");
+
+    const unsigned char* rgb = mapped + record.offset;
+    std::vector<unsigned char> decompressed;
+    if (!(record.flags & RECORD_RAW) && codec == FrameCodec::QOI)
+    {
+        // Decodes straight to RGBA
+        int qoiWidth = 0, qoiHeight = 0;
+        if (!qoiDecode(rgb, record.size, rgbaData, qoiWidth, qoiHeight) || qoiWidth != width || qoiHeight != height)
+            throw std::runtime_error("Frame " + std::to_string(frame) + " of " + path + " is corrupt");
+        return;
+    }
+    if (!(record.flags & RECORD_RAW))
+    {
+        decompressed.resize(pixels * CHANNELS);
+        if (!lz4Decompress(rgb, record.size, decompressed.data(), decompressed.size()))
+            throw std::runtime_error("Frame " + std::to_string(frame) + " of " + path + " is corrupt");
+        rgb = decompressed.data();
+    }
+    else if (record.size != pixels * CHANNELS)
+        throw std::runtime_error("Frame " + std::to_string(frame) + " of " + path + " has the wrong size");
+
+    rgbaData.resize(pixels * 4);
+    for (size_t i = 0; i < pixels; i++)
+    {
+        rgbaData[i * 4 + 0] = rgb[i * 3 + 0];
+        rgbaData[i * 4 + 1] = rgb[i * 3 + 1];
+        rgbaData[i * 4 + 2] = rgb[i * 3 + 2];
+        rgbaData[i * 4 + 3] = 255;
+    }
+}
+
+bool FrameContainer::isContainer(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    char magic[4];
+    return file.read(magic, sizeof(magic)) && memcmp(magic, CONTAINER_MAGIC, sizeof(magic)) == 0;
+}
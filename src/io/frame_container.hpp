@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "frame_codec.hpp"
+
+/*
+A whole clip of RGB frames in one file instead of one PPM per frame : a 64 byte header, the frame
+records, then an index of { offset, size } per frame. The records follow --frame-codec : with PPM
+they are the bare rgb24 bodies at a fixed stride, so frame i is at header + i * stride; LZ4 and QOI
+records (one independent block / image per frame, stored raw when it doesn't shrink) are found
+through the index. The header is completed last, a container whose writer didn't finish reads as
+invalid rather than short.
+*/
+class FrameContainerWriter {
+public:
+    FrameContainerWriter(const std::string& path, int width, int height, FrameCodec codec);
+    ~FrameContainerWriter();
+    FrameContainerWriter(const FrameContainerWriter&) = delete;
+    FrameContainerWriter& operator=(const FrameContainerWriter&) = delete;
+
+    // Tightly packed width x height RGB, as rgb24 rawvideo or a PPM body
+    void append(const unsigned char* rgbData);
+    // Writes the index and completes the header
+    void finish();
+    size_t getFrameCount() const { return index.size(); }
+
+private:
+    struct IndexEntry {
+        uint64_t offset;
+        uint32_t size;
+        uint32_t flags;
+    };
+
+    std::string path;
+    FILE* file;
+    int width, height;
+    FrameCodec codec;
+    uint64_t offset;
+    std::vector<IndexEntry> index;
+    std::vector<uint8_t> compressed;
+};
+
+// Memory maps a container, random access to any frame, safe to read from several threads
+class FrameContainer {
+public:
+    explicit FrameContainer(const std::string& path);
+    ~FrameContainer();
+    FrameContainer(const FrameContainer&) = delete;
+    FrameContainer& operator=(const FrameContainer&) = delete;
+
+    size_t getFrameCount() const { return frameCount; }
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    FrameCodec getCodec() const { return codec; }
+
+    // Frame index as RGBA with alpha 255, the layout loadPPMImage produces
+    void readFrame(size_t index, std::vector<unsigned char>& rgbaData) const;
+
+    // True when path starts with the container magic
+    static bool isContainer(const std::string& path);
+
+private:
+    std::string path;
+    const unsigned char* mapped;
+    size_t mappedSize;
+    int width, height;
+    FrameCodec codec;
+    size_t frameCount;
+    const unsigned char* index;
+};
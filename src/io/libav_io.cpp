@@ -0,0 +1,445 @@
+#include "libav_io.hpp"
+#include <stdexcept>
+
+#ifdef NPLAYER_WITH_LIBAV
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+#include <libswscale/swscale.h>
+}
+
+namespace {
+    std::string avError(int code)
+    {
+        char message[AV_ERROR_MAX_STRING_SIZE] = {};
+        av_strerror(code, message, sizeof(message));
+        return message;
+    }
+
+    // 24000/1001 like ffprobe prints it, empty when unknown
+    std::string rationalText(AVRational rational)
+    {
+        if (rational.num <= 0 || rational.den <= 0)
+            return "";
+        return std::to_string(rational.num) + "/" + std::to_string(rational.den);
+    }
+
+    // The formats the raw frame paths carry, by their ffmpeg names
+    AVPixelFormat rawPixelFormat(const std::string& name)
+    {
+        AVPixelFormat format = av_get_pix_fmt(name.c_str());
+        if (format != AV_PIX_FMT_RGBA && format != AV_PIX_FMT_YUV420P && format != AV_PIX_FMT_NV12)
+            throw std::runtime_error("Unsupported raw pixel format " + name);
+        return format;
+    }
+
+    // Planes back to back without row padding, the layout of ffmpeg's rawvideo
+    void packFrame(const AVFrame* source, std::vector<unsigned char>& frame)
+    {
+        AVPixelFormat format = static_cast<AVPixelFormat>(source->format);
+        int size = av_image_get_buffer_size(format, source->width, source->height, 1);
+        frame.resize(size);
+        av_image_copy_to_buffer(frame.data(), size, source->data, source->linesize, format, source->width, source->height, 1);
+    }
+}
+
+bool libavAvailable()
+{
+    return true;
+}
+
+LibavDecoder::LibavDecoder(const std::string& videoPath, const std::string& pixelFormat)
+    : path(videoPath), info{ 0, 0, "", 0.0, "", "", "" }, format(nullptr), codec(nullptr), decoded(nullptr), converted(nullptr),
+      packet(nullptr), scaler(nullptr), streamIndex(-1), outputFormat(rawPixelFormat(pixelFormat)), draining(false), nextPts(0)
+{
+    try
+    {
+        int result = avformat_open_input(&format, videoPath.c_str(), nullptr, nullptr);
+        if (result < 0 || (result = avformat_find_stream_info(format, nullptr)) < 0)
+            throw std::runtime_error("Failed to open " + videoPath + " : " + avError(result));
+        streamIndex = av_find_best_stream(format, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+        if (streamIndex < 0)
+            throw std::runtime_error("No video stream in " + videoPath);
+
+        AVStream* stream = format->streams[streamIndex];
+        const AVCodec* decoder = avcodec_find_decoder(stream->codecpar->codec_id);
+        if (!decoder)
+            throw std::runtime_error("No decoder for the video stream of " + videoPath);
+        codec = avcodec_alloc_context3(decoder);
+        if (!codec || avcodec_parameters_to_context(codec, stream->codecpar) < 0)
+            throw std::runtime_error("Failed to set up the decoder for " + videoPath);
+        // One thread per core, frame and slice threading both work without a hardware decoder
+        codec->thread_count = 0;
+        codec->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+        codec->pkt_timebase = stream->time_base;
+        if ((result = avcodec_open2(codec, decoder, nullptr)) < 0)
+            throw std::runtime_error("Failed to open the decoder for " + videoPath + " : " + avError(result));
+
+        decoded = av_frame_alloc();
+        converted = av_frame_alloc();
+        packet = av_packet_alloc();
+        if (!decoded || !converted || !packet)
+            throw std::runtime_error("Out of memory opening " + videoPath);
+
+        info.width = codec->width;
+        info.height = codec->height;
+        const char* colorSpace = av_color_space_name(stream->codecpar->color_space);
+        if (stream->codecpar->color_space != AVCOL_SPC_UNSPECIFIED && colorSpace)
+            info.colorSpace = colorSpace;
+        if (format->duration != AV_NOPTS_VALUE)
+            info.duration = format->duration / static_cast<double>(AV_TIME_BASE);
+        info.frameRate = rationalText(stream->r_frame_rate);
+        info.averageFrameRate = rationalText(stream->avg_frame_rate);
+        info.timeBase = rationalText(stream->time_base);
+        if (info.width <= 0 || info.height <= 0)
+            throw std::runtime_error("Failed to probe video dimensions : " + videoPath);
+    }
+    catch (...)
+    {
+        release();
+        throw;
+    }
+}
+
+LibavDecoder::~LibavDecoder()
+{
+    release();
+}
+
+void LibavDecoder::release()
+{
+    sws_freeContext(scaler);
+    scaler = nullptr;
+    av_packet_free(&packet);
+    av_frame_free(&converted);
+    av_frame_free(&decoded);
+    avcodec_free_context(&codec);
+    avformat_close_input(&format);
+}
+
+bool LibavDecoder::readFrame(std::vector<unsigned char>& frame, int64_t& pts)
+{
+    while (true)
+    {
+        int result = avcodec_receive_frame(codec, decoded);
+        if (result == AVERROR_EOF)
+            return false;
+        if (result >= 0)
+            break;
+        if (result != AVERROR(EAGAIN))
+            throw std::runtime_error("Failed to decode " + path + " : " + avError(result));
+
+        // The decoder wants more input
+        result = av_read_frame(format, packet);
+        if (result == AVERROR_EOF)
+        {
+            if (draining)
+                return false;
+            // Flush, the frames still in the decoder come out before AVERROR_EOF
+            avcodec_send_packet(codec, nullptr);
+            draining = true;
+            continue;
+        }
+        if (result < 0)
+            throw std::runtime_error("Failed to read " + path + " : " + avError(result));
+        if (packet->stream_index == streamIndex)
+            result = avcodec_send_packet(codec, packet);
+        av_packet_unref(packet);
+        // Like the ffmpeg tool, a corrupt packet costs its frame rather than the whole job
+        if (result < 0 && result != AVERROR_INVALIDDATA)
+            throw std::runtime_error("Failed to decode " + path + " : " + avError(result));
+    }
+
+    if (decoded->width != info.width || decoded->height != info.height)
+    {
+        av_frame_unref(decoded);
+        throw std::runtime_error("The frame size of " + path + " changes mid stream");
+    }
+
+    AVStream* stream = format->streams[streamIndex];
+    pts = decoded->best_effort_timestamp != AV_NOPTS_VALUE ? decoded->best_effort_timestamp : nextPts;
+    AVRational rate = av_guess_frame_rate(format, stream, decoded);
+    int64_t duration = rate.num > 0 ? av_rescale_q(1, av_inv_q(rate), stream->time_base) : 1;
+    nextPts = pts + (duration > 0 ? duration : 1);
+
+    if (decoded->format == outputFormat)
+        packFrame(decoded, frame);
+    else
+    {
+        AVPixelFormat sourceFormat = static_cast<AVPixelFormat>(decoded->format);
+        AVPixelFormat targetFormat = static_cast<AVPixelFormat>(outputFormat);
+        scaler = sws_getCachedContext(scaler, info.width, info.height, sourceFormat, info.width, info.height, targetFormat,
+                                      SWS_BILINEAR, nullptr, nullptr, nullptr);
+        if (!scaler)
+            throw std::runtime_error("Can't convert the frames of " + path + " to " + av_get_pix_fmt_name(targetFormat));
+        if (targetFormat == AV_PIX_FMT_RGBA)
+        {
+            // Same matrix choice as the GPU path, BT.709 when the stream says so
+            int matrix = decoded->colorspace == AVCOL_SPC_BT709 ? SWS_CS_ITU709 : SWS_CS_DEFAULT;
+            sws_setColorspaceDetails(scaler, sws_getCoefficients(matrix), decoded->color_range == AVCOL_RANGE_JPEG,
+                                     sws_getCoefficients(SWS_CS_DEFAULT), 1, 0, 1 << 16, 1 << 16);
+        }
+        if (!converted->data[0])
+        {
+            converted->format = targetFormat;
+            converted->width = info.width;
+            converted->height = info.height;
+            if (av_frame_get_buffer(converted, 0) < 0)
+                throw std::runtime_error("Out of memory decoding " + path);
+        }
+        sws_scale(scaler, decoded->data, decoded->linesize, 0, info.height, converted->data, converted->linesize);
+        packFrame(converted, frame);
+    }
+    av_frame_unref(decoded);
+    return true;
+}
+
+LibavEncoder::LibavEncoder(const std::string& outputVideo, const LibavDecoder& source, const std::string& pixelFormat)
+    : path(outputVideo), output(nullptr), codec(nullptr), encodeFrame(nullptr), packet(nullptr), scaler(nullptr),
+      inputFormat(rawPixelFormat(pixelFormat)), width(source.info.width), height(source.info.height), videoStream(-1),
+      lastPts(AV_NOPTS_VALUE), finished(false), audioInput(nullptr), audioPacket(nullptr), audioSourceStream(-1),
+      audioStream(-1), audioPending(false)
+{
+    try
+    {
+        // libx264 takes yuv420p and nv12 directly, rgba is converted to yuv420p
+        AVPixelFormat encodeFormat = inputFormat == AV_PIX_FMT_NV12 ? AV_PIX_FMT_NV12 : AV_PIX_FMT_YUV420P;
+        int result = avformat_alloc_output_context2(&output, nullptr, nullptr, outputVideo.c_str());
+        if (result < 0 || !output)
+            throw std::runtime_error("Failed to create " + outputVideo + " : " + avError(result));
+
+        const AVCodec* encoder = avcodec_find_encoder_by_name("libx264");
+        if (!encoder)
+            encoder = avcodec_find_encoder(AV_CODEC_ID_H264);
+        if (!encoder)
+            throw std::runtime_error("No H.264 encoder in this libavcodec");
+        codec = avcodec_alloc_context3(encoder);
+        if (!codec)
+            throw std::runtime_error("Out of memory creating " + outputVideo);
+
+        // Timestamps stay in the source's time base, so they go through unchanged
+        AVStream* sourceStream = source.format->streams[source.streamIndex];
+        codec->width = width;
+        codec->height = height;
+        codec->pix_fmt = encodeFormat;
+        codec->time_base = sourceStream->time_base;
+        codec->framerate = av_guess_frame_rate(source.format, sourceStream, nullptr);
+        codec->sample_aspect_ratio = source.codec->sample_aspect_ratio;
+        codec->thread_count = 0;
+        codec->thread_type = FF_THREAD_FRAME;
+        if (output->oformat->flags & AVFMT_GLOBALHEADER)
+            codec->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+        if ((result = avcodec_open2(codec, encoder, nullptr)) < 0)
+            throw std::runtime_error("Failed to open the H.264 encoder : " + avError(result));
+
+        AVStream* stream = avformat_new_stream(output, nullptr);
+        if (!stream || avcodec_parameters_from_context(stream->codecpar, codec) < 0)
+            throw std::runtime_error("Failed to add the video stream to " + outputVideo);
+        stream->time_base = codec->time_base;
+        stream->sample_aspect_ratio = codec->sample_aspect_ratio;
+        videoStream = stream->index;
+
+        // Audio is optional, silent clips still encode
+        if (avformat_open_input(&audioInput, source.path.c_str(), nullptr, nullptr) == 0 &&
+            avformat_find_stream_info(audioInput, nullptr) >= 0)
+            audioSourceStream = av_find_best_stream(audioInput, AVMEDIA_TYPE_AUDIO, -1, -1, nullptr, 0);
+        if (audioSourceStream >= 0)
+        {
+            AVStream* sourceAudio = audioInput->streams[audioSourceStream];
+            AVStream* audio = avformat_new_stream(output, nullptr);
+            if (!audio || avcodec_parameters_copy(audio->codecpar, sourceAudio->codecpar) < 0)
+                throw std::runtime_error("Failed to add the audio stream to " + outputVideo);
+            audio->codecpar->codec_tag = 0;
+            audio->time_base = sourceAudio->time_base;
+            audioStream = audio->index;
+            audioPacket = av_packet_alloc();
+        }
+        else
+            avformat_close_input(&audioInput);
+
+        if (!(output->oformat->flags & AVFMT_NOFILE) && (result = avio_open(&output->pb, outputVideo.c_str(), AVIO_FLAG_WRITE)) < 0)
+            throw std::runtime_error("Failed to open " + outputVideo + " : " + avError(result));
+        if ((result = avformat_write_header(output, nullptr)) < 0)
+            throw std::runtime_error("Failed to write the header of " + outputVideo + " : " + avError(result));
+
+        encodeFrame = av_frame_alloc();
+        packet = av_packet_alloc();
+        if (!encodeFrame || !packet)
+            throw std::runtime_error("Out of memory creating " + outputVideo);
+        encodeFrame->format = encodeFormat;
+        encodeFrame->width = width;
+        encodeFrame->height = height;
+        if (av_frame_get_buffer(encodeFrame, 0) < 0)
+            throw std::runtime_error("Out of memory creating " + outputVideo);
+        if (inputFormat != encodeFormat)
+        {
+            scaler = sws_getContext(width, height, static_cast<AVPixelFormat>(inputFormat), width, height, encodeFormat,
+                                    SWS_BILINEAR, nullptr, nullptr, nullptr);
+            if (!scaler)
+                throw std::runtime_error("Can't convert " + pixelFormat + " frames for the encoder");
+        }
+    }
+    catch (...)
+    {
+        release();
+        throw;
+    }
+}
+
+LibavEncoder::~LibavEncoder()
+{
+    release();
+}
+
+void LibavEncoder::release()
+{
+    sws_freeContext(scaler);
+    scaler = nullptr;
+    av_packet_free(&audioPacket);
+    avformat_close_input(&audioInput);
+    av_packet_free(&packet);
+    av_frame_free(&encodeFrame);
+    avcodec_free_context(&codec);
+    if (output)
+    {
+        if (!(output->oformat->flags & AVFMT_NOFILE))
+            avio_closep(&output->pb);
+        avformat_free_context(output);
+        output = nullptr;
+    }
+}
+
+void LibavEncoder::writeFrame(const std::vector<unsigned char>& frame, int64_t pts)
+{
+    AVPixelFormat format = static_cast<AVPixelFormat>(inputFormat);
+    if (frame.size() != static_cast<size_t>(av_image_get_buffer_size(format, width, height, 1)))
+        throw std::runtime_error("Wrong frame size for the encoder");
+
+    // The encoder may still hold the previous frame's buffer
+    if (av_frame_make_writable(encodeFrame) < 0)
+        throw std::runtime_error("Out of memory encoding " + path);
+    uint8_t* planes[4];
+    int linesizes[4];
+    av_image_fill_arrays(planes, linesizes, frame.data(), format, width, height, 1);
+    const uint8_t* source[4] = { planes[0], planes[1], planes[2], planes[3] };
+    if (scaler)
+        sws_scale(scaler, source, linesizes, 0, height, encodeFrame->data, encodeFrame->linesize);
+    else
+        av_image_copy(encodeFrame->data, encodeFrame->linesize, source, linesizes, format, width, height);
+
+    // Encoders need strictly increasing timestamps, broken streams can repeat one
+    if (lastPts != AV_NOPTS_VALUE && pts <= lastPts)
+        pts = lastPts + 1;
+    lastPts = pts;
+    encodeFrame->pts = pts;
+
+    int result = avcodec_send_frame(codec, encodeFrame);
+    if (result < 0)
+        throw std::runtime_error("Failed to encode a frame of " + path + " : " + avError(result));
+    writePackets();
+    copyAudio(pts, false);
+}
+
+void LibavEncoder::finish()
+{
+    if (finished)
+        return;
+    finished = true;
+
+    avcodec_send_frame(codec, nullptr);
+    writePackets();
+    copyAudio(0, true);
+    int result = av_write_trailer(output);
+    if (result < 0)
+        throw std::runtime_error("Failed to finish " + path + " : " + avError(result));
+}
+
+void LibavEncoder::writePackets()
+{
+    AVStream* stream = output->streams[videoStream];
+    while (true)
+    {
+        int result = avcodec_receive_packet(codec, packet);
+        if (result == AVERROR(EAGAIN) || result == AVERROR_EOF)
+            return;
+        if (result < 0)
+            throw std::runtime_error("Failed to encode " + path + " : " + avError(result));
+        av_packet_rescale_ts(packet, codec->time_base, stream->time_base);
+        packet->stream_index = videoStream;
+        // Takes the packet's data, leaves it blank for the next one
+        if ((result = av_interleaved_write_frame(output, packet)) < 0)
+            throw std::runtime_error("Failed to write " + path + " : " + avError(result));
+    }
+}
+
+void LibavEncoder::copyAudio(int64_t pts, bool flush)
+{
+    while (audioInput)
+    {
+        if (!audioPending)
+        {
+            int result = av_read_frame(audioInput, audioPacket);
+            if (result < 0)
+            {
+                // End of the source's audio
+                avformat_close_input(&audioInput);
+                return;
+            }
+            if (audioPacket->stream_index != audioSourceStream)
+            {
+                av_packet_unref(audioPacket);
+                continue;
+            }
+            audioPending = true;
+        }
+
+        AVRational sourceTimeBase = audioInput->streams[audioSourceStream]->time_base;
+        int64_t timestamp = audioPacket->pts != AV_NOPTS_VALUE ? audioPacket->pts : audioPacket->dts;
+        // Ahead of the video, wait for the next frame
+        if (!flush && timestamp != AV_NOPTS_VALUE && av_compare_ts(timestamp, sourceTimeBase, pts, codec->time_base) > 0)
+            return;
+
+        av_packet_rescale_ts(audioPacket, sourceTimeBase, output->streams[audioStream]->time_base);
+        audioPacket->stream_index = audioStream;
+        audioPacket->pos = -1;
+        audioPending = false;
+        int result = av_interleaved_write_frame(output, audioPacket);
+        if (result < 0)
+            throw std::runtime_error("Failed to write audio to " + path + " : " + avError(result));
+    }
+}
+
+#else
+
+bool libavAvailable()
+{
+    return false;
+}
+
+LibavDecoder::LibavDecoder(const std::string&, const std::string&)
+{
+    throw std::runtime_error("Built without libav, configure with -DNPLAYER_WITH_LIBAV=ON");
+}
+
+LibavDecoder::~LibavDecoder() {}
+
+bool LibavDecoder::readFrame(std::vector<unsigned char>&, int64_t&)
+{
+    return false;
+}
+
+LibavEncoder::LibavEncoder(const std::string&, const LibavDecoder&, const std::string&)
+{
+    throw std::runtime_error("Built without libav, configure with -DNPLAYER_WITH_LIBAV=ON");
+}
+
+LibavEncoder::~LibavEncoder() {}
+
+void LibavEncoder::writeFrame(const std::vector<unsigned char>&, int64_t) {}
+
+void LibavEncoder::finish() {}
+
+#endif
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "video_io.hpp"
+
+struct AVFormatContext;
+struct AVCodecContext;
+struct AVFrame;
+struct AVPacket;
+struct SwsContext;
+
+// True when built with NPLAYER_WITH_LIBAV, otherwise the classes below throw on construction
+bool libavAvailable();
+
+/*
+In process decoding with libavformat / libavcodec instead of an ffmpeg process over a pipe. The
+codec decodes on as many threads as it supports (frame and slice threading, no hardware
+decoder needed) and every frame is delivered in the same tightly packed layout the rawvideo pipe
+produces (pixelFormat is the ffmpeg name : rgba, yuv420p, nv12), converting with swscale only
+when the stream isn't already in that format. The frames come at the source's own timestamps,
+nothing is dropped or duplicated to a fixed rate.
+*/
+class LibavDecoder {
+public:
+    LibavDecoder(const std::string& videoPath, const std::string& pixelFormat);
+    ~LibavDecoder();
+    LibavDecoder(const LibavDecoder&) = delete;
+    LibavDecoder& operator=(const LibavDecoder&) = delete;
+
+    // Next frame into frame (resized once, then reused), pts in the stream's time base; false at the end
+    bool readFrame(std::vector<unsigned char>& frame, int64_t& pts);
+    VideoInfo getInfo() const { return info; }
+    const std::string& getPath() const { return path; }
+
+private:
+    friend class LibavEncoder;
+    void release();
+
+    std::string path;
+    VideoInfo info;
+    AVFormatContext* format;
+    AVCodecContext* codec;
+    AVFrame* decoded;
+    AVFrame* converted;
+    AVPacket* packet;
+    SwsContext* scaler;
+    int streamIndex;
+    int outputFormat;
+    bool draining;
+    int64_t nextPts;
+};
+
+/*
+In process H.264 encoding (libx264 with frame threading) and muxing. Takes frames in the packed
+layout the pipe encoder does (rgba, yuv420p or nv12; rgba is converted to yuv420p with swscale)
+with the pts LibavDecoder gave them, in the source's time base, and copies the source's audio
+packets through untouched, interleaved with the video as it goes.
+*/
+class LibavEncoder {
+public:
+    LibavEncoder(const std::string& outputVideo, const LibavDecoder& source, const std::string& pixelFormat);
+    ~LibavEncoder();
+    LibavEncoder(const LibavEncoder&) = delete;
+    LibavEncoder& operator=(const LibavEncoder&) = delete;
+
+    void writeFrame(const std::vector<unsigned char>& frame, int64_t pts);
+    // Drains the encoder, copies the remaining audio and writes the trailer
+    void finish();
+
+private:
+    std::string path;
+    AVFormatContext* output;
+    AVCodecContext* codec;
+    AVFrame* encodeFrame;
+    AVPacket* packet;
+    SwsContext* scaler;
+    int inputFormat;
+    int width, height;
+    int videoStream;
+    int64_t lastPts;
+    bool finished;
+
+    // Source audio, read ahead one packet at a time
+    AVFormatContext* audioInput;
+    AVPacket* audioPacket;
+    int audioSourceStream, audioStream;
+    bool audioPending;
+
+    void release();
+    void writePackets();
+    // Copies source audio up to the video position pts (in the encoder's time base), all of it when flush
+    void copyAudio(int64_t pts, bool flush);
+};
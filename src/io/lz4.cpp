@@ -0,0 +1,181 @@
+#include "lz4.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+    const int MIN_MATCH = 4;
+    // The format wants the last 5 bytes as literals and no match starting in the last 12
+    const size_t LAST_LITERALS = 5;
+    const size_t MATCH_START_MARGIN = 12;
+    const size_t MAX_OFFSET = 65535;
+    // 16 KB table like the reference fast mode, it stays in L1 where a bigger one misses on every probe
+    const int HASH_BITS = 12;
+    // The search step grows by one every 2^SKIP_TRIGGER misses in a row, so noisy stretches
+    // (sensor noise, film grain) go by quickly instead of being hashed byte by byte
+    const int SKIP_TRIGGER = 6;
+
+    uint32_t read32(const uint8_t* p) { uint32_t value; memcpy(&value, p, 4); return value; }
+    uint64_t read64(const uint8_t* p) { uint64_t value; memcpy(&value, p, 8); return value; }
+
+    // Hashes the 5 bytes at p, 4 byte hashes keep finding 4 byte matches in noisy pixels that cost
+    // about as much to encode as the literals they replace
+    uint32_t hashSequence(const uint8_t* p)
+    {
+        return static_cast<uint32_t>(((read64(p) << 24) * 889523592379ull) >> (64 - HASH_BITS));
+    }
+
+    // Lengths past the 4 bit token field continue in 255 valued bytes
+    uint8_t* writeLength(uint8_t* op, size_t length)
+    {
+        for (; length >= 255; length -= 255)
+            *op++ = 255;
+        *op++ = static_cast<uint8_t>(length);
+        return op;
+    }
+
+    uint8_t* writeSequence(uint8_t* op, const uint8_t* literals, size_t literalLength,
+                           size_t offset, size_t matchLength, bool last)
+    {
+        size_t matchCode = last ? 0 : matchLength - MIN_MATCH;
+        *op++ = static_cast<uint8_t>((literalLength >= 15 ? 15 : literalLength) << 4 |
+                                     (matchCode >= 15 ? 15 : matchCode));
+        if (literalLength >= 15)
+            op = writeLength(op, literalLength - 15);
+        memcpy(op, literals, literalLength);
+        op += literalLength;
+        if (last)
+            return op;
+
+        *op++ = static_cast<uint8_t>(offset & 0xFF);
+        *op++ = static_cast<uint8_t>(offset >> 8);
+        if (matchCode >= 15)
+            op = writeLength(op, matchCode - 15);
+        return op;
+    }
+
+    bool readLength(const uint8_t*& ip, const uint8_t* end, size_t& length)
+    {
+        uint8_t byte;
+        do
+        {
+            if (ip >= end)
+                return false;
+            byte = *ip++;
+            length += byte;
+        } while (byte == 255);
+        return true;
+    }
+}
+
+void lz4Compress(const uint8_t* src, size_t srcSize, std::vector<uint8_t>& dst)
+{
+    // Room for the worst case (all literals), trimmed to what was written at the end
+    dst.resize(srcSize + srcSize / 255 + 16);
+    uint8_t* op = dst.data();
+
+    size_t anchor = 0;
+    if (srcSize > MATCH_START_MARGIN)
+    {
+        // Positions + 1, 0 is empty
+        std::vector<uint32_t> table(size_t(1) << HASH_BITS, 0);
+        size_t matchStartLimit = srcSize - MATCH_START_MARGIN;
+        size_t matchEndLimit = srcSize - LAST_LITERALS;
+
+        size_t ip = 0;
+        size_t misses = 0;
+        while (ip < matchStartLimit)
+        {
+            uint32_t sequence = read32(src + ip);
+            uint32_t& slot = table[hashSequence(src + ip)];
+            size_t candidate = slot;
+            slot = static_cast<uint32_t>(ip + 1);
+            if (candidate == 0 || ip - (candidate - 1) > MAX_OFFSET || read32(src + candidate - 1) != sequence)
+            {
+                ip += 1 + (misses++ >> SKIP_TRIGGER);
+                continue;
+            }
+            misses = 0;
+
+            // Skipped positions may hide the start of the match, grow it back over the literals
+            size_t ref = candidate - 1;
+            while (ip > anchor && ref > 0 && src[ip - 1] == src[ref - 1])
+            {
+                ip--;
+                ref--;
+            }
+
+            // 8 bytes at a time, then byte by byte for the tail
+            size_t end = ip + MIN_MATCH;
+            size_t distance = ip - ref;
+            while (end + 8 <= matchEndLimit && read64(src + end) == read64(src + end - distance))
+                end += 8;
+            while (end < matchEndLimit && src[end] == src[end - distance])
+                end++;
+
+            op = writeSequence(op, src + anchor, ip - anchor, distance, end - ip, false);
+            ip = end;
+            anchor = ip;
+
+            // The bytes just matched are often repeated soon, keep one of them findable
+            if (ip < matchStartLimit)
+                table[hashSequence(src + ip - 2)] = static_cast<uint32_t>(ip - 2 + 1);
+        }
+    }
+    op = writeSequence(op, src + anchor, srcSize - anchor, 0, 0, true);
+    dst.resize(op - dst.data());
+}
+
+bool lz4Decompress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize)
+{
+    const uint8_t* ip = src;
+    const uint8_t* end = src + srcSize;
+    size_t op = 0;
+
+    while (ip < end)
+    {
+        uint8_t token = *ip++;
+        size_t literalLength = token >> 4;
+        if (literalLength == 15 && !readLength(ip, end, literalLength))
+            return false;
+        if (literalLength > static_cast<size_t>(end - ip) || literalLength > dstSize - op)
+            return false;
+        memcpy(dst + op, ip, literalLength);
+        ip += literalLength;
+        op += literalLength;
+
+        // The last sequence stops after its literals
+        if (ip == end)
+            break;
+
+        if (end - ip < 2)
+            return false;
+        size_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > op)
+            return false;
+
+        size_t matchLength = token & 15;
+        if (matchLength == 15 && !readLength(ip, end, matchLength))
+            return false;
+        matchLength += MIN_MATCH;
+        if (matchLength > dstSize - op)
+            return false;
+
+        // Matches may overlap what they produce : copy the repeating period, which doubles with
+        // every copy, instead of going byte by byte
+        uint8_t* out = dst + op;
+        if (offset >= matchLength)
+            memcpy(out, out - offset, matchLength);
+        else
+        {
+            for (size_t copied = 0; copied < matchLength;)
+            {
+                size_t chunk = std::min(offset + copied, matchLength - copied);
+                memcpy(out + copied, out - offset, chunk);
+                copied += chunk;
+            }
+        }
+        op += matchLength;
+    }
+    return op == dstSize;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+LZ4 block format (no frame header, sizes are kept by the caller), so containers can compress
+frames without a dependency. The compressor is the greedy single hash table one of the
+reference fast mode (5 byte hash, 16 KB table, skipping ahead faster the longer it goes without
+a match), the output is readable by any LZ4 block decoder. lz4Decompress checks every offset and length and
+returns false on malformed input or when the output isn't exactly dstSize bytes.
+*/
+void lz4Compress(const uint8_t* src, size_t srcSize, std::vector<uint8_t>& dst);
+bool lz4Decompress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize);
@@ -0,0 +1,177 @@
+#include "qoi.hpp"
+#include <cstring>
+
+namespace {
+    const uint8_t OP_INDEX = 0x00;
+    const uint8_t OP_DIFF = 0x40;
+    const uint8_t OP_LUMA = 0x80;
+    const uint8_t OP_RUN = 0xC0;
+    const uint8_t OP_RGB = 0xFE;
+    const uint8_t OP_RGBA = 0xFF;
+    const uint8_t OP_MASK = 0xC0;
+    const int MAX_RUN = 62;
+    const size_t HEADER_SIZE = 14;
+    // The reference implementation's limit, guards the allocation against a corrupt header
+    const uint64_t MAX_PIXELS = 400000000;
+    const uint8_t END_MARKER[8] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+
+    struct Pixel {
+        uint8_t r, g, b, a;
+        bool operator==(const Pixel& other) const
+        {
+            return r == other.r && g == other.g && b == other.b && a == other.a;
+        }
+    };
+
+    int pixelHash(const Pixel& p)
+    {
+        return (p.r * 3 + p.g * 5 + p.b * 7 + p.a * 11) % 64;
+    }
+
+    void write32(std::vector<uint8_t>& dst, uint32_t value)
+    {
+        dst.push_back(static_cast<uint8_t>(value >> 24));
+        dst.push_back(static_cast<uint8_t>(value >> 16));
+        dst.push_back(static_cast<uint8_t>(value >> 8));
+        dst.push_back(static_cast<uint8_t>(value));
+    }
+
+    uint32_t read32(const uint8_t* p)
+    {
+        return uint32_t(p[0]) << 24 | uint32_t(p[1]) << 16 | uint32_t(p[2]) << 8 | p[3];
+    }
+}
+
+void qoiEncode(const unsigned char* src, int width, int height, int srcChannels, std::vector<uint8_t>& dst)
+{
+    size_t pixels = static_cast<size_t>(width) * height;
+    dst.clear();
+    // Worst case is an OP_RGB per pixel
+    dst.reserve(HEADER_SIZE + pixels * 4 + sizeof(END_MARKER));
+    dst.insert(dst.end(), { 'q', 'o', 'i', 'f' });
+    write32(dst, width);
+    write32(dst, height);
+    dst.push_back(3);   // Channels
+    dst.push_back(0);   // sRGB
+
+    Pixel index[64] = {};
+    Pixel previous = { 0, 0, 0, 255 };
+    int run = 0;
+    for (size_t i = 0; i < pixels; i++)
+    {
+        const unsigned char* p = src + i * srcChannels;
+        Pixel pixel = { p[0], p[1], p[2], 255 };
+        if (pixel == previous)
+        {
+            if (++run == MAX_RUN || i + 1 == pixels)
+            {
+                dst.push_back(OP_RUN | (run - 1));
+                run = 0;
+            }
+            continue;
+        }
+        if (run > 0)
+        {
+            dst.push_back(OP_RUN | (run - 1));
+            run = 0;
+        }
+
+        int hash = pixelHash(pixel);
+        if (index[hash] == pixel)
+            dst.push_back(OP_INDEX | hash);
+        else
+        {
+            index[hash] = pixel;
+            // Channel differences wrap around like the decoder's uint8 arithmetic
+            int8_t dr = static_cast<int8_t>(pixel.r - previous.r);
+            int8_t dg = static_cast<int8_t>(pixel.g - previous.g);
+            int8_t db = static_cast<int8_t>(pixel.b - previous.b);
+            int drg = dr - dg, dbg = db - dg;
+            if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1)
+                dst.push_back(OP_DIFF | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2));
+            else if (dg >= -32 && dg <= 31 && drg >= -8 && drg <= 7 && dbg >= -8 && dbg <= 7)
+            {
+                dst.push_back(OP_LUMA | (dg + 32));
+                dst.push_back(static_cast<uint8_t>((drg + 8) << 4 | (dbg + 8)));
+            }
+            else
+                dst.insert(dst.end(), { OP_RGB, pixel.r, pixel.g, pixel.b });
+        }
+        previous = pixel;
+    }
+    dst.insert(dst.end(), END_MARKER, END_MARKER + sizeof(END_MARKER));
+}
+
+bool qoiDecode(const uint8_t* src, size_t srcSize, std::vector<unsigned char>& rgbaData, int& width, int& height)
+{
+    if (srcSize < HEADER_SIZE + sizeof(END_MARKER) || memcmp(src, "qoif", 4) != 0)
+        return false;
+    uint32_t fileWidth = read32(src + 4), fileHeight = read32(src + 8);
+    uint8_t channels = src[12];
+    if (fileWidth == 0 || fileHeight == 0 || static_cast<uint64_t>(fileWidth) * fileHeight > MAX_PIXELS ||
+        (channels != 3 && channels != 4))
+        return false;
+
+    size_t pixels = static_cast<size_t>(fileWidth) * fileHeight;
+    rgbaData.resize(pixels * 4);
+    const uint8_t* ip = src + HEADER_SIZE;
+    const uint8_t* end = src + srcSize - sizeof(END_MARKER);
+
+    Pixel index[64] = {};
+    Pixel pixel = { 0, 0, 0, 255 };
+    int run = 0;
+    for (size_t i = 0; i < pixels; i++)
+    {
+        if (run > 0)
+            run--;
+        else
+        {
+            if (ip >= end)
+                return false;
+            uint8_t op = *ip++;
+            if (op == OP_RGB || op == OP_RGBA)
+            {
+                size_t bytes = op == OP_RGB ? 3 : 4;
+                if (static_cast<size_t>(end - ip) < bytes)
+                    return false;
+                pixel.r = ip[0];
+                pixel.g = ip[1];
+                pixel.b = ip[2];
+                if (op == OP_RGBA)
+                    pixel.a = ip[3];
+                ip += bytes;
+            }
+            else if ((op & OP_MASK) == OP_INDEX)
+                pixel = index[op];
+            else if ((op & OP_MASK) == OP_DIFF)
+            {
+                pixel.r += ((op >> 4) & 3) - 2;
+                pixel.g += ((op >> 2) & 3) - 2;
+                pixel.b += (op & 3) - 2;
+            }
+            else if ((op & OP_MASK) == OP_LUMA)
+            {
+                if (ip >= end)
+                    return false;
+                int dg = (op & 0x3F) - 32;
+                uint8_t next = *ip++;
+                pixel.r += dg + ((next >> 4) & 15) - 8;
+                pixel.g += dg;
+                pixel.b += dg + (next & 15) - 8;
+            }
+            else
+                run = op & 0x3F;
+            index[pixelHash(pixel)] = pixel;
+        }
+
+        unsigned char* out = rgbaData.data() + i * 4;
+        out[0] = pixel.r;
+        out[1] = pixel.g;
+        out[2] = pixel.b;
+        out[3] = 255;
+    }
+
+    width = static_cast<int>(fileWidth);
+    height = static_cast<int>(fileHeight);
+    return true;
+}
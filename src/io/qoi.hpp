@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+QOI ("Quite OK Image", qoiformat.org) : lossless, one pass, no entropy coder, so it encodes and
+decodes at memory speed while still taking real footage to a half or a third of its raw size.
+Files are written with 3 channels (the frames carry no alpha, like PPM) and a standard header,
+so ffmpeg and image viewers read them directly. srcChannels is the layout of the input pixels,
+3 for RGB or 4 for RGBA (alpha ignored); decoding always gives RGBA with alpha 255. qoiDecode
+returns false on malformed or truncated input.
+*/
+void qoiEncode(const unsigned char* src, int width, int height, int srcChannels, std::vector<uint8_t>& dst);
+bool qoiDecode(const uint8_t* src, size_t srcSize, std::vector<unsigned char>& rgbaData, int& width, int& height);
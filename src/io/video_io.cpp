@@ -1,5 +1,12 @@
 #include "video_io.hpp"
 #include <iostream>
+#include <sstream>
+#include <fstream>
+#include <algorithm>
+#include <cstdlib>
+#include <cmath>
+#include <iomanip>
+#include <filesystem>
 
 
 /*
@@ -18,28 +25,432 @@ bool checkFFMPEG() {
     return system("ffmpeg -version > /dev/null 2>&1") == 0;
 }
 
-void extractFrames(const std::string& videoPath, const std::string& outputDir)
+namespace {
+    // Every source frame exactly once at its own timestamp (-fps_mode in newer ffmpeg, this spelling works on 4.x too)
+    const char* PASSTHROUGH = "-vsync passthrough";
+    // Constant rate intervals only differ by timestamp rounding (33 / 34 ms for 29.97 fps in a millisecond
+    // time base), a dropped or held frame is well beyond this fraction of the typical interval
+    const double VARIABLE_RATE_TOLERANCE = 0.25;
+
+    // 24000/1001 or 30, 0 when unknown (ffprobe reports 0/0)
+    double parseRate(const std::string& rate)
+    {
+        size_t separator = rate.find('/');
+        double num = std::atof(rate.substr(0, separator).c_str());
+        double den = separator == std::string::npos ? 1.0 : std::atof(rate.substr(separator + 1).c_str());
+        return num > 0.0 && den > 0.0 ? num / den : 0.0;
+    }
+
+    /*
+    The concat demuxer's list, every frame followed by how long it is shown. Durations are taken
+    between the frame times rounded to microseconds (the list's resolution), so they add up to
+    exactly the source's times instead of drifting by a rounding error per frame. The demuxer
+    keeps its first input's time base, which for a single image is 1/25 s, so every image is
+    opened at a 90 kHz rate instead to keep the times from snapping to a 25 fps grid.
+    */
+    void writeFrameList(const std::string& listPath, const std::string& inputFramesDir, const std::string& extension,
+                        const FrameTiming& timing)
+    {
+        std::ofstream list(listPath);
+        if (!list)
+            throw std::runtime_error("Failed to write frame list " + listPath);
+        const std::vector<double>& times = timing.times;
+        double averageFrameTime = times.size() > 1 ? (times.back() - times.front()) / (times.size() - 1)
+                                                   : 1.0 / std::max(parseRate(timing.rate), 1.0);
+        auto micros = [&](size_t i) {
+            double time = i < times.size() ? times[i] - times.front()
+                                           : times.back() - times.front() + (i - times.size() + 1) * averageFrameTime;
+            return std::llround(time * 1e6);
+        };
+
+        list << "ffconcat version 1.0\n";
+        for (size_t i = 0; ; i++)
+        {
+            std::string name = "processed_frame_" + std::to_string(i + 1) + extension;
+            if (!std::filesystem::exists(inputFramesDir + "/" + name))
+                break;
+            long long duration = times.empty() ? std::llround(averageFrameTime * 1e6) : micros(i + 1) - micros(i);
+            list << "file '" << name << "'\noption framerate 90000\nduration " << duration / 1000000 << "."
+                 << std::setw(6) << std::setfill('0') << duration % 1000000 << "\n";
+        }
+        if (!list)
+            throw std::runtime_error("Failed to write frame list " + listPath);
+    }
+
+    // PPM copies of the LZ4 frames next to them
+    void decodeFramesToPpm(const std::string& framesPath)
+    {
+        std::vector<unsigned char> frame;
+        for (int i = 1; ; i++)
+        {
+            std::string path = framesPath + std::to_string(i) + frameCodecExtension(FrameCodec::LZ4);
+            if (!std::filesystem::exists(path))
+                break;
+            int width = 0, height = 0;
+            loadFrame(path, frame, width, height);
+            saveFrame(framesPath + std::to_string(i) + ".ppm", frame, width, height, FrameCodec::PPM);
+        }
+    }
+
+    // Runs ffmpeg with processed_frame_1 onwards as its first input, followed by outputOptions
+    bool encodeFrames(const std::string& ffmpegOptions, const std::string& inputFramesDir, const FrameTiming& timing,
+                      FrameCodec codec, const std::string& outputOptions)
+    {
+        std::string framesPath = inputFramesDir + "/processed_frame_";
+        std::string extension = frameCodecExtension(codec);
+        // The raw pipe below has no timestamps, a variable rate source goes through the frame list
+        // as PPM copies instead
+        if (codec == FrameCodec::LZ4 && timing.variable)
+        {
+            auto removeCopies = [&] {
+                for (int i = 1; std::filesystem::remove(framesPath + std::to_string(i) + ".ppm"); i++)
+                    ;
+            };
+            try
+            {
+                decodeFramesToPpm(framesPath);
+                bool result = encodeFrames(ffmpegOptions, inputFramesDir, timing, FrameCodec::PPM, outputOptions);
+                removeCopies();
+                return result;
+            }
+            catch (...)
+            {
+                removeCopies();
+                throw;
+            }
+        }
+        if (codec != FrameCodec::LZ4 && timing.variable)
+        {
+            std::string listPath = inputFramesDir + "/frames.ffconcat";
+            writeFrameList(listPath, inputFramesDir, extension, timing);
+            std::string command = "ffmpeg " + ffmpegOptions + " -f concat -safe 0 -i \"" + listPath + "\" " + outputOptions;
+            int result = system(command.c_str());
+            std::filesystem::remove(listPath);
+            return result == 0;
+        }
+        if (codec != FrameCodec::LZ4)
+        {
+            std::string command = "ffmpeg " + ffmpegOptions + " -framerate " + timing.rate +
+                                  " -i \"" + framesPath + "%d" + extension + "\" " + outputOptions;
+            return system(command.c_str()) == 0;
+        }
+
+        std::vector<unsigned char> frame;
+        int width = 0, height = 0;
+        loadFrame(framesPath + "1" + extension, frame, width, height);
+        std::string command = "ffmpeg " + ffmpegOptions + " -f rawvideo -pix_fmt rgba -s " + std::to_string(width) + "x" +
+                              std::to_string(height) + " -framerate " + timing.rate + " -i - " + outputOptions;
+        FILE* encoder = popen(command.c_str(), "w");
+        if (!encoder)
+            return false;
+        try
+        {
+            for (int i = 2; ; i++)
+            {
+                writeRawVideoFrame(encoder, frame);
+                std::string path = framesPath + std::to_string(i) + extension;
+                if (!std::filesystem::exists(path))
+                    break;
+                int frameWidth = 0, frameHeight = 0;
+                loadFrame(path, frame, frameWidth, frameHeight);
+                if (frameWidth != width || frameHeight != height)
+                    throw std::runtime_error("Frame size changed at " + path);
+            }
+        }
+        catch (...)
+        {
+            pclose(encoder);
+            throw;
+        }
+        return pclose(encoder) == 0;
+    }
+}
+
+VideoInfo probeVideo(const std::string& videoPath)
 {
-    std::string command = "ffmpeg -i \"" + videoPath + "\" -vf \"fps=30,format=rgb24\" \"" + 
-                      outputDir + "/frame_%d.ppm\" -start_number 1 2>/dev/null";
+    std::string command = "ffprobe -v error -select_streams v:0 -show_entries stream=width,height,color_space,r_frame_rate,"
+                          "avg_frame_rate,time_base:format=duration "
+                          "-of default=noprint_wrappers=1 \"" + videoPath + "\"";
+    FILE* probe = popen(command.c_str(), "r");
+    if (!probe)
+        throw std::runtime_error("Failed to run ffprobe on " + videoPath);
 
-    if (system(command.c_str()) != 0) 
-        throw std::runtime_error("Failed to extract frames from video : " + videoPath);
-    
+    // key=value lines, eg width=1920
+    VideoInfo info = { 0, 0, "", 0.0, "", "", "" };
+    char line[256];
+    while (fgets(line, sizeof(line), probe))
+    {
+        std::string entry(line);
+        entry.erase(entry.find_last_not_of("\r\n") + 1);
+        size_t separator = entry.find('=');
+        if (separator == std::string::npos)
+            continue;
+        std::string key = entry.substr(0, separator);
+        std::string value = entry.substr(separator + 1);
+        if (key == "width")
+            info.width = std::stoi(value);
+        else if (key == "height")
+            info.height = std::stoi(value);
+        else if (key == "color_space" && value != "unknown")
+            info.colorSpace = value;
+        else if (key == "duration" && value != "N/A")
+            info.duration = std::stod(value);
+        else if (key == "r_frame_rate" && parseRate(value) > 0.0)
+            info.frameRate = value;
+        else if (key == "avg_frame_rate" && parseRate(value) > 0.0)
+            info.averageFrameRate = value;
+        else if (key == "time_base")
+            info.timeBase = value;
+    }
+
+    if (pclose(probe) != 0 || info.width <= 0 || info.height <= 0)
+        throw std::runtime_error("Failed to probe video dimensions : " + videoPath);
+    return info;
 }
 
-void createVideo(const std::string& inputFramesDir, const std::string& outputVideo, const std::string& inputVideo, int framerate = 30) 
+FrameTiming probeFrameTiming(const std::string& videoPath)
 {
-    std::string command = "ffmpeg -framerate " + std::to_string(framerate) + 
-                    " -i \"" + inputFramesDir + "/processed_frame_%d.ppm\" " +
-                    " -i \"" + inputVideo + "\" " +  // Add input video as second input
+    VideoInfo info = probeVideo(videoPath);
+    std::string command = "ffprobe -v error -select_streams v:0 -show_entries packet=pts_time -of csv=p=0 \"" +
+                          videoPath + "\"";
+    FILE* probe = popen(command.c_str(), "r");
+    if (!probe)
+        throw std::runtime_error("Failed to run ffprobe on " + videoPath);
+
+    // One pts per line in decode order, N/A for packets without one
+    FrameTiming timing = { "", {}, false };
+    char line[64];
+    while (fgets(line, sizeof(line), probe))
+    {
+        char* end = nullptr;
+        double time = std::strtod(line, &end);
+        if (end != line)
+            timing.times.push_back(time);
+    }
+    if (pclose(probe) != 0)
+        throw std::runtime_error("Failed to probe frame times : " + videoPath);
+    std::sort(timing.times.begin(), timing.times.end());
+
+    double rate = parseRate(info.frameRate) > 0.0 ? parseRate(info.frameRate) : parseRate(info.averageFrameRate);
+    // Streams without timestamps (raw elementary streams) are taken as constant rate
+    if (timing.times.empty() && rate > 0.0 && info.duration > 0.0)
+    {
+        long long frameCount = std::llround(info.duration * rate);
+        for (long long i = 0; i < frameCount; i++)
+            timing.times.push_back(i / rate);
+    }
+    if (timing.times.empty())
+        throw std::runtime_error("Failed to probe frame times : " + videoPath);
+
+    if (timing.times.size() > 2)
+    {
+        std::vector<double> intervals;
+        for (size_t i = 1; i < timing.times.size(); i++)
+            intervals.push_back(timing.times[i] - timing.times[i - 1]);
+        std::vector<double> sorted = intervals;
+        std::nth_element(sorted.begin(), sorted.begin() + sorted.size() / 2, sorted.end());
+        double typical = sorted[sorted.size() / 2];
+        for (double interval : intervals)
+            if (std::fabs(interval - typical) > typical * VARIABLE_RATE_TOLERANCE)
+                timing.variable = true;
+    }
+
+    if (!timing.variable && !info.frameRate.empty())
+        timing.rate = info.frameRate;
+    else if (!info.averageFrameRate.empty())
+        timing.rate = info.averageFrameRate;
+    else if (timing.times.size() > 1)
+        timing.rate = std::to_string((timing.times.size() - 1) / (timing.times.back() - timing.times.front()));
+    else
+        timing.rate = "30";
+    return timing;
+}
+
+FrameTiming frameTimingRange(const FrameTiming& timing, int firstFrame, int endFrame)
+{
+    size_t first = std::min(static_cast<size_t>(std::max(firstFrame, 0)), timing.times.size());
+    size_t end = endFrame < 0 ? timing.times.size() : std::min(static_cast<size_t>(endFrame), timing.times.size());
+    FrameTiming range = { timing.rate, {}, timing.variable };
+    if (first < end)
+        range.times.assign(timing.times.begin() + first, timing.times.begin() + end);
+    return range;
+}
+
+void createVideo(const std::string& inputFramesDir, const std::string& outputVideo, const std::string& inputVideo,
+                 const FrameTiming& timing, FrameCodec codec)
+{
+    std::string outputOptions = " -i \"" + inputVideo + "\" " +  // Add input video as second input
                     "-c:v libx264 -pix_fmt yuv420p " +
+                    "-vsync vfr " +  // Keep the frame times as given, no duplicating to a fixed rate
                     "-c:a copy " +  // Copy audio stream without re-encoding
                     "-map 0:v:0 " +  // Map video from first input (processed frames)
                     "-map 1:a:0 " +  // Map audio from second input (original video)
                     "\"" + outputVideo + "\"";
-                    
-    if (system(command.c_str()) != 0) {
+
+    if (!encodeFrames("", inputFramesDir, timing, codec, outputOptions)) {
         throw std::runtime_error("Failed to create output video");
     }
-}
\ No newline at end of file
+}
+
+/*
+Seeks to just before the range on the input so a late shard doesn't decode the whole clip, but
+keeps the original timestamps (-copyts), the ones ffprobe reported for the frame times. trim then
+cuts halfway between the frames either side of each boundary so rounding can't pick up a
+neighbouring frame, and setpts restarts the shard at zero.
+*/
+namespace {
+    std::string frameRangeInput(const std::string& videoPath, int firstFrame, int endFrame, const std::vector<double>& times)
+    {
+        if (firstFrame < 0 || static_cast<size_t>(firstFrame) >= times.size())
+            throw std::runtime_error("Frame " + std::to_string(firstFrame) + " is past the end of " + videoPath);
+        double start = firstFrame > 0 ? (times[firstFrame - 1] + times[firstFrame]) / 2.0 : 0.0;
+        double seek = std::max(0.0, start - 2.0);
+        std::string trim = firstFrame > 0 ? "start=" + std::to_string(start) : "";
+        if (endFrame >= 0 && static_cast<size_t>(endFrame) < times.size())
+            trim += (trim.empty() ? "end=" : ":end=") + std::to_string((times[endFrame - 1] + times[endFrame]) / 2.0);
+
+        return "-ss " + std::to_string(seek) + " -copyts -i \"" + videoPath + "\" " + PASSTHROUGH + " " +
+               "-vf \"" + (trim.empty() ? "" : "trim=" + trim + ",") + "setpts=PTS-STARTPTS,format=rgb24\"";
+    }
+}
+
+size_t extractFrameContainer(const std::string& videoPath, const std::string& containerPath, FrameCodec codec,
+                             int firstFrame, int endFrame, const FrameTiming* timing)
+{
+    VideoInfo info = probeVideo(videoPath);
+    bool range = firstFrame > 0 || endFrame >= 0;
+    if (range && !timing)
+        throw std::runtime_error("Extracting a frame range needs the frame times of " + videoPath);
+    std::string input = range ? frameRangeInput(videoPath, firstFrame, endFrame, timing->times)
+                              : "-i \"" + videoPath + "\" " + PASSTHROUGH + " -vf format=rgb24";
+    std::string command = "ffmpeg -loglevel error " + input + " -f rawvideo -pix_fmt rgb24 - 2>/dev/null";
+
+    FILE* decoder = popen(command.c_str(), "r");
+    if (!decoder)
+        throw std::runtime_error("Failed to start ffmpeg decoder for " + videoPath);
+
+    size_t frameCount = 0;
+    try
+    {
+        FrameContainerWriter writer(containerPath, info.width, info.height, codec);
+        std::vector<unsigned char> frame;
+        size_t frameSize = static_cast<size_t>(info.width) * info.height * 3;
+        while (readRawVideoFrame(decoder, frame, frameSize))
+            writer.append(frame.data());
+        writer.finish();
+        frameCount = writer.getFrameCount();
+    }
+    catch (...)
+    {
+        pclose(decoder);
+        throw;
+    }
+
+    if (pclose(decoder) != 0)
+        throw std::runtime_error("Failed to extract frames from video : " + videoPath);
+    return frameCount;
+}
+
+void createSegment(const std::string& inputFramesDir, const std::string& segmentVideo, const FrameTiming& timing,
+                   FrameCodec codec)
+{
+    std::string outputOptions = "-c:v libx264 -pix_fmt yuv420p -vsync vfr -an \"" + segmentVideo + "\"";
+
+    if (!encodeFrames("-y -loglevel error", inputFramesDir, timing, codec, outputOptions))
+        throw std::runtime_error("Failed to create segment " + segmentVideo);
+}
+
+void stitchSegments(const std::vector<std::string>& segmentVideos, const std::string& outputVideo,
+                    const std::string& inputVideo, const std::vector<double>& segmentDurations)
+{
+    // The concat demuxer reads its inputs from a list file
+    std::string listPath = outputVideo + ".segments.txt";
+    {
+        std::ofstream list(listPath);
+        if (!list)
+            throw std::runtime_error("Failed to write segment list " + listPath);
+        list << std::fixed << std::setprecision(6);
+        for (size_t i = 0; i < segmentVideos.size(); i++)
+        {
+            const std::string& segment = segmentVideos[i];
+            if (!std::filesystem::exists(segment))
+                throw std::runtime_error("Missing segment : " + segment);
+            list << "file '" << std::filesystem::absolute(segment).string() << "'\n";
+            if (i < segmentDurations.size() && segmentDurations[i] > 0.0)
+                list << "duration " << segmentDurations[i] << "\n";
+        }
+    }
+
+    std::string command = "ffmpeg -y -loglevel error -f concat -safe 0 -i \"" + listPath + "\" " +
+                    " -i \"" + inputVideo + "\" " +
+                    "-c:v copy -c:a copy " +  // Segments are joined as is, no second encode
+                    "-map 0:v:0 " +
+                    "-map 1:a:0? " +
+                    "\"" + outputVideo + "\"";
+
+    int result = system(command.c_str());
+    std::filesystem::remove(listPath);
+    if (result != 0)
+        throw std::runtime_error("Failed to stitch segments into " + outputVideo);
+}
+
+FILE* openRawVideoEncoder(const std::string& outputVideo, const std::string& inputVideo, int width, int height,
+                          const std::string& framerate, const std::string& pixelFormat)
+{
+    // libx264 takes yuv420p and nv12 directly, anything else gets converted to yuv420p
+    std::string encodeFormat = (pixelFormat == "yuv420p" || pixelFormat == "nv12") ? pixelFormat : "yuv420p";
+    std::string command = "ffmpeg -y -loglevel error -f rawvideo -pix_fmt " + pixelFormat +
+                    " -s " + std::to_string(width) + "x" + std::to_string(height) +
+                    " -framerate " + framerate + " -i - " +
+                    " -i \"" + inputVideo + "\" " +  // Original video for the audio track
+                    "-c:v libx264 -pix_fmt " + encodeFormat + " " +
+                    "-c:a copy " +
+                    "-map 0:v:0 " +
+                    "-map 1:a:0? " +  // Audio is optional here, silent clips still encode
+                    "\"" + outputVideo + "\"";
+
+    FILE* encoder = popen(command.c_str(), "w");
+    if (!encoder)
+        throw std::runtime_error("Failed to start ffmpeg encoder for " + outputVideo);
+    return encoder;
+}
+
+void writeRawVideoFrame(FILE* encoder, const std::vector<unsigned char>& frame)
+{
+    if (fwrite(frame.data(), 1, frame.size(), encoder) != frame.size())
+        throw std::runtime_error("Failed to write frame to the encoder");
+}
+
+void closeRawVideoEncoder(FILE* encoder)
+{
+    if (pclose(encoder) != 0)
+        throw std::runtime_error("Failed to create output video");
+}
+
+FILE* openRawVideoDecoder(const std::string& videoPath, const std::string& pixelFormat)
+{
+    std::string command = "ffmpeg -loglevel error -i \"" + videoPath + "\" " + PASSTHROUGH + " " +
+                          "-f rawvideo -pix_fmt " + pixelFormat + " - 2>/dev/null";
+
+    FILE* decoder = popen(command.c_str(), "r");
+    if (!decoder)
+        throw std::runtime_error("Failed to start ffmpeg decoder for " + videoPath);
+    return decoder;
+}
+
+bool readRawVideoFrame(FILE* decoder, std::vector<unsigned char>& frame, size_t frameSize)
+{
+    frame.resize(frameSize);
+    size_t bytesRead = fread(frame.data(), 1, frameSize, decoder);
+    if (bytesRead == 0)
+        return false;
+    if (bytesRead != frameSize)
+        throw std::runtime_error("Truncated frame from the decoder");
+    return true;
+}
+
+void closeRawVideoDecoder(FILE* decoder)
+{
+    if (pclose(decoder) != 0)
+        throw std::runtime_error("Failed to decode input video");
+}
@@ -1,8 +1,92 @@
+#pragma once
+
 #include <string>
 #include <stdexcept>
+#include <vector>
+#include <cstdio>
+#include "frame_container.hpp"
+#include "frame_codec.hpp"
+
+struct VideoInfo {
+    int width;
+    int height;
+    std::string colorSpace; // As ffprobe reports it (bt709, smpte170m, ...), empty when untagged
+    double duration;        // Container duration in seconds, 0 when unknown
+    // Rationals as ffprobe reports them (24000/1001, 1/90000), empty when unknown
+    std::string frameRate;          // r_frame_rate, the stream's base rate
+    std::string averageFrameRate;   // avg_frame_rate, frames over duration
+    std::string timeBase;
+};
+
+// First video stream's properties (and the container duration) via ffprobe
+VideoInfo probeVideo(const std::string& videoPath);
+
+/*
+When the source's frames are shown. Frames are extracted as they are in the source, nothing is
+dropped or duplicated to a fixed rate, so frame i of the extraction is shown at times[i]. A constant
+rate source is encoded at its exact rate; a variable rate one (frame intervals that differ by more
+than rounding) is encoded with every frame's own duration so it stays in sync with the audio.
+*/
+struct FrameTiming {
+    std::string rate;           // Exact rate for ffmpeg (24000/1001), the average rate for variable sources
+    std::vector<double> times;  // Presentation time of every frame in seconds, ascending
+    bool variable;
+};
 
-void extractFrames(const std::string& videoPath, const std::string& outputDir);
+// From the stream's packet timestamps, which only needs demuxing, not decoding
+FrameTiming probeFrameTiming(const std::string& videoPath);
+// Frames [firstFrame, endFrame) of timing, endFrame < 0 means up to the end
+FrameTiming frameTimingRange(const FrameTiming& timing, int firstFrame, int endFrame);
 
 bool checkFFMPEG();
 
-void createVideo(const std::string& inputFramesDir, const std::string& outputVideo, const std::string& inputVideo, int framerate);
+// processed_frame_1 onwards in inputFramesDir, stored with codec. ffmpeg reads PPM and QOI frames
+// itself, LZ4 ones are decoded here and piped to it as raw RGBA, or for a variable rate source
+// (the pipe carries no timestamps) decoded to PPM copies that go through the frame list.
+void createVideo(const std::string& inputFramesDir, const std::string& outputVideo, const std::string& inputVideo,
+                 const FrameTiming& timing, FrameCodec codec = FrameCodec::PPM);
+
+/*
+Sharded jobs. extractFrameContainer takes frames [firstFrame, endFrame) of the clip (0 based,
+endFrame < 0 means up to the end), cut on the frame times from probeFrameTiming, so shards split
+at any frame and still line up exactly. createSegment encodes one shard (timed by the
+frameTimingRange of its frames) without audio, every shard with the same settings, which lets
+stitchSegments join them with the concat demuxer without re-encoding and put the original audio
+back on the result. segmentDurations (seconds, from the
+source's frame times) place each segment exactly; without them the demuxer goes by the segment
+files' own durations, which come up a frame short when encoded with per frame times.
+*/
+void createSegment(const std::string& inputFramesDir, const std::string& segmentVideo, const FrameTiming& timing,
+                   FrameCodec codec = FrameCodec::PPM);
+void stitchSegments(const std::vector<std::string>& segmentVideos, const std::string& outputVideo,
+                    const std::string& inputVideo, const std::vector<double>& segmentDurations = {});
+
+/*
+The source's frames as they are (the whole clip when firstFrame is 0 and endFrame < 0, timing is
+only needed for a range), decoded to rgb24 over a pipe and written into a single frame container
+with its records stored as codec. Returns the number of frames written.
+*/
+size_t extractFrameContainer(const std::string& videoPath, const std::string& containerPath, FrameCodec codec,
+                             int firstFrame = 0, int endFrame = -1, const FrameTiming* timing = nullptr);
+
+/*
+Streams raw frames straight into an ffmpeg encoder over a pipe instead of going through PPM files.
+pixelFormat is the ffmpeg name of what the frames contain (yuv420p, nv12, rgba); 4:2:0 input
+is encoded as is, so the encoder does no colour conversion of its own. framerate is anything
+ffmpeg takes for -framerate (30, 24000/1001); the pipe carries no timestamps, so it is for
+constant rate sources only.
+*/
+FILE* openRawVideoEncoder(const std::string& outputVideo, const std::string& inputVideo, int width, int height,
+                          const std::string& framerate, const std::string& pixelFormat);
+void writeRawVideoFrame(FILE* encoder, const std::vector<unsigned char>& frame);
+void closeRawVideoEncoder(FILE* encoder);
+
+/*
+Decodes straight to raw frames over a pipe, in the decoder's native 4:2:0 layout for yuv420p /
+nv12 rather than converting to rgb24 on the CPU and going through PPM files. Frames come as they
+are in the source, like extractFrameContainer.
+*/
+FILE* openRawVideoDecoder(const std::string& videoPath, const std::string& pixelFormat);
+// Reads exactly frameSize bytes, false at the end of the stream
+bool readRawVideoFrame(FILE* decoder, std::vector<unsigned char>& frame, size_t frameSize);
+void closeRawVideoDecoder(FILE* decoder);
@@ -7,71 +7,341 @@ This program works as follows :
     3) For each new masked image, run the Vulkan Compute code.
     
     Future Goals : Have a GUI using IMGUI for this system, rendering on screen is not an immediate goal.
-    The syntax is ./main <path_to_video_file> <compiled_shader_path> <flag_object_detection> 
+    The syntax is ./main <path_to_video_file> <compiled_shader_path> <flag_object_detection> [--profile] [--trace <file>] [--yuv <i420|nv12>] [--yuv-input <i420|nv12>] [--workers N] [--shard I/N] [--stitch N] [--scale F] [--single-pass] [--tile-cache T] [--cache <dir>] [--cache-size MB] [--detection-cache] [--frame-codec <ppm|qoi|lz4>] [--libav] [--cpu]
     Eg : ./main test/video.mp4 ghibli.spv false
+    --profile prints per stage timings (CPU spans and GPU timestamps) at the end of the run,
+    --trace also writes them as a Chrome trace (open in chrome://tracing or ui.perfetto.dev).
+    --yuv converts the frames to YUV 4:2:0 on the GPU and pipes them straight into the encoder
+    instead of writing PPMs (single shader mode and constant frame rate sources only, the pipe
+    carries no timestamps; --libav keeps them).
+    --yuv-input <i420|nv12> decodes the video in its native 4:2:0 layout and converts to RGBA on
+    the GPU instead of extracting rgb24 PPMs first (single shader mode only).
+    --workers N processes N frames at a time, each worker with its own pipelines and command pool
+    on the shared device (PPM frames only, so not together with --yuv / --yuv-input).
+    --shard I/N processes only the I-th (0 based) of N equal frame ranges and encodes it as
+    segment_I_of_N.mp4 next to the video, so one clip can be split over processes or machines.
+    --stitch N then joins segment_0_of_N.mp4 ... without re-encoding and adds the original audio,
+    eg ./main clip.mp4 ghibli.spv false --shard 0/4 (x4, anywhere) then ./main clip.mp4 ghibli.spv false --stitch 4
+    --scale F runs the effects at F (0 < F <= 1) of the frame size and upscales on the GPU, guided by
+    the full resolution frame. Needs shaders/utility/downsample.spv and upsample.spv.
+    --single-pass (with object detection) shades every detected class in one dispatch over a per
+    pixel class map instead of one pass per class. Needs shaders/utility/class_map.spv, full size only.
+    --tile-cache T only reshades the 32x32 tiles whose pixels changed by more than T (0..255, 0 keeps
+    the output exact) since the previous frame, for mostly static footage. Needs
+    shaders/utility/tile_diff.spv, full size effects only.
+    --cache <dir> keeps processed frames in dir, keyed by the input frame, the shaders, the masks
+    and the settings that change the output, and reuses them on later runs; --cache-size caps it
+    (MB, least recently used frames go first). PPM frames only, so not together with --yuv / --yuv-input,
+    nor with --tile-cache above 0 whose output depends on the frames shaded before.
+    --detection-cache (with object detection) keeps every frame's detections in <video>.detections
+    next to the video and reuses them on later runs with the same model, so changing shaders
+    doesn't run the detector again.
+    Frames are extracted into one temp_frames.nfc frame container next to the video rather than a
+    PPM per frame. --frame-codec qoi or lz4 compresses the intermediates losslessly, both the frames
+    in the container and the processed frames (processed_frame_N.qoi / .lz4), ppm (default) stores
+    them raw.
+    --libav (single shader mode, builds configured with -DNPLAYER_WITH_LIBAV=ON) decodes and encodes
+    in process with libavformat / libavcodec instead of running ffmpeg : no frames on disk, the
+    source's timestamps kept and its audio copied. Combines with --yuv / --yuv-input to move the
+    frames as 4:2:0 and convert on the GPU, otherwise they are RGBA.
+    --cpu runs the effects (grayscale, ghibli, person) on the CPU with SIMD kernels on all cores
+    (split between the workers with --workers) instead of Vulkan, which is also what happens when no Vulkan device can be set up. RGBA frames
+    at full size only : not with --yuv / --yuv-input / --single-pass, --scale and --tile-cache do nothing.
 */
 
 #include <cstdlib>
+#include <cmath>
 #include <stdexcept>
 #include <iostream>
 #include <filesystem>
 #include "io/video_io.hpp"
 #include "core/vulkan_engine.hpp"
 #include "processing/frame_processor.hpp"
+#include "core/profiler.hpp"
 
 
 int main(int argc, char* argv[])
 {
     try{
 
-        if (!checkFFMPEG()) 
-                throw std::runtime_error("ffmpeg is not installed. Please install ffmpeg to continue.");
-            
         std::string videoPath;
         std::string shaderPath;
         bool objectDetection = false;
+        std::string tracePath;
+        std::string yuvFormat;
+        std::string yuvInputFormat;
+        int workers = 1;
+        int shardIndex = 0, shardCount = 0;
+        int stitchCount = 0;
+        float processingScale = 1.0f;
+        bool singlePass = false;
+        int tileCacheThreshold = -1;
+        std::string cacheDir;
+        uint64_t cacheSize = Config::RESULT_CACHE_MAX_BYTES;
+        bool detectionCache = false;
+        FrameCodec frameCodec = FrameCodec::PPM;
+        bool useLibav = false;
+        bool cpuBackend = false;
         std::cout << argc << std::endl;
-        if (argc == 4) 
+        if (argc >= 4) 
         {   
             videoPath = argv[1];
             shaderPath = argv[2];
             std::string temp = argv[3];
             if(temp == "true")
             objectDetection = true;
+
+            for (int i = 4; i < argc; i++)
+            {
+                std::string option = argv[i];
+                if (option == "--profile")
+                    Profiler::instance().setEnabled(true);
+                else if (option == "--trace" && i + 1 < argc)
+                {
+                    tracePath = argv[++i];
+                    Profiler::instance().setTraceEnabled(true);
+                }
+                else if (option == "--yuv" && i + 1 < argc)
+                {
+                    yuvFormat = argv[++i];
+                    if (yuvFormat != "i420" && yuvFormat != "nv12")
+                        throw std::runtime_error("--yuv expects i420 or nv12, got " + yuvFormat);
+                }
+                else if (option == "--yuv-input" && i + 1 < argc)
+                {
+                    yuvInputFormat = argv[++i];
+                    if (yuvInputFormat != "i420" && yuvInputFormat != "nv12")
+                        throw std::runtime_error("--yuv-input expects i420 or nv12, got " + yuvInputFormat);
+                }
+                else if (option == "--workers" && i + 1 < argc)
+                    workers = std::stoi(argv[++i]);
+                else if (option == "--shard" && i + 1 < argc)
+                {
+                    std::string shard = argv[++i];
+                    size_t separator = shard.find('/');
+                    if (separator == std::string::npos)
+                        throw std::runtime_error("--shard expects I/N, got " + shard);
+                    shardIndex = std::stoi(shard.substr(0, separator));
+                    shardCount = std::stoi(shard.substr(separator + 1));
+                    if (shardCount <= 0 || shardIndex < 0 || shardIndex >= shardCount)
+                        throw std::runtime_error("--shard index must be in [0, N), got " + shard);
+                }
+                else if (option == "--scale" && i + 1 < argc)
+                {
+                    processingScale = std::stof(argv[++i]);
+                    if (processingScale <= 0.0f || processingScale > 1.0f)
+                        throw std::runtime_error("--scale expects a value in (0, 1]");
+                }
+                else if (option == "--single-pass")
+                    singlePass = true;
+                else if (option == "--tile-cache" && i + 1 < argc)
+                {
+                    tileCacheThreshold = std::stoi(argv[++i]);
+                    if (tileCacheThreshold < 0 || tileCacheThreshold > 255)
+                        throw std::runtime_error("--tile-cache expects a threshold in [0, 255]");
+                }
+                else if (option == "--detection-cache")
+                    detectionCache = true;
+                else if (option == "--libav")
+                    useLibav = true;
+                else if (option == "--cpu")
+                    cpuBackend = true;
+                else if (option == "--frame-codec" && i + 1 < argc)
+                    frameCodec = parseFrameCodec(argv[++i]);
+                else if (option == "--cache" && i + 1 < argc)
+                    cacheDir = argv[++i];
+                else if (option == "--cache-size" && i + 1 < argc)
+                {
+                    long long megabytes = std::stoll(argv[++i]);
+                    if (megabytes <= 0)
+                        throw std::runtime_error("--cache-size expects a positive size in MB");
+                    cacheSize = static_cast<uint64_t>(megabytes) << 20;
+                }
+                else if (option == "--stitch" && i + 1 < argc)
+                {
+                    stitchCount = std::stoi(argv[++i]);
+                    if (stitchCount <= 0)
+                        throw std::runtime_error("--stitch expects a positive segment count");
+                }
+                else
+                    throw std::runtime_error("Unknown option: " + option);
+            }
         }
         else 
         {
-            std::cout << "Incorrect syntax : ./main <path_to_video_file> <compiled_shader_path> <flag_object_detection> ";
+            std::cout << "Incorrect syntax : ./main <path_to_video_file> <compiled_shader_path> <flag_object_detection> [--profile] [--trace <file>] [--yuv <i420|nv12>] [--yuv-input <i420|nv12>] [--workers N] [--shard I/N] [--stitch N] [--scale F] [--single-pass] [--tile-cache T] [--cache <dir>] [--cache-size MB] [--detection-cache] [--frame-codec <ppm|qoi|lz4>] [--libav] [--cpu]";
             return EXIT_SUCCESS;
         }
     
+        // The libav backend does its own decoding and encoding
+        if (!useLibav && !checkFFMPEG())
+            throw std::runtime_error("ffmpeg is not installed. Please install ffmpeg to continue.");
         if (!std::filesystem::exists(videoPath)) 
             throw std::runtime_error("Input video file does not exist: " + videoPath);
+        if (objectDetection && (!yuvFormat.empty() || !yuvInputFormat.empty()))
+            throw std::runtime_error("--yuv and --yuv-input are only supported without object detection");
+        if (workers > 1 && (!yuvFormat.empty() || !yuvInputFormat.empty()))
+            throw std::runtime_error("--workers can't be combined with --yuv or --yuv-input");
+        if (shardCount > 0 && (!yuvFormat.empty() || !yuvInputFormat.empty()))
+            throw std::runtime_error("--shard can't be combined with --yuv or --yuv-input");
+        if (singlePass && (!objectDetection || processingScale < 1.0f))
+            throw std::runtime_error("--single-pass needs object detection and can't be combined with --scale");
+        if (!cacheDir.empty() && (!yuvFormat.empty() || !yuvInputFormat.empty()))
+            throw std::runtime_error("--cache can't be combined with --yuv or --yuv-input");
+        // Above 0 the reused tiles depend on which frames a worker saw before, not on the frame itself
+        if (!cacheDir.empty() && tileCacheThreshold > 0)
+            throw std::runtime_error("--cache can't be combined with a non zero --tile-cache threshold");
+        if (detectionCache && !objectDetection)
+            throw std::runtime_error("--detection-cache needs object detection");
+        if (useLibav && (objectDetection || workers > 1 || shardCount > 0 || stitchCount > 0 || !cacheDir.empty()))
+            throw std::runtime_error("--libav is single shader mode only and can't be combined with --workers, --shard, --stitch or --cache");
 
         std::filesystem::path inputPath(videoPath);
         std::string baseDir = inputPath.parent_path().string();
-        std::string tempFramesDir = baseDir + "/temp_frames";
+        std::string tempFrames = baseDir + "/temp_frames";
         std::string processedFramesDir = baseDir + "/processed_frames";
         std::string outputVideo = baseDir + "/output_" + inputPath.filename().string();    
-        std::cout << baseDir << tempFramesDir << processedFramesDir << std::endl;
-        std::cout << "Extracting frames from video ..." << std::endl;
-        extractFrames(videoPath, tempFramesDir);
+        auto segmentVideo = [&](int index, int count) {
+            return baseDir + "/segment_" + std::to_string(index) + "_of_" + std::to_string(count) + ".mp4";
+        };
+        // Shard ranges are in source frames, the last shard runs to the real end
+        auto shardStart = [&](const FrameTiming& timing, int index, int count) {
+            long long totalFrames = static_cast<long long>(timing.times.size());
+            if (totalFrames < count)
+                throw std::runtime_error("Can't split " + videoPath + " into " + std::to_string(count) + " shards");
+            return static_cast<int>(totalFrames * index / count);
+        };
+
+        if (stitchCount > 0)
+        {
+            // Each segment lasts from its first frame to the next segment's, as in the source
+            FrameTiming timing = probeFrameTiming(videoPath);
+            std::vector<std::string> segments;
+            std::vector<double> durations;
+            for (int i = 0; i < stitchCount; i++)
+            {
+                segments.push_back(segmentVideo(i, stitchCount));
+                if (i + 1 < stitchCount)
+                    durations.push_back(timing.times[shardStart(timing, i + 1, stitchCount)] -
+                                        timing.times[shardStart(timing, i, stitchCount)]);
+            }
+            std::cout << "Stitching " << stitchCount << " segments ..." << std::endl;
+            stitchSegments(segments, outputVideo, videoPath, durations);
+            std::cout << "Written " << outputVideo << std::endl;
+            return EXIT_SUCCESS;
+        }
+
+        // Shards running on the same machine must not share frame folders
+        if (shardCount > 0)
+        {
+            tempFrames += "_shard" + std::to_string(shardIndex);
+            processedFramesDir += "_shard" + std::to_string(shardIndex);
+        }
+        tempFrames += ".nfc";
+        std::cout << baseDir << tempFrames << processedFramesDir << std::endl;
+
+        // Only the source's own frames are processed and encoded back at their own times. The libav
+        // backend carries the timestamps through itself.
+        FrameTiming timing = { "30", {}, false };
+        if (!useLibav)
+        {
+            timing = probeFrameTiming(videoPath);
+            std::cout << timing.times.size() << " frames at " << timing.rate << " fps"
+                      << (timing.variable ? " (variable frame rate)" : "") << std::endl;
+            if (timing.variable && !yuvFormat.empty())
+                throw std::runtime_error("--yuv pipes raw frames without timestamps, it can't keep the times of a variable frame rate source");
+        }
+
+        int firstFrame = 0, endFrame = -1;
+        if (shardCount > 0)
+        {
+            firstFrame = shardStart(timing, shardIndex, shardCount);
+            endFrame = shardIndex + 1 == shardCount ? -1 : shardStart(timing, shardIndex + 1, shardCount);
+
+            std::cout << "Extracting shard " << shardIndex << "/" << shardCount << " from frame " << firstFrame << " ..." << std::endl;
+            ProfileScope scope("extract");
+            extractFrameContainer(videoPath, tempFrames, frameCodec, firstFrame, endFrame, &timing);
+        }
+        // With --yuv-input or --libav the frames are decoded while processing instead
+        else if (yuvInputFormat.empty() && !useLibav)
+        {
+            std::cout << "Extracting frames from video ..." << std::endl;
+            ProfileScope scope("extract");
+            extractFrameContainer(videoPath, tempFrames, frameCodec);
+        }
         
-        VulkanEngine engine;
+        VulkanEngine engine(cpuBackend);
+        if (engine.isCpuBackend())
+        {
+            if (!yuvFormat.empty() || !yuvInputFormat.empty() || singlePass)
+                throw std::runtime_error("The CPU backend shades RGBA frames one class at a time, --yuv, --yuv-input and --single-pass need Vulkan");
+            if (processingScale < 1.0f || tileCacheThreshold >= 0)
+                std::cout << "The CPU backend shades every frame at full size, ignoring --scale and --tile-cache" << std::endl;
+        }
         
         if(objectDetection){
             std::cout << "Masking frames and applying shaders ..." << std::endl;
-            FrameProcessor fp (engine, tempFramesDir, processedFramesDir);
+            FrameProcessor fp (engine, tempFrames, processedFramesDir);
+            fp.setWorkerCount(workers);
+            if (processingScale < 1.0f)
+                fp.setProcessingScale(processingScale);
+            fp.setSinglePass(singlePass);
+            if (tileCacheThreshold >= 0)
+                fp.setTileCache(true, tileCacheThreshold);
+            if (!cacheDir.empty())
+                fp.setResultCache(cacheDir, cacheSize);
+            fp.setFrameCodec(frameCodec);
+            // Shards have their own file, they may run side by side on one machine
+            if (detectionCache)
+                fp.setDetectionCache(shardCount > 0 ? videoPath + ".shard" + std::to_string(shardIndex) + ".detections"
+                                                    : videoPath + ".detections");
             fp.processFramesWithMask();
         }
         else{
             std::cout << "Applying shaders ..." << std::endl;
-            FrameProcessor fp (engine, tempFramesDir, processedFramesDir, shaderPath);
+            FrameProcessor fp (engine, tempFrames, processedFramesDir, shaderPath);
+            fp.setWorkerCount(workers);
+            if (processingScale < 1.0f)
+                fp.setProcessingScale(processingScale);
+            // Without --yuv / --yuv-input the libav backend moves RGBA frames
+            auto rawFormat = [](const std::string& name) {
+                return name == "nv12" ? PixelFormat::NV12 : name == "i420" ? PixelFormat::I420 : PixelFormat::RGBA;
+            };
+            if (!yuvFormat.empty() || useLibav)
+                fp.setRawVideoOutput(outputVideo, videoPath, timing.rate, rawFormat(yuvFormat));
+            if (!yuvInputFormat.empty() || useLibav)
+                fp.setRawVideoInput(videoPath, rawFormat(yuvInputFormat));
+            fp.setLibavBackend(useLibav);
+            if (tileCacheThreshold >= 0)
+                fp.setTileCache(true, tileCacheThreshold);
+            if (!cacheDir.empty())
+                fp.setResultCache(cacheDir, cacheSize);
+            fp.setFrameCodec(frameCodec);
             fp.processFrames();
         }
 
-        std::cout << "Making video " << std::endl;
-        createVideo(processedFramesDir, outputVideo, videoPath, 30);
+        if (shardCount > 0)
+        {
+            std::cout << "Making segment " << std::endl;
+            ProfileScope scope("encode");
+            createSegment(processedFramesDir, segmentVideo(shardIndex, shardCount),
+                          frameTimingRange(timing, firstFrame, endFrame), frameCodec);
+        }
+        // The raw video paths have already encoded while processing
+        else if (yuvFormat.empty() && !useLibav)
+        {
+            std::cout << "Making video " << std::endl;
+            ProfileScope scope("encode");
+            createVideo(processedFramesDir, outputVideo, videoPath, timing, frameCodec);
+        }
+
+        if (Profiler::instance().isEnabled())
+            Profiler::instance().printSummary(std::cout);
+        if (!tracePath.empty())
+        {
+            Profiler::instance().writeChromeTrace(tracePath);
+            std::cout << "Trace written to " << tracePath << std::endl;
+        }
     }
     catch (const std::exception& e) 
     {
@@ -0,0 +1,245 @@
+#include "detection_cache.hpp"
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+    const char FILE_MAGIC[4] = { 'N', 'P', 'D', 'C' };
+    const uint32_t FILE_VERSION = 1;
+
+    struct FileHeader {
+        char magic[4];
+        uint32_t version;
+        uint64_t modelHash;
+    };
+
+    struct RecordHeader {
+        uint64_t key;
+        uint32_t payloadSize; // Bytes after this header
+        uint32_t detectionCount;
+    };
+
+    // Followed by the box mask, one bit per pixel, rows packed back to back
+    struct DetectionRecord {
+        float x1, y1, x2, y2;
+        float score;
+        int32_t classId;
+        int32_t roiX, roiY, roiWidth, roiHeight;
+    };
+
+    size_t maskBytes(int width, int height)
+    {
+        return (static_cast<size_t>(width) * height + 7) / 8;
+    }
+
+    // False for a record that doesn't hold together, which the caller treats as a miss
+    bool parseRecord(const RecordHeader& record, const unsigned char* p, std::vector<YoloDetection>& detections)
+    {
+        // Checked first so a corrupt count can't size the allocation
+        if (record.detectionCount > record.payloadSize / sizeof(DetectionRecord))
+            return false;
+        const unsigned char* end = p + record.payloadSize;
+
+        std::vector<YoloDetection> result(record.detectionCount);
+        for (YoloDetection& detection : result)
+        {
+            DetectionRecord fields;
+            if (p + sizeof(fields) > end)
+                return false;
+            memcpy(&fields, p, sizeof(fields));
+            p += sizeof(fields);
+            if (fields.roiWidth <= 0 || fields.roiHeight <= 0 ||
+                maskBytes(fields.roiWidth, fields.roiHeight) > static_cast<size_t>(end - p))
+                return false;
+
+            detection.x1 = fields.x1;
+            detection.y1 = fields.y1;
+            detection.x2 = fields.x2;
+            detection.y2 = fields.y2;
+            detection.classId = fields.classId;
+            detection.score = fields.score;
+            detection.roiX = fields.roiX;
+            detection.roiY = fields.roiY;
+            detection.roiWidth = fields.roiWidth;
+            detection.roiHeight = fields.roiHeight;
+            detection.roiMask.resize(static_cast<size_t>(fields.roiWidth) * fields.roiHeight);
+            for (size_t i = 0; i < detection.roiMask.size(); i++)
+                detection.roiMask[i] = (p[i >> 3] >> (i & 7)) & 1 ? 255 : 0;
+            p += maskBytes(fields.roiWidth, fields.roiHeight);
+        }
+        detections = std::move(result);
+        return true;
+    }
+}
+
+DetectionCache::DetectionCache(const std::string& path, uint64_t modelHash)
+    : path(path), mapped(nullptr), mappedSize(0), appendFile(nullptr), readFd(-1), appendOffset(0)
+{
+    size_t valid = mapAndIndex(modelHash);
+    if (valid == 0)
+    {
+        // New file, or one written for another model
+        index.clear();
+        if (mapped)
+            munmap(const_cast<unsigned char*>(mapped), mappedSize);
+        mapped = nullptr;
+        mappedSize = 0;
+        appendFile = fopen(path.c_str(), "wb");
+        if (!appendFile)
+            throw std::runtime_error("Failed to create detection cache " + path);
+        FileHeader header;
+        memcpy(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC));
+        header.version = FILE_VERSION;
+        header.modelHash = modelHash;
+        fwrite(&header, sizeof(header), 1, appendFile);
+        fflush(appendFile);
+        appendOffset = sizeof(header);
+    }
+    else
+    {
+        // Drop a record an interrupted run left half written, new ones go after the valid part
+        if (valid < mappedSize)
+            std::filesystem::resize_file(path, valid);
+        appendFile = fopen(path.c_str(), "ab");
+        if (!appendFile)
+            throw std::runtime_error("Failed to open detection cache " + path);
+        appendOffset = valid;
+    }
+
+    readFd = open(path.c_str(), O_RDONLY);
+    if (readFd < 0)
+    {
+        fclose(appendFile);
+        if (mapped)
+            munmap(const_cast<unsigned char*>(mapped), mappedSize);
+        throw std::runtime_error("Failed to open detection cache " + path);
+    }
+}
+
+DetectionCache::~DetectionCache()
+{
+    if (appendFile)
+        fclose(appendFile);
+    if (readFd >= 0)
+        close(readFd);
+    if (mapped)
+        munmap(const_cast<unsigned char*>(mapped), mappedSize);
+}
+
+size_t DetectionCache::mapAndIndex(uint64_t modelHash)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return 0;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(FileHeader))
+    {
+        close(fd);
+        return 0;
+    }
+
+    void* memory = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED)
+        return 0;
+    mapped = static_cast<const unsigned char*>(memory);
+    mappedSize = info.st_size;
+
+    FileHeader header;
+    memcpy(&header, mapped, sizeof(header));
+    if (memcmp(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0 || header.version != FILE_VERSION ||
+        header.modelHash != modelHash)
+        return 0;
+
+    size_t offset = sizeof(FileHeader);
+    while (offset + sizeof(RecordHeader) <= mappedSize)
+    {
+        RecordHeader record;
+        memcpy(&record, mapped + offset, sizeof(record));
+        size_t end = offset + sizeof(RecordHeader) + record.payloadSize;
+        if (end > mappedSize)
+            break;
+        index[record.key] = offset;
+        offset = end;
+    }
+    return offset;
+}
+
+bool DetectionCache::readRecord(size_t offset, std::vector<YoloDetection>& detections) const
+{
+    RecordHeader record;
+    if (offset + sizeof(record) <= mappedSize)
+    {
+        memcpy(&record, mapped + offset, sizeof(record));
+        return parseRecord(record, mapped + offset + sizeof(record), detections);
+    }
+
+    // Appended since opening, past the end of the mapping
+    if (pread(readFd, &record, sizeof(record), offset) != static_cast<ssize_t>(sizeof(record)))
+        return false;
+    std::vector<unsigned char> payload(record.payloadSize);
+    if (pread(readFd, payload.data(), payload.size(), offset + sizeof(record)) != static_cast<ssize_t>(payload.size()))
+        return false;
+    return parseRecord(record, payload.data(), detections);
+}
+
+bool DetectionCache::find(uint64_t key, std::vector<YoloDetection>& detections)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto stored = index.find(key);
+    if (stored != index.end() && readRecord(stored->second, detections))
+    {
+        stats.hits++;
+        return true;
+    }
+    stats.misses++;
+    return false;
+}
+
+void DetectionCache::insert(uint64_t key, const std::vector<YoloDetection>& detections)
+{
+    std::vector<unsigned char> payload;
+    for (const YoloDetection& detection : detections)
+    {
+        DetectionRecord fields = { detection.x1, detection.y1, detection.x2, detection.y2, detection.score,
+                                   detection.classId, detection.roiX, detection.roiY,
+                                   detection.roiWidth, detection.roiHeight };
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&fields);
+        payload.insert(payload.end(), bytes, bytes + sizeof(fields));
+
+        size_t maskStart = payload.size();
+        payload.resize(maskStart + maskBytes(detection.roiWidth, detection.roiHeight), 0);
+        for (size_t i = 0; i < detection.roiMask.size(); i++)
+            if (detection.roiMask[i])
+                payload[maskStart + (i >> 3)] |= 1 << (i & 7);
+    }
+
+    RecordHeader record = { key, static_cast<uint32_t>(payload.size()), static_cast<uint32_t>(detections.size()) };
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (index.count(key))
+        return;
+    // Flushed per frame so an interrupted run keeps what it detected
+    if (fwrite(&record, sizeof(record), 1, appendFile) != 1 ||
+        fwrite(payload.data(), 1, payload.size(), appendFile) != payload.size() || fflush(appendFile) != 0)
+        throw std::runtime_error("Failed to append to detection cache " + path);
+    index[key] = appendOffset;
+    appendOffset += sizeof(record) + payload.size();
+    stats.stores++;
+}
+
+DetectionCacheStats DetectionCache::getStats() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+size_t DetectionCache::getFrameCount() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return index.size();
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "yolo_decode.hpp"
+
+struct DetectionCacheStats {
+    size_t hits = 0, misses = 0, stores = 0;
+};
+
+/*
+Persistent detections for one video, so reruns with other shaders skip inference. The file is a
+header naming the model (hash of the model file) followed by one record per frame : its key (see
+ObjectDetector::detect, frame content plus detector settings) and every NMS'd detection of every
+class with its box mask bit packed at prototype resolution, a few hundred bytes per frame. The
+file is memory mapped and indexed when opened, new frames are appended and read back from the file
+on a hit, so nothing is kept unpacked. A file written for a different model is started over.
+Shared by the frame workers, every call locks.
+*/
+class DetectionCache {
+public:
+    DetectionCache(const std::string& path, uint64_t modelHash);
+    ~DetectionCache();
+    DetectionCache(const DetectionCache&) = delete;
+    DetectionCache& operator=(const DetectionCache&) = delete;
+
+    bool find(uint64_t key, std::vector<YoloDetection>& detections);
+    void insert(uint64_t key, const std::vector<YoloDetection>& detections);
+
+    DetectionCacheStats getStats() const;
+    size_t getFrameCount() const;
+
+private:
+    std::string path;
+    const unsigned char* mapped;
+    size_t mappedSize;
+    std::unordered_map<uint64_t, size_t> index; // Record offsets, past the mapping for appended ones
+    FILE* appendFile;
+    int readFd;          // Reads back records appended since opening
+    size_t appendOffset; // File length, where the next record goes
+    DetectionCacheStats stats;
+    mutable std::mutex mutex;
+
+    size_t mapAndIndex(uint64_t modelHash); // Length of the valid prefix, 0 to start over
+    bool readRecord(size_t offset, std::vector<YoloDetection>& detections) const;
+};
@@ -1,142 +1,838 @@
 #include "frame_processor.hpp"
-#include "io/ppm_handler.hpp"
+#include "io/video_io.hpp"
+#include "io/frame_codec.hpp"
+#include "io/libav_io.hpp"
+#include "core/profiler.hpp"
 #include <filesystem>
 #include <algorithm>
 #include <iostream>
 #include <set>
 #include <map>
+#include <atomic>
+#include <mutex>
+#include <thread>
 #include "config.h"
 
 namespace fs = std::filesystem;
 
+namespace {
+    // ffmpeg's name for the raw frame layout
+    const char* rawPixelFormat(PixelFormat format)
+    {
+        return format == PixelFormat::I420 ? "yuv420p" : format == PixelFormat::NV12 ? "nv12" : "rgba";
+    }
+
+    // Past this share of the frame the background pass costs more than the region saves
+    const double REGION_DISPATCH_MAX_COVERAGE = 0.5;
+
+    // Bounding box of the pixels class shaders give the full effect (mask alpha above one half)
+    DispatchRegion maskRegion(const std::vector<unsigned char>& rgbaMask, int width, int height)
+    {
+        int minX = width, minY = height, maxX = -1, maxY = -1;
+        for (int y = 0; y < height; ++y)
+        {
+            const unsigned char* row = rgbaMask.data() + static_cast<size_t>(y) * width * 4;
+            for (int x = 0; x < width; ++x)
+            {
+                if (row[x * 4 + 3] > 127)
+                {
+                    minX = std::min(minX, x);
+                    maxX = std::max(maxX, x);
+                    minY = std::min(minY, y);
+                    maxY = y;
+                }
+            }
+        }
+        if (maxX < 0)
+            return { 0, 0, 0, 0 };
+        return { minX, minY, maxX - minX + 1, maxY - minY + 1 };
+    }
+
+    // The masks in the order they are applied, labels included
+    uint64_t hashMasks(const std::vector<std::pair<std::string, std::vector<unsigned char>>>& masks)
+    {
+        uint64_t hash = 0;
+        for (const auto& [classLabel, maskData] : masks)
+        {
+            hash = hashBytes(classLabel.data(), classLabel.size(), hash);
+            hash = hashBytes(maskData.data(), maskData.size(), hash);
+        }
+        return hash;
+    }
+
+    void printResultCacheStats(const FrameCache& cache)
+    {
+        FrameCacheStats stats = cache.getStats();
+        size_t lookups = stats.hits + stats.misses;
+        if (lookups == 0)
+            return;
+        std::cout << "Result cache : " << stats.hits << "/" << lookups << " frames reused (" << (100 * stats.hits / lookups)
+                  << "%), " << stats.stores << " stored, " << stats.evictions << " evicted, "
+                  << (cache.getSize() >> 20) << " MB on disk" << std::endl;
+    }
+
+    void printDetectionCacheStats(const DetectionCacheStats& stats)
+    {
+        size_t lookups = stats.hits + stats.misses;
+        if (lookups == 0)
+            return;
+        std::cout << "Detection cache : " << stats.hits << "/" << lookups << " frames without inference ("
+                  << (100 * stats.hits / lookups) << "%), " << stats.stores << " added" << std::endl;
+    }
+
+    void printTileCacheStats(const TileCacheStats& stats)
+    {
+        if (stats.tiles == 0)
+            return;
+        std::cout << "Tile cache : " << stats.cleanTiles << "/" << stats.tiles << " tiles reused ("
+                  << (100 * stats.cleanTiles / stats.tiles) << "%) over " << stats.frames << " cached frames" << std::endl;
+    }
+
+    // Restricts the masked effect to the region when the shader takes one and it is small enough
+    void shadeMasked(ComputePipeline& pipeline, const std::vector<unsigned char>& inputData, std::vector<unsigned char>& outputData,
+                     const std::vector<unsigned char>& maskData, const DispatchRegion& region, int width, int height)
+    {
+        double coverage = static_cast<double>(region.width) * region.height / (static_cast<double>(width) * height);
+        if (pipeline.supportsRegionDispatch() && coverage <= REGION_DISPATCH_MAX_COVERAGE)
+            pipeline.processImage(inputData, outputData, maskData, region);
+        else
+            pipeline.processImage(inputData, outputData, maskData);
+    }
+}
+
 FrameProcessor::FrameProcessor(VulkanEngine& engine, const std::string& inputDir, const std::string& outputDir)
-    : engine(engine), inputDir(inputDir), outputDir(outputDir), width(0), height(0)
+    : engine(engine), inputDir(inputDir), outputDir(outputDir), width(0), height(0), workerCount(1), processingScale(1.0f), singlePass(false),
+      tileCache(false), tileCacheThreshold(0), outputCodec(FrameCodec::PPM),
+      rawFramerate("30"), rawFormat(PixelFormat::RGBA), decodeFormat(PixelFormat::RGBA), libavBackend(false),
+      realTimeFrameCount(0), lastLatencyMs(0.0),
+      detectionPending(false), stopDetection(false), lastDetectionMs(0.0)
 {
     const std::string classLabelsPath = Config::ASSET_DIR + "/models/coco.names";
-    shaderManager = std::make_unique<ShaderManager>(engine);
-    shaderManager->loadShadersFromDirectory();
+    shaderManager = createShaderManager();
     objectDetector = std::make_unique<ObjectDetector>(Config::YOLO_MODEL_PATH, classLabelsPath);
+    // Shared by the frame workers, whose debug PPMs would all land on the same file names
     maskGenerator = std::make_unique<MaskGenerator>();
+    maskGenerator->setDebugOutput(false);
 }
 
 FrameProcessor::FrameProcessor(VulkanEngine& engine, const std::string& inputDir, const std::string& outputDir, const std::string& shaderPath)
-    : engine(engine), inputDir(inputDir), outputDir(outputDir), width(0), height(0)
+    : engine(engine), inputDir(inputDir), outputDir(outputDir), shaderPath(shaderPath), width(0), height(0),
+      workerCount(1), processingScale(1.0f), singlePass(false), tileCache(false), tileCacheThreshold(0), outputCodec(FrameCodec::PPM),
+      rawFramerate("30"), rawFormat(PixelFormat::RGBA), decodeFormat(PixelFormat::RGBA), libavBackend(false),
+      realTimeFrameCount(0), lastLatencyMs(0.0),
+      detectionPending(false), stopDetection(false), lastDetectionMs(0.0)
+{
+    shaderManager = createShaderManager();
+}
+
+FrameProcessor::FrameProcessor(VulkanEngine& engine)
+    : engine(engine), width(0), height(0), workerCount(1), processingScale(1.0f), singlePass(false),
+      tileCache(false), tileCacheThreshold(0), outputCodec(FrameCodec::PPM),
+      rawFramerate("30"), rawFormat(PixelFormat::RGBA), decodeFormat(PixelFormat::RGBA), libavBackend(false),
+      realTimeFrameCount(0), lastLatencyMs(0.0),
+      detectionPending(false), stopDetection(false), lastDetectionMs(0.0)
+{
+    const std::string classLabelsPath = Config::ASSET_DIR + "/models/coco.names";
+    shaderManager = createShaderManager();
+    objectDetector = std::make_unique<ObjectDetector>(Config::YOLO_MODEL_PATH, classLabelsPath);
+    maskGenerator = std::make_unique<MaskGenerator>();
+    maskGenerator->setDebugOutput(false);
+}
+
+FrameProcessor::~FrameProcessor()
+{
+    if (detectionThread.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(detectionMutex);
+            stopDetection = true;
+        }
+        detectionReady.notify_one();
+        detectionThread.join();
+    }
+}
+
+std::unique_ptr<ShaderManager> FrameProcessor::createShaderManager()
+{
+    auto manager = std::make_unique<ShaderManager>(engine);
+    if (shaderPath.empty())
+        manager->loadShadersFromDirectory();
+    else
+        manager->loadShader(shaderPath);
+    if (processingScale < 1.0f)
+        manager->setProcessingScale("", processingScale);
+    if (tileCache)
+        manager->setTileCache(true, tileCacheThreshold);
+    return manager;
+}
+
+void FrameProcessor::setResultCache(const std::string& directory, uint64_t maxBytes)
+{
+    resultCache = std::make_unique<FrameCache>(directory, maxBytes);
+}
+
+void FrameProcessor::setDetectionCache(const std::string& cachePath)
+{
+    if (!objectDetector)
+        throw std::runtime_error("The detection cache needs object detection");
+    objectDetector->setDetectionCache(cachePath);
+}
+
+// Everything besides the input frame and the masks that the output depends on
+uint64_t FrameProcessor::effectHash() const
+{
+    uint64_t hash = 0;
+    if (!shaderPath.empty())
+        hash = hashFile(shaderManager->getShaderPath("classic"), hash);
+    else if (singlePass)
+    {
+        hash = hashFile(Config::UTILITY_SHADER_DIR + "class_map.spv", hash);
+        for (const auto& [className, effect] : classEffects)
+        {
+            hash = hashBytes(className.data(), className.size(), hash);
+            hash = hashBytes(&effect, sizeof(effect), hash);
+        }
+    }
+    else
+    {
+        for (const std::string& className : shaderManager->getAvailableClasses())
+        {
+            hash = hashBytes(className.data(), className.size(), hash);
+            hash = hashFile(shaderManager->getShaderPath(className), hash);
+        }
+    }
+    hash = hashBytes(&processingScale, sizeof(processingScale), hash);
+    // Only a non zero threshold changes the output
+    int threshold = tileCache ? tileCacheThreshold : 0;
+    return hashBytes(&threshold, sizeof(threshold), hash);
+}
+
+void FrameProcessor::setTileCache(bool enabled, int threshold)
+{
+    shaderManager->setTileCache(enabled, threshold);
+    tileCache = enabled;
+    tileCacheThreshold = threshold;
+}
+
+void FrameProcessor::setFrameCodec(FrameCodec codec)
+{
+    outputCodec = codec;
+}
+
+void FrameProcessor::setProcessingScale(float scale)
+{
+    if (singlePass && scale < 1.0f)
+        throw std::runtime_error("Single pass shading runs at full size, it can't be combined with a processing scale");
+    processingScale = scale;
+    shaderManager->setProcessingScale("", scale);
+}
+
+void FrameProcessor::setSinglePass(bool enabled)
 {
-    shaderManager = std::make_unique<ShaderManager>(engine);
-    const std::string temp = "../grayscale.spv";
-    shaderManager->loadShader(temp);
+    if (enabled && processingScale < 1.0f)
+        throw std::runtime_error("Single pass shading runs at full size, it can't be combined with a processing scale");
+    singlePass = enabled;
 }
 
-FrameProcessor::~FrameProcessor() {}
+void FrameProcessor::setClassEffect(const std::string& className, uint32_t effect)
+{
+    if (effect > Config::EFFECT_GHIBLI)
+        throw std::runtime_error("Unknown class map effect " + std::to_string(effect));
+    classEffects[className] = effect;
+}
+
+// class_map.comp's push words : 4 bits per slot, the background first
+std::vector<uint32_t> FrameProcessor::classMapEffects(const std::vector<std::string>& slotClasses) const
+{
+    std::vector<uint32_t> words(Config::CLASS_MAP_SLOTS / 8, 0);
+    for (size_t slot = 0; slot <= slotClasses.size(); slot++)
+    {
+        uint32_t effect = Config::CLASS_MAP_BACKGROUND_EFFECT;
+        if (slot > 0)
+        {
+            auto it = classEffects.find(slotClasses[slot - 1]);
+            effect = it != classEffects.end() ? it->second : Config::CLASS_MAP_OBJECT_EFFECT;
+        }
+        words[slot / 8] |= effect << ((slot % 8) * 4);
+    }
+    return words;
+}
+
+void FrameProcessor::setWorkerCount(int count)
+{
+    if (count < 1)
+        throw std::runtime_error("Worker count must be at least 1");
+    workerCount = count;
+}
+
+/*
+Runs processFrame for every index in [0, frameCount). Worker 0 is this thread with the main
+ShaderManager, the others get their own so nothing Vulkan side is shared apart from the device
+and the queue (VulkanEngine::submit). Frames are handed out one at a time from an atomic counter
+rather than in fixed chunks, a frame with many detected classes costs several dispatches and
+would otherwise leave the rest of the pool idle. The first exception stops every worker and is
+rethrown here once they are joined.
+*/
+void FrameProcessor::runWorkers(size_t frameCount, const std::function<void(ShaderManager&, size_t)>& processFrame)
+{
+    size_t count = std::min(static_cast<size_t>(workerCount), frameCount);
+    std::vector<std::unique_ptr<ShaderManager>> managers;
+    for (size_t k = 1; k < count; k++)
+    {
+        managers.push_back(createShaderManager());
+        managers.back()->setDimensions(width, height);
+    }
+
+    std::atomic<size_t> nextFrame(0);
+    std::atomic<bool> failed(false);
+    std::exception_ptr error;
+    std::mutex errorMutex;
+    auto worker = [&](ShaderManager& manager)
+    {
+        try
+        {
+            for (size_t i = nextFrame++; i < frameCount && !failed; i = nextFrame++)
+                processFrame(manager, i);
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            if (!error)
+                error = std::current_exception();
+            failed = true;
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (auto& manager : managers)
+        threads.emplace_back(worker, std::ref(*manager));
+    worker(*shaderManager);
+    for (std::thread& thread : threads)
+        thread.join();
+
+    if (tileCache)
+    {
+        TileCacheStats stats = shaderManager->getTileCacheStats();
+        for (auto& manager : managers)
+        {
+            TileCacheStats workerStats = manager->getTileCacheStats();
+            stats.frames += workerStats.frames;
+            stats.tiles += workerStats.tiles;
+            stats.cleanTiles += workerStats.cleanTiles;
+        }
+        printTileCacheStats(stats);
+    }
+
+    if (error)
+        std::rethrow_exception(error);
+}
+
+void FrameProcessor::setRawVideoOutput(const std::string& outputVideo, const std::string& inputVideo, const std::string& framerate,
+                                       PixelFormat format)
+{
+    rawOutputVideo = outputVideo;
+    audioSourceVideo = inputVideo;
+    rawFramerate = framerate;
+    rawFormat = format;
+}
+
+void FrameProcessor::setLibavBackend(bool enabled)
+{
+    if (enabled && !libavAvailable())
+        throw std::runtime_error("Built without libav, configure with -DNPLAYER_WITH_LIBAV=ON");
+    libavBackend = enabled;
+}
+
+void FrameProcessor::setRawVideoInput(const std::string& videoPath, PixelFormat format)
+{
+    decodeVideo = videoPath;
+    decodeFormat = format;
+}
 
 std::vector<std::string> FrameProcessor::getSortedFrames()
 {
-    std::vector<std::string> frames;
+    // Frame numbers are parsed once up front rather than in every comparison
+    std::vector<std::pair<int, std::string>> numbered;
     for (const auto& entry : fs::directory_iterator(inputDir))
     {
-        if (entry.path().extension() == ".ppm")
-            frames.push_back(entry.path().string());
+        std::string extension = entry.path().extension().string();
+        if (extension != ".ppm" && extension != ".qoi" && extension != ".lz4")
+            continue;
+        std::string stem = entry.path().stem().string();
+        std::string number = stem.substr(stem.find_last_of('_') + 1);
+        if (number.empty() || number.find_first_not_of("0123456789") != std::string::npos)
+            continue;
+        numbered.emplace_back(std::stoi(number), entry.path().string());
     }
-    std::sort(frames.begin(), frames.end(), [](const std::string& a, const std::string& b)
-    {
-        int numA = std::stoi(a.substr(a.find_last_of('_') + 1, a.find_last_of('.') - a.find_last_of('_') - 1));
-        int numB = std::stoi(b.substr(b.find_last_of('_') + 1, b.find_last_of('.') - b.find_last_of('_') - 1));
-        return numA < numB;
-    });
+    std::sort(numbered.begin(), numbered.end());
+
+    std::vector<std::string> frames;
+    frames.reserve(numbered.size());
+    for (auto& [number, path] : numbered)
+        frames.push_back(std::move(path));
     return frames;
 }
 
-void FrameProcessor::processFramesWithMask()
+size_t FrameProcessor::openInputFrames()
 {
-    std::vector<std::string> frames = getSortedFrames();
-    if (frames.empty())
-        throw std::runtime_error("No PPM frames found in input directory");
+    if (fs::is_regular_file(inputDir))
+    {
+        if (!FrameContainer::isContainer(inputDir))
+            throw std::runtime_error("Input is neither a frame directory nor a frame container : " + inputDir);
+        inputContainer = std::make_unique<FrameContainer>(inputDir);
+        if (inputContainer->getFrameCount() == 0)
+            throw std::runtime_error("No frames in frame container " + inputDir);
+        return inputContainer->getFrameCount();
+    }
 
+    inputFrames = getSortedFrames();
+    if (inputFrames.empty())
+        throw std::runtime_error("No frames found in input directory");
+    return inputFrames.size();
+}
+
+void FrameProcessor::loadInputFrame(size_t index, std::vector<unsigned char>& data, int& width, int& height) const
+{
+    if (inputContainer)
+    {
+        inputContainer->readFrame(index, data);
+        width = inputContainer->getWidth();
+        height = inputContainer->getHeight();
+    }
+    else
+        loadFrame(inputFrames[index], data, width, height);
+}
+
+void FrameProcessor::processFramesWithMask()
+{
+    size_t frameCount = openInputFrames();
     fs::create_directories(outputDir);
 
     std::vector<unsigned char> firstFrameData;
-    loadPPMImage(frames[0].c_str(), firstFrameData, width, height);
+    loadInputFrame(0, firstFrameData, width, height);
     shaderManager->setDimensions(width, height);
 
     // Get available shader classes
     std::set<std::string> shaderClasses = shaderManager->getAvailableClasses();
+    // Class map slot order, the same order the per class passes run in
+    std::vector<std::string> classOrder(shaderClasses.begin(), shaderClasses.end());
+    uint64_t effects = resultCache ? effectHash() : 0;
 
-    std::vector<std::pair<std::string, std::vector<unsigned char>>> prevMaskDataList;
-    for (size_t i = 0; i < frames.size(); ++i)
+    runWorkers(frameCount, [&](ShaderManager& manager, size_t i)
     {
+        ProfileScope frameScope("frame");
+        // Per frame dimensions, width / height members are shared between workers
+        int width = 0, height = 0;
         std::vector<unsigned char> inputData;
-        loadPPMImage(frames[i].c_str(), inputData, width, height);
+        {
+            ProfileScope scope("frame:load");
+            loadInputFrame(i, inputData, width, height);
+        }
 
         std::vector<std::pair<std::string, std::vector<unsigned char>>> maskDataList;
-        //if (i % 5 == 0) // Run segmentation every 5th frame
-        //{
-            std::map<std::string, std::vector<std::vector<unsigned char>>> classMasks;
+        std::map<std::string, std::vector<std::vector<unsigned char>>> classMasks;
+        {
+            ProfileScope scope("frame:detect");
             objectDetector->detect(inputData.data(), width, height, 4, shaderClasses, classMasks, width, height);
-            maskGenerator->generateMasks(classMasks, maskDataList, width, height);
-            //prevMaskDataList = maskDataList;
-          //  for (const auto& [classLabel, maskData] : maskDataList) {
-          //      maskGenerator->saveMaskForDebug(classLabel, maskData, width, height, outputDir);
-          //  }
-      //  }
-       // else
-        //    maskDataList = prevMaskDataList;
-
-        std::vector<unsigned char> outputData = inputData;
-        std::cout << "The size of maskDataList is " << maskDataList.size() << std::endl;
-        for (const auto& [classLabel, maskData] : maskDataList)
-        {
-            try
+        }
+        // Every class in one dispatch over a byte per pixel class map, or one pass per class
+        std::vector<unsigned char> classMap;
+        std::vector<std::string> slotClasses;
+        {
+            ProfileScope scope("frame:masks");
+            if (singlePass)
+                maskGenerator->generateClassMap(classMasks, classOrder, classMap, slotClasses, width, height,
+                                                Config::CLASS_MAP_SLOTS);
+            else
+                maskGenerator->generateMasks(classMasks, maskDataList, width, height);
+        }
+
+        FrameCacheKey key = {};
+        std::vector<unsigned char> outputData;
+        bool cached = false;
+        if (resultCache)
+        {
+            ProfileScope scope("frame:cache");
+            uint64_t maskHash = hashMasks(maskDataList);
+            if (singlePass && !slotClasses.empty())
+            {
+                std::vector<uint32_t> words = classMapEffects(slotClasses);
+                maskHash = hashBytes(classMap.data(), classMap.size(), maskHash);
+                maskHash = hashBytes(words.data(), words.size() * sizeof(uint32_t), maskHash);
+            }
+            key = { hashBytes(inputData.data(), inputData.size()), effects, maskHash, width, height };
+            cached = resultCache->load(key, outputData);
+        }
+
+        if (!cached)
+        {
+            outputData = inputData;
+            if (singlePass && !slotClasses.empty())
             {
-                std::cout << classLabel << " detected for frame " << i + 1 << std::endl;
-                auto pipeline = shaderManager->getPipeline(classLabel);
-                std::vector<unsigned char> tempOutput;
-                pipeline->processImage(outputData, tempOutput, maskData);
-                outputData = std::move(tempOutput);
+                auto pipeline = manager.getClassMapPipeline();
+                ProfileScope scope("frame:shade");
+                pipeline->setPushConstantWords(classMapEffects(slotClasses));
+                pipeline->processImage(inputData, outputData, classMap);
             }
-            catch (const std::runtime_error& e)
+            for (const auto& [classLabel, maskData] : maskDataList)
             {
-                std::cout << "No pipeline for class: " << classLabel << std::endl;
-                continue;
+                try
+                {
+                    auto pipeline = manager.getPipeline(classLabel);
+                    ProfileScope scope("frame:shade");
+                    std::vector<unsigned char> tempOutput;
+                    shadeMasked(*pipeline, outputData, tempOutput, maskData, maskRegion(maskData, width, height), width, height);
+                    outputData = std::move(tempOutput);
+                }
+                catch (const std::runtime_error& e)
+                {
+                    std::cout << "No pipeline for class: " << classLabel << std::endl;
+                    continue;
+                }
+            }
+            if (resultCache)
+            {
+                ProfileScope scope("frame:cache");
+                resultCache->store(key, outputData);
             }
         }
 
-        std::string outputFile = outputDir + "/processed_frame_" + std::to_string(i + 1) + ".ppm";
-        savePPMImage(outputFile.c_str(), outputData, width, height);
+        {
+            ProfileScope scope("frame:save");
+            std::string outputFile = outputDir + "/processed_frame_" + std::to_string(i + 1) + frameCodecExtension(outputCodec);
+            saveFrame(outputFile, outputData, width, height, outputCodec);
+        }
 
-        std::cout << "Processed frame " << (i + 1) << "/" << frames.size() << "\r" << std::flush;
-    }
+        std::cout << "Processed frame " << (i + 1) << "/" << frameCount << "\r" << std::flush;
+    });
     std::cout << "\nFinished processing all frames" << std::endl;
+    printDetectionCacheStats(objectDetector->getDetectionCacheStats());
+    if (resultCache)
+        printResultCacheStats(*resultCache);
 }
 
 
 void FrameProcessor::processFrames()
 {
-    std::vector<std::string> frames = getSortedFrames();
-    if (frames.empty())
-        throw std::runtime_error("No PPM frames found in input directory");
+    size_t frameCount = 0;
+    FILE* decoder = nullptr;
+    std::unique_ptr<LibavDecoder> libavDecoder;
+    YuvMatrix matrix = YuvMatrix::BT601;
+    if (libavBackend && (decodeVideo.empty() || rawOutputVideo.empty()))
+        throw std::runtime_error("The libav backend needs raw video input and output");
+    if (workerCount > 1 && (!decodeVideo.empty() || !rawOutputVideo.empty()))
+        throw std::runtime_error("Multiple workers need PPM input and output, raw video streams are ordered");
+    if (resultCache && (!decodeVideo.empty() || !rawOutputVideo.empty()))
+        throw std::runtime_error("The result cache needs PPM input and output");
 
-    fs::create_directories(outputDir);
+    if (decodeVideo.empty())
+    {
+        frameCount = openInputFrames();
+        std::vector<unsigned char> firstFrameData;
+        loadInputFrame(0, firstFrameData, width, height);
+    }
+    else
+    {
+        // The libav decoder knows the stream once it is open, no ffprobe needed
+        if (libavBackend)
+            libavDecoder = std::make_unique<LibavDecoder>(decodeVideo, rawPixelFormat(decodeFormat));
+        VideoInfo info = libavDecoder ? libavDecoder->getInfo() : probeVideo(decodeVideo);
+        width = info.width;
+        height = info.height;
+        if (info.colorSpace == "bt709")
+            matrix = YuvMatrix::BT709;
+    }
 
-    std::vector<unsigned char> firstFrameData;
-    loadPPMImage(frames[0].c_str(), firstFrameData, width, height);
+    fs::create_directories(outputDir);
     shaderManager->setDimensions(width, height);
     auto grayscalePipeline = shaderManager->getPipeline("classic");
+    uint64_t effects = resultCache ? effectHash() : 0;
+    // Reuses a cached result for the frame when there is one, shades and caches it otherwise
+    auto shadeFrame = [&](ComputePipeline& pipeline, const std::vector<unsigned char>& inputData,
+                          std::vector<unsigned char>& outputData, int width, int height)
+    {
+        FrameCacheKey key = {};
+        if (resultCache)
+        {
+            ProfileScope scope("frame:cache");
+            key = { hashBytes(inputData.data(), inputData.size()), effects, 0, width, height };
+            if (resultCache->load(key, outputData))
+                return;
+        }
+        {
+            ProfileScope scope("frame:shade");
+            pipeline.processImage(inputData, outputData);
+        }
+        if (resultCache)
+        {
+            ProfileScope scope("frame:cache");
+            resultCache->store(key, outputData);
+        }
+    };
+
+    if (!decodeVideo.empty())
+    {
+        grayscalePipeline->setInputFormat(decodeFormat, matrix);
+        if (!libavDecoder)
+            decoder = openRawVideoDecoder(decodeVideo, rawPixelFormat(decodeFormat));
+    }
+
+    FILE* encoder = nullptr;
+    std::unique_ptr<LibavEncoder> libavEncoder;
+    if (!rawOutputVideo.empty())
+    {
+        PixelFormat format = ComputePipeline::supportsYuvOutput(width, height) ? rawFormat : PixelFormat::RGBA;
+        if (format != rawFormat)
+            std::cout << "Frame size " << width << "x" << height << " can't be converted to YUV on the GPU, sending RGBA" << std::endl;
+        grayscalePipeline->setOutputFormat(format);
+
+        if (libavDecoder)
+            libavEncoder = std::make_unique<LibavEncoder>(rawOutputVideo, *libavDecoder, rawPixelFormat(format));
+        else
+            encoder = openRawVideoEncoder(rawOutputVideo, audioSourceVideo, width, height, rawFramerate, rawPixelFormat(format));
+    }
+
+    if (workerCount > 1)
+    {
+        runWorkers(frameCount, [&](ShaderManager& manager, size_t i)
+        {
+            ProfileScope frameScope("frame");
+            int width = 0, height = 0;
+            std::vector<unsigned char> inputData, outputData;
+            {
+                ProfileScope scope("frame:load");
+                loadInputFrame(i, inputData, width, height);
+            }
+            shadeFrame(*manager.getPipeline("classic"), inputData, outputData, width, height);
+            {
+                ProfileScope scope("frame:save");
+                std::string outputFile = outputDir + "/processed_frame_" + std::to_string(i + 1) + frameCodecExtension(outputCodec);
+                saveFrame(outputFile, outputData, width, height, outputCodec);
+            }
+            std::cout << "Processed frame " << (i + 1) << "/" << frameCount << "\r" << std::flush;
+        });
+        std::cout << "\nFinished processing all frames" << std::endl;
+        if (resultCache)
+            printResultCacheStats(*resultCache);
+        return;
+    }
     
-    for (size_t i = 0; i < frames.size(); ++i)
+    // Reused across frames, the raw streams deliver every frame at the same size
+    std::vector<unsigned char> inputData;
+    int64_t pts = 0;
+    for (size_t i = 0; decoder || libavDecoder || i < frameCount; ++i)
     {
-        std::vector<unsigned char> inputData;
-        loadPPMImage(frames[i].c_str(), inputData, width, height);
+        ProfileScope frameScope("frame");
+        {
+            ProfileScope scope("frame:load");
+            if (libavDecoder)
+            {
+                if (!libavDecoder->readFrame(inputData, pts))
+                    break;
+            }
+            else if (decoder)
+            {
+                if (!readRawVideoFrame(decoder, inputData, grayscalePipeline->getInputSize()))
+                    break;
+            }
+            else
+                loadInputFrame(i, inputData, width, height);
+        }
         
         std::vector<unsigned char> outputData;
         std::vector<unsigned char> dummyMask;  // Leave empty
-        grayscalePipeline->processImage(inputData, outputData);
-        std::cout << "here " << std::endl;
+        shadeFrame(*grayscalePipeline, inputData, outputData, width, height);
 
-        std::string outputFile = outputDir + "/processed_frame_" + std::to_string(i + 1) + ".ppm";
-        savePPMImage(outputFile.c_str(), outputData, width, height);
+        {
+            ProfileScope scope("frame:save");
+            if (libavEncoder)
+                libavEncoder->writeFrame(outputData, pts);
+            else if (encoder)
+                writeRawVideoFrame(encoder, outputData);
+            else
+            {
+                std::string outputFile = outputDir + "/processed_frame_" + std::to_string(i + 1) + frameCodecExtension(outputCodec);
+                saveFrame(outputFile, outputData, width, height, outputCodec);
+            }
+        }
 
-        std::cout << "Processed frame " << (i + 1) << "/" << frames.size() << "\r" << std::flush;
+        if (decoder || libavDecoder)
+            std::cout << "Processed frame " << (i + 1) << "\r" << std::flush;
+        else
+            std::cout << "Processed frame " << (i + 1) << "/" << frameCount << "\r" << std::flush;
     }
 
+    if (decoder)
+        closeRawVideoDecoder(decoder);
+    if (encoder)
+    {
+        ProfileScope scope("encode");
+        closeRawVideoEncoder(encoder);
+    }
+    if (libavEncoder)
+    {
+        ProfileScope scope("encode");
+        libavEncoder->finish();
+    }
     std::cout << "\nFinished processing all frames" << std::endl;
+    if (tileCache)
+        printTileCacheStats(shaderManager->getTileCacheStats());
+    if (resultCache)
+        printResultCacheStats(*resultCache);
+}
+
+void FrameProcessor::setFrameSize(int width, int height)
+{
+    if (width <= 0 || height <= 0)
+        throw std::runtime_error("Invalid frame size " + std::to_string(width) + "x" + std::to_string(height));
+    if (width == this->width && height == this->height)
+        return;
+
+    this->width = width;
+    this->height = height;
+    shaderManager->setDimensions(width, height);
+}
+
+void FrameProcessor::setTargetLatency(double targetMs)
+{
+    if (targetMs <= 0.0)
+        throw std::runtime_error("Target latency must be positive");
+    bool fixedDetectionSize = !objectDetector || !objectDetector->hasDynamicInputSize();
+    qualityController = std::make_unique<QualityController>(targetMs, fixedDetectionSize);
+}
+
+void FrameProcessor::processRealTimeFrame(const std::vector<unsigned char>& inputData, std::vector<unsigned char>& outputData,
+                                          const std::string& shaderName, bool useSegmentation)
+{
+    double startMs = Profiler::instance().nowMs();
+    {
+        ProfileScope scope("realtime:frame");
+        if (width <= 0 || height <= 0)
+            throw std::runtime_error("setFrameSize must be called before processRealTimeFrame");
+        if (inputData.size() != static_cast<size_t>(width) * height * 4)
+            throw std::runtime_error("Real-time frame is " + std::to_string(inputData.size()) + " bytes, expected " +
+                                     std::to_string(static_cast<size_t>(width) * height * 4));
+
+        // Without a controller everything runs every frame at full size with the shaders' own defaults
+        const QualityLevel* level = qualityController ? &qualityController->current() : nullptr;
+        auto pipeline = level ? shaderManager->getPipeline(shaderName, level->tier) : shaderManager->getPipeline(shaderName);
+        // Pipelines that can't scale stay at full size on the reduced resolution rungs
+        if (level)
+            pipeline->setProcessingScale(pipeline->supportsProcessingScale() ? level->processingScale : 1.0f);
+
+        if (!useSegmentation)
+            pipeline->processImage(inputData, outputData);
+        else
+        {
+            int interval = level ? level->detectionInterval : 1;
+            if (realTimeFrameCount % interval == 0)
+                submitDetection(inputData, shaderName, level ? level->detectionSize : YOLO_INPUT_SIZE);
+
+            // Masks of another class or frame size are stale, the next detection result replaces them
+            std::shared_ptr<const std::vector<unsigned char>> mask;
+            DispatchRegion region = { 0, 0, 0, 0 };
+            {
+                std::lock_guard<std::mutex> lock(detectionMutex);
+                if (latestMaskClass == shaderName && latestMaskWidth == width && latestMaskHeight == height)
+                {
+                    mask = latestMask;
+                    region = latestMaskRegion;
+                }
+            }
+
+            if (mask)
+                shadeMasked(*pipeline, inputData, outputData, *mask, region, width, height);
+            else
+                outputData = inputData;
+        }
+        realTimeFrameCount++;
+    }
+    lastLatencyMs = Profiler::instance().nowMs() - startMs;
+
+    if (qualityController)
+    {
+        double detectMs;
+        {
+            std::lock_guard<std::mutex> lock(detectionMutex);
+            detectMs = lastDetectionMs;
+        }
+        qualityController->update(lastLatencyMs, detectMs);
+    }
+}
+
+// Hands the frame to the detection thread, replacing one it hasn't picked up yet so it always
+// works on the newest frame instead of falling behind
+void FrameProcessor::submitDetection(const std::vector<unsigned char>& frame, const std::string& className, int inputSize)
+{
+    {
+        std::lock_guard<std::mutex> lock(detectionMutex);
+        detectionFrame.assign(frame.begin(), frame.end());
+        detectionClass = className;
+        detectionWidth = width;
+        detectionHeight = height;
+        detectionSize = inputSize;
+        detectionPending = true;
+    }
+    if (!detectionThread.joinable())
+        detectionThread = std::thread(&FrameProcessor::detectionLoop, this);
+    detectionReady.notify_one();
+}
+
+void FrameProcessor::detectionLoop()
+{
+    std::vector<unsigned char> frame;
+    while (true)
+    {
+        std::string className;
+        int frameWidth, frameHeight, inputSize;
+        {
+            std::unique_lock<std::mutex> lock(detectionMutex);
+            detectionReady.wait(lock, [this] { return detectionPending || stopDetection; });
+            if (stopDetection)
+                return;
+            // Swapping keeps both buffers allocated, the next submit copies into the old one
+            frame.swap(detectionFrame);
+            className = detectionClass;
+            frameWidth = detectionWidth;
+            frameHeight = detectionHeight;
+            inputSize = detectionSize;
+            detectionPending = false;
+        }
+
+        std::shared_ptr<const std::vector<unsigned char>> mask;
+        DispatchRegion region = { 0, 0, 0, 0 };
+        double detectStartMs = Profiler::instance().nowMs();
+        try
+        {
+            ProfileScope scope("realtime:detect");
+            std::map<std::string, std::vector<std::vector<unsigned char>>> classMasks;
+            objectDetector->detect(frame.data(), frameWidth, frameHeight, 4, { className }, classMasks,
+                                   frameWidth, frameHeight, inputSize);
+
+            std::vector<std::pair<std::string, std::vector<unsigned char>>> maskDataList;
+            maskGenerator->generateMasks(classMasks, maskDataList, frameWidth, frameHeight);
+            for (auto& [classLabel, maskData] : maskDataList)
+            {
+                if (classLabel == className)
+                    mask = std::make_shared<const std::vector<unsigned char>>(std::move(maskData));
+            }
+            // Found here so the shading thread never scans the mask
+            if (mask)
+                region = maskRegion(*mask, frameWidth, frameHeight);
+        }
+        catch (const std::exception& e)
+        {
+            // Keep shading with the previous masks rather than taking the live pipeline down
+            std::cerr << "Real-time detection failed : " << e.what() << std::endl;
+            continue;
+        }
+
+        std::lock_guard<std::mutex> lock(detectionMutex);
+        lastDetectionMs = Profiler::instance().nowMs() - detectStartMs;
+        latestMask = mask;
+        latestMaskClass = className;
+        latestMaskWidth = frameWidth;
+        latestMaskHeight = frameHeight;
+        latestMaskRegion = region;
+    }
 }
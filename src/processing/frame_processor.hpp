@@ -2,11 +2,21 @@
 
 #include <vector>
 #include <string>
+#include <functional>
+#include <memory>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 #include "core/vulkan_engine.hpp"
 #include "core/shader_manager.hpp"
+#include "io/frame_cache.hpp"
+#include "io/frame_container.hpp"
+#include "io/frame_codec.hpp"
 #include "object_detector.hpp"
 #include "mask_generator.hpp"
+#include "quality_controller.hpp"
 
 class FrameProcessor {
 public:
@@ -15,10 +25,60 @@ public:
     FrameProcessor(VulkanEngine& engine); // For real-time mode
     ~FrameProcessor();
 
+    // Single shader mode only : stream frames to ffmpeg as raw video instead of writing PPMs.
+    // I420 / NV12 are converted on the GPU when the frame size allows it, otherwise RGBA is sent.
+    void setRawVideoOutput(const std::string& outputVideo, const std::string& inputVideo, const std::string& framerate,
+                           PixelFormat format);
+    // Single shader mode only : decode the video itself as I420 / NV12 instead of reading the PPMs
+    // in inputDir, the conversion to RGBA happens on the GPU (BT.709 when the stream says so).
+    void setRawVideoInput(const std::string& videoPath, PixelFormat format);
+    // Single shader mode with raw video input and output : decode and encode in process with the
+    // linked-in libav (see LibavDecoder / LibavEncoder) instead of ffmpeg processes over pipes,
+    // keeping the source's timestamps and copying its audio. Needs NPLAYER_WITH_LIBAV.
+    void setLibavBackend(bool enabled);
+
+    // Offline PPM jobs only : process frames on this many threads, each with its own ShaderManager
+    // (pipelines, command pool, descriptor sets, buffers) against the shared device. Frame order in
+    // the output directory is unaffected since every frame writes its own numbered file.
+    void setWorkerCount(int count);
+    // Every effect runs at this fraction of the frame size and is upscaled on the GPU
+    void setProcessingScale(float scale);
+    // Mask mode : shade every detected class in one class_map.comp dispatch instead of one class
+    // shader pass per class. Each class gets a built-in effect (Config::EFFECT_*) rather than its
+    // own shader, by default the split the class shaders make (Config::CLASS_MAP_*_EFFECT).
+    void setSinglePass(bool enabled);
+    void setClassEffect(const std::string& className, uint32_t effect);
+    // Only reshade the tiles that changed since the previous frame, see ComputePipeline::setTileCache.
+    // Offline jobs print the share of tiles skipped when they finish.
+    void setTileCache(bool enabled, int threshold = 0);
+    // Offline jobs : store processed frames with codec (processed_frame_N.ppm / .qoi / .lz4)
+    void setFrameCodec(FrameCodec codec);
+    // PPM jobs only : keep processed frames in a content-addressed cache in directory (see FrameCache)
+    // and reuse them when a later run sees the same input frame, effects and masks
+    void setResultCache(const std::string& directory, uint64_t maxBytes = Config::RESULT_CACHE_MAX_BYTES);
+    // Mask mode : persist the detections of every frame in cachePath, one file per video, so reruns
+    // with other shaders skip the detector (see DetectionCache)
+    void setDetectionCache(const std::string& cachePath);
+
     void processFrames();
     void processFramesWithMask();
+
+    /*
+    Real-time mode : packed RGBA frames in, packed RGBA out, nothing touches the disk. shaderName
+    is the effect (a class name with a shader in the shaders folder). With useSegmentation it is
+    only applied where that class was detected; detection runs on its own thread on the newest
+    frame handed to it and this call never waits for it, it uses the last finished masks (the
+    frame passes through unchanged until the first result). Pipelines keep their buffers between
+    calls, so only a change of frame size reallocates.
+    */
+    void setFrameSize(int width, int height);
+    // Lets a QualityController trade detection rate / size, shader tier and processing scale for
+    // latency, holding processRealTimeFrame around targetMs (eg 33 for 30 fps)
+    void setTargetLatency(double targetMs);
     void processRealTimeFrame(const std::vector<unsigned char>& inputData, std::vector<unsigned char>& outputData,
                              const std::string& shaderName, bool useSegmentation);
+    // Wall time of the last processRealTimeFrame call, also recorded as "realtime:frame" when profiling
+    double getLastLatencyMs() const { return lastLatencyMs; }
 
 private:
     VulkanEngine& engine;
@@ -26,7 +86,51 @@ private:
     std::unique_ptr<ObjectDetector> objectDetector;
     std::unique_ptr<MaskGenerator> maskGenerator;
     std::string inputDir, outputDir;
+    std::string shaderPath; // Empty in multi shader mode
     int width, height;
+    int workerCount;
+    float processingScale;
+    bool singlePass;
+    bool tileCache;
+    int tileCacheThreshold;
+    FrameCodec outputCodec;
+    std::map<std::string, uint32_t> classEffects;
+    std::unique_ptr<FrameCache> resultCache;
+    // Offline input, either the PPMs in inputDir or the frame container inputDir names
+    std::vector<std::string> inputFrames;
+    std::unique_ptr<FrameContainer> inputContainer;
+
+    std::string rawOutputVideo, audioSourceVideo;
+    std::string rawFramerate;   // As ffmpeg takes it, 24000/1001
+    PixelFormat rawFormat;
+    std::string decodeVideo;
+    PixelFormat decodeFormat;
+    bool libavBackend;
+
+    std::unique_ptr<QualityController> qualityController;
+    size_t realTimeFrameCount;
+    double lastLatencyMs;
+    // Real-time detection thread state, guarded by detectionMutex
+    std::thread detectionThread;
+    std::mutex detectionMutex;
+    std::condition_variable detectionReady;
+    bool detectionPending, stopDetection;
+    std::vector<unsigned char> detectionFrame;
+    std::string detectionClass;
+    int detectionWidth, detectionHeight, detectionSize;
+    double lastDetectionMs;
+    std::shared_ptr<const std::vector<unsigned char>> latestMask;
+    std::string latestMaskClass;
+    int latestMaskWidth, latestMaskHeight;
+    DispatchRegion latestMaskRegion;
 
     std::vector<std::string> getSortedFrames();
+    size_t openInputFrames();
+    void loadInputFrame(size_t index, std::vector<unsigned char>& data, int& width, int& height) const;
+    void submitDetection(const std::vector<unsigned char>& frame, const std::string& className, int inputSize);
+    void detectionLoop();
+    std::unique_ptr<ShaderManager> createShaderManager();
+    std::vector<uint32_t> classMapEffects(const std::vector<std::string>& slotClasses) const;
+    uint64_t effectHash() const;
+    void runWorkers(size_t frameCount, const std::function<void(ShaderManager&, size_t)>& processFrame);
 };
\ No newline at end of file
@@ -6,7 +6,7 @@
 #include <iostream>
 #include <fstream>
 
-MaskGenerator::MaskGenerator() {}
+MaskGenerator::MaskGenerator() : debugOutput(true) {}
 MaskGenerator::~MaskGenerator() {}
 
 void MaskGenerator::generateMasks(
@@ -15,7 +15,8 @@ void MaskGenerator::generateMasks(
     int width, int height)
 {
     maskDataList.clear();
-    std::cout << "MaskGenerator: Input classes: " << classMasks.size() << std::endl;
+    if (debugOutput)
+        std::cout << "MaskGenerator: Input classes: " << classMasks.size() << std::endl;
 
     for (const auto& [classLabel, maskList] : classMasks)
     {
@@ -34,6 +35,9 @@ void MaskGenerator::generateMasks(
                 combinedMask[i] |= (mask[i] > 0 ? 1 : 0);  // Pixel-wise OR
             }
 
+            if (!debugOutput)
+                continue;
+
             // Save each individual instance mask for debugging
             std::string debug_filename = "debug_instance_mask_" + classLabel + "_" + std::to_string(maskIndex++) + ".ppm";
             std::ofstream debug_file(debug_filename, std::ios::binary);
@@ -48,28 +52,65 @@ void MaskGenerator::generateMasks(
         std::vector<unsigned char> rgbaMask(width * height * 4, 0);
         int nonZero = 0;
         for (int i = 0; i < width * height; ++i) {
-            unsigned char value = (combinedMask[i] > 0) ? 0 : 255; // Invert mask
+            unsigned char value = (combinedMask[i] > 0) ? 255 : 0; // Opaque where the class was detected
             rgbaMask[i * 4 + 0] = rgbaMask[i * 4 + 1] = rgbaMask[i * 4 + 2] = value;
             rgbaMask[i * 4 + 3] = (value > 0) ? 255 : 0;
             if (value > 0) nonZero++;
         }
 
-        std::cout << "MaskGenerator: Total visible pixels for " << classLabel << ": " << nonZero << " / " << (width * height) << std::endl;
-
         // Debug final mask
-        std::string final_mask_filename = "debug_output_mask_" + classLabel + ".ppm";
-        std::ofstream final_mask_file(final_mask_filename, std::ios::binary);
-        final_mask_file << "P6\n" << width << " " << height << "\n255\n";
-        for (int i = 0; i < width * height; ++i) {
-            unsigned char val = rgbaMask[i * 4];
-            final_mask_file.put(val).put(val).put(val);
+        if (debugOutput) {
+            std::cout << "MaskGenerator: Total visible pixels for " << classLabel << ": " << nonZero << " / " << (width * height) << std::endl;
+            std::string final_mask_filename = "debug_output_mask_" + classLabel + ".ppm";
+            std::ofstream final_mask_file(final_mask_filename, std::ios::binary);
+            final_mask_file << "P6\n" << width << " " << height << "\n255\n";
+            for (int i = 0; i < width * height; ++i) {
+                unsigned char val = rgbaMask[i * 4];
+                final_mask_file.put(val).put(val).put(val);
+            }
+            final_mask_file.close();
         }
-        final_mask_file.close();
 
         maskDataList.emplace_back(classLabel, std::move(rgbaMask));
     }
 
-    std::cout << "MaskGenerator: Output masks: " << maskDataList.size() << std::endl;
+    if (debugOutput)
+        std::cout << "MaskGenerator: Output masks: " << maskDataList.size() << std::endl;
+}
+
+void MaskGenerator::generateClassMap(
+    const std::map<std::string, std::vector<std::vector<unsigned char>>>& classMasks,
+    const std::vector<std::string>& classOrder, std::vector<unsigned char>& classMap,
+    std::vector<std::string>& slotClasses, int width, int height, int maxSlots)
+{
+    const size_t pixelCount = static_cast<size_t>(width) * height;
+    classMap.assign(pixelCount, 0);
+    slotClasses.clear();
+
+    for (const std::string& classLabel : classOrder)
+    {
+        auto found = classMasks.find(classLabel);
+        if (found == classMasks.end() || found->second.empty())
+            continue;
+        if (static_cast<int>(slotClasses.size()) + 1 >= maxSlots)
+        {
+            std::cerr << "MaskGenerator: No class map slot left for " << classLabel << std::endl;
+            continue;
+        }
+
+        slotClasses.push_back(classLabel);
+        unsigned char slot = static_cast<unsigned char>(slotClasses.size());
+        for (const auto& mask : found->second)
+        {
+            if (mask.size() != pixelCount)
+                throw std::runtime_error("Invalid mask size for class: " + classLabel +
+                    ", expected: " + std::to_string(pixelCount) +
+                    ", got: " + std::to_string(mask.size()));
+            for (size_t i = 0; i < pixelCount; ++i)
+                if (mask[i] > 0)
+                    classMap[i] = slot;
+        }
+    }
 }
 
 
@@ -11,6 +11,20 @@ public:
     void generateMasks(    const std::map<std::string, std::vector<std::vector<unsigned char>>>& classMasks,
                                  std::vector<std::pair<std::string, std::vector<unsigned char>>>& maskDataList,
                                  int width, int height);
+    // One byte per pixel for all classes instead of an RGBA mask each : the slot of the class
+    // covering the pixel, 0 where nothing was detected. Classes found in the frame get slots 1, 2, ...
+    // in classOrder and later classes win where detections overlap, like the per class passes
+    // running one after the other. slotClasses[s - 1] is the class in slot s, classes past
+    // maxSlots - 1 are left out.
+    void generateClassMap(const std::map<std::string, std::vector<std::vector<unsigned char>>>& classMasks,
+                          const std::vector<std::string>& classOrder, std::vector<unsigned char>& classMap,
+                          std::vector<std::string>& slotClasses, int width, int height, int maxSlots = 256);
+    // Per instance and combined mask PPMs in the working directory plus per call logging, on unless
+    // a caller turns it off
+    void setDebugOutput(bool enabled) { debugOutput = enabled; }
     void saveMaskForDebug(const std::string& className, const std::vector<unsigned char>& maskData, 
                       int width, int height, const std::string& outputDir);
+
+private:
+    bool debugOutput;
 };
\ No newline at end of file
@@ -1,6 +1,9 @@
 #include <onnxruntime_cxx_api.h>
 #include <map>
 #include <set>
+#include <memory>
+#include "yolo_decode.hpp"
+#include "detection_cache.hpp"
 struct BBox {
     int x, y, w, h;
 };
@@ -13,6 +16,9 @@ private:
     std::vector<std::string> classLabels;
     float confidenceThreshold;
     float nmsThreshold;
+    bool dynamicInputSize;
+    std::string modelPath;
+    std::unique_ptr<DetectionCache> detectionCache;
 
 public:
     ObjectDetector(const std::string& modelPath, const std::string& classLabelsPath);
@@ -21,7 +27,13 @@ public:
     void detect(const uint8_t* frame, int frameWidth, int frameHeight, int frameChannels,
                            const std::set<std::string>& shaderClasses,
                            std::map<std::string, std::vector<std::vector<unsigned char>>>& classMasks,
-                           int outputWidth, int outputHeight);
+                           int outputWidth, int outputHeight, int inputSize = YOLO_INPUT_SIZE);
+    // True when the model accepts input sizes other than 640 (exported with dynamic axes)
+    bool hasDynamicInputSize() const { return dynamicInputSize; }
+    // Keep every frame's detections in cachePath (see DetectionCache) and reuse them for frames seen
+    // before with this model, instead of running it
+    void setDetectionCache(const std::string& cachePath);
+    DetectionCacheStats getDetectionCacheStats() const;
 
     float computeIoU(const BBox& box1, const BBox& box2);
 };
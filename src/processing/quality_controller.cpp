@@ -0,0 +1,94 @@
+#include "quality_controller.hpp"
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+
+namespace {
+    // Exponential moving average weight of the newest sample
+    const double AVERAGE_WEIGHT = 0.2;
+    // Step down after this many frames over budget, up after this many well under it
+    const int DEGRADE_FRAMES = 5;
+    const int UPGRADE_FRAMES = 60;
+    const double UPGRADE_HEADROOM = 0.6;
+    // Frames to ignore after a change while the averages catch up with the new rung
+    const int COOLDOWN_FRAMES = 15;
+}
+
+QualityController::QualityController(double targetLatencyMs, bool fixedDetectionSize)
+    : level(0), targetLatencyMs(targetLatencyMs), frameAverage(0.0), detectAverage(0.0),
+      overBudgetFrames(0), underBudgetFrames(0), cooldownFrames(0)
+{
+    // Cheapest knobs first : detection runs less often and smaller before the picture itself
+    // gets coarser, reduced resolution is the last resort
+    levels = {
+        { 1, 640, Config::QUALITY_TIER, 1.0f },
+        { 2, 640, Config::QUALITY_TIER, 1.0f },
+        { 3, 480, Config::QUALITY_TIER, 1.0f },
+        { 3, 480, Config::REALTIME_TIER, 1.0f },
+        { 5, 320, Config::REALTIME_TIER, 1.0f },
+        { 5, 320, Config::REALTIME_TIER, 0.75f },
+        { 8, 320, Config::REALTIME_TIER, 0.5f },
+    };
+    if (fixedDetectionSize)
+    {
+        for (QualityLevel& rung : levels)
+            rung.detectionSize = 640;
+    }
+}
+
+bool QualityController::update(double frameMs, double detectMs)
+{
+    frameAverage = frameAverage == 0.0 ? frameMs : frameAverage + AVERAGE_WEIGHT * (frameMs - frameAverage);
+    if (detectMs > 0.0)
+        detectAverage = detectAverage == 0.0 ? detectMs : detectAverage + AVERAGE_WEIGHT * (detectMs - detectAverage);
+
+    if (cooldownFrames > 0)
+    {
+        cooldownFrames--;
+        return false;
+    }
+
+    double load = std::max(frameAverage, detectAverage / current().detectionInterval);
+    if (load > targetLatencyMs)
+    {
+        underBudgetFrames = 0;
+        if (++overBudgetFrames >= DEGRADE_FRAMES && level + 1 < levels.size())
+        {
+            changeLevel(level + 1, load);
+            return true;
+        }
+    }
+    else if (load < targetLatencyMs * UPGRADE_HEADROOM)
+    {
+        overBudgetFrames = 0;
+        if (++underBudgetFrames >= UPGRADE_FRAMES && level > 0)
+        {
+            changeLevel(level - 1, load);
+            return true;
+        }
+    }
+    else
+        overBudgetFrames = underBudgetFrames = 0;
+    return false;
+}
+
+void QualityController::changeLevel(size_t newLevel, double load)
+{
+    std::cout << "Quality " << (newLevel > level ? "lowered" : "raised") << " to level " << newLevel
+              << " (" << describeQualityLevel(levels[newLevel]) << ") : load " << std::fixed << std::setprecision(1)
+              << load << " ms (frame " << frameAverage << " ms, detect " << detectAverage << " ms) against "
+              << targetLatencyMs << " ms" << std::defaultfloat << std::endl;
+
+    level = newLevel;
+    overBudgetFrames = underBudgetFrames = 0;
+    cooldownFrames = COOLDOWN_FRAMES;
+}
+
+std::string describeQualityLevel(const QualityLevel& level)
+{
+    std::ostringstream out;
+    out << "detect every " << level.detectionInterval << " frame(s) at " << level.detectionSize
+        << ", shader radius " << level.tier.radius << ", scale " << level.processingScale;
+    return out.str();
+}
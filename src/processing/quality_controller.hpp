@@ -0,0 +1,47 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "config.h"
+
+// One rung of the real-time quality ladder, every knob at its most expensive setting on rung 0
+struct QualityLevel {
+    int detectionInterval;      // Hand every Nth frame to the detector
+    int detectionSize;          // YOLO input resolution, a multiple of 32
+    Config::ShaderTier tier;    // Spec constants for the effect shader
+    float processingScale;      // Shade at this fraction of the frame size and upscale
+};
+
+/*
+Holds the real-time path at a target latency by walking a fixed quality ladder. The load it
+watches is the larger of the average frame latency and the detector's time spread over the
+frames it covers (a detector slower than its interval leaves masks lagging behind and competes
+with shading). Over budget for a few frames steps down one rung, comfortably under budget for a
+couple of seconds steps back up, and a cooldown after every change lets the averages settle on
+the new rung before judging it. Every change is logged with the numbers behind it.
+*/
+class QualityController {
+public:
+    // fixedDetectionSize keeps the detector at 640 when the model can't take anything else
+    explicit QualityController(double targetLatencyMs, bool fixedDetectionSize = false);
+
+    // One frame's measurements, detectMs is the last detector run (0 while none finished).
+    // Returns true when the level changed.
+    bool update(double frameMs, double detectMs);
+
+    const QualityLevel& current() const { return levels[level]; }
+    size_t getLevel() const { return level; }
+    size_t getLevelCount() const { return levels.size(); }
+    double getTargetLatencyMs() const { return targetLatencyMs; }
+
+private:
+    std::vector<QualityLevel> levels;
+    size_t level;
+    double targetLatencyMs;
+    double frameAverage, detectAverage;
+    int overBudgetFrames, underBudgetFrames, cooldownFrames;
+
+    void changeLevel(size_t newLevel, double load);
+};
+
+std::string describeQualityLevel(const QualityLevel& level);
@@ -0,0 +1,270 @@
+#include "yolo_decode.hpp"
+#include <algorithm>
+#include <cmath>
+
+void preprocessYoloInput(const uint8_t* frame, int frameWidth, int frameHeight, int frameChannels,
+                         std::vector<float>& inputTensorValues, int inputSize)
+{
+    int targetSize = inputSize;
+    inputTensorValues.resize(1 * 3 * targetSize * targetSize);
+
+    for (int y = 0; y < targetSize; ++y) {
+        for (int x = 0; x < targetSize; ++x) {
+            float srcX = static_cast<float>(x) * frameWidth / targetSize;
+            float srcY = static_cast<float>(y) * frameHeight / targetSize;
+            int x0 = static_cast<int>(srcX);
+            int y0 = static_cast<int>(srcY);
+            int x1 = std::min(x0 + 1, frameWidth - 1);
+            int y1 = std::min(y0 + 1, frameHeight - 1);
+            float dx = srcX - x0;
+            float dy = srcY - y0;
+
+            for (int c = 0; c < 3; ++c) {
+                float p00 = frame[(y0 * frameWidth + x0) * frameChannels + c] / 255.0f;
+                float p01 = frame[(y0 * frameWidth + x1) * frameChannels + c] / 255.0f;
+                float p10 = frame[(y1 * frameWidth + x0) * frameChannels + c] / 255.0f;
+                float p11 = frame[(y1 * frameWidth + x1) * frameChannels + c] / 255.0f;
+
+                float value = (1 - dx) * (1 - dy) * p00 + dx * (1 - dy) * p01 +
+                            (1 - dx) * dy * p10 + dx * dy * p11;
+
+                inputTensorValues[(c * targetSize * targetSize) + (y * targetSize) + x] = value;
+            }
+        }
+    }
+}
+
+void decodeYoloDetections(const float* output0Data, const std::vector<int64_t>& output0Shape,
+                          const float* output1Data, const std::vector<int64_t>& output1Shape,
+                          const std::vector<std::string>& classLabels, const std::set<std::string>* keepClasses,
+                          float nmsThreshold, int outputWidth, int outputHeight,
+                          std::vector<YoloDetection>& detections, int inputSize)
+{
+    detections.clear();
+
+    // Process outputs like Python code
+    // output0: (1, 84+32, 8400) -> transpose to (8400, 116)
+    int num_proposals = static_cast<int>(output0Shape[2]); // 8400
+    int num_features = static_cast<int>(output0Shape[1]);  // 116 (84 for detection + 32 for masks)
+    int num_classes = static_cast<int>(classLabels.size());
+    
+    // output1: (1, 32, 160, 160), read as (32, 160*160)
+    int mask_channels = static_cast<int>(output1Shape[1]); // 32
+    int mask_height = static_cast<int>(output1Shape[2]);   // 160
+    int mask_width = static_cast<int>(output1Shape[3]);    // 160
+    
+    // Transpose output0 from (1, 116, 8400) to (8400, 116)
+    std::vector<float> transposed_output0(num_proposals * num_features);
+    for (int i = 0; i < num_proposals; ++i) {
+        for (int j = 0; j < num_features; ++j) {
+            transposed_output0[i * num_features + j] = output0Data[j * num_proposals + i];
+        }
+    }
+    
+    struct Candidate {
+        float x1, y1, x2, y2;
+        int class_id;
+        float prob;
+        int proposal; // Row of transposed_output0, for the mask coefficients
+    };
+    
+    std::vector<Candidate> candidates;
+    const float CONF_THRESH = 0.5f;
+    
+    // Process each proposal
+    for (int i = 0; i < num_proposals; ++i) {
+        float* proposal = &transposed_output0[i * num_features];
+        
+        // Get bounding box (center format)
+        float xc = proposal[0];
+        float yc = proposal[1];
+        float w = proposal[2];
+        float h = proposal[3];
+        
+        // Get class probabilities (84 classes starting from index 4)
+        float max_prob = 0.0f;
+        int best_class = 0;
+        for (int c = 0; c < num_classes && c < 84; ++c) {
+            if (proposal[4 + c] > max_prob) {
+                max_prob = proposal[4 + c];
+                best_class = c;
+            }
+        }
+        
+        // Filter by confidence threshold
+        if (max_prob < CONF_THRESH) continue;
+        
+        if (keepClasses && keepClasses->count(classLabels[best_class]) == 0) continue;
+        
+        // Convert to corner format and scale to image dimensions
+        float x1 = (xc - w / 2) / static_cast<float>(inputSize) * outputWidth;
+        float y1 = (yc - h / 2) / static_cast<float>(inputSize) * outputHeight;
+        float x2 = (xc + w / 2) / static_cast<float>(inputSize) * outputWidth;
+        float y2 = (yc + h / 2) / static_cast<float>(inputSize) * outputHeight;
+        
+        // Clamp to image bounds
+        x1 = std::max(0.0f, std::min(static_cast<float>(outputWidth - 1), x1));
+        y1 = std::max(0.0f, std::min(static_cast<float>(outputHeight - 1), y1));
+        x2 = std::max(x1 + 1.0f, std::min(static_cast<float>(outputWidth), x2));
+        y2 = std::max(y1 + 1.0f, std::min(static_cast<float>(outputHeight), y2));
+        
+        candidates.push_back({ x1, y1, x2, y2, best_class, max_prob, i });
+    }
+    
+    // Apply Non-Maximum Suppression
+    std::sort(candidates.begin(), candidates.end(), 
+              [](const Candidate& a, const Candidate& b) { return a.prob > b.prob; });
+    
+    std::vector<Candidate> final_detections;
+    std::vector<bool> suppressed(candidates.size(), false);
+    
+    for (size_t i = 0; i < candidates.size(); ++i) {
+        if (suppressed[i]) continue;
+        
+        final_detections.push_back(candidates[i]);
+        
+        // Suppress overlapping detections of the same class
+        for (size_t j = i + 1; j < candidates.size(); ++j) {
+            if (suppressed[j] || candidates[i].class_id != candidates[j].class_id) continue;
+            
+            // Calculate IoU
+            float inter_x1 = std::max(candidates[i].x1, candidates[j].x1);
+            float inter_y1 = std::max(candidates[i].y1, candidates[j].y1);
+            float inter_x2 = std::min(candidates[i].x2, candidates[j].x2);
+            float inter_y2 = std::min(candidates[i].y2, candidates[j].y2);
+            
+            float inter_area = std::max(0.0f, inter_x2 - inter_x1) * std::max(0.0f, inter_y2 - inter_y1);
+            float area1 = (candidates[i].x2 - candidates[i].x1) * (candidates[i].y2 - candidates[i].y1);
+            float area2 = (candidates[j].x2 - candidates[j].x1) * (candidates[j].y2 - candidates[j].y1);
+            float union_area = area1 + area2 - inter_area;
+            
+            float iou = union_area > 0 ? inter_area / union_area : 0;
+            if (iou > nmsThreshold) {
+                suppressed[j] = true;
+            }
+        }
+    }
+    
+    // Masks only for the survivors, and only inside their box since nothing else is used
+    for (const auto& det : final_detections) {
+        // Calculate mask bounds in mask coordinates
+        int mask_x1 = static_cast<int>(std::round(det.x1 / outputWidth * mask_width));
+        int mask_y1 = static_cast<int>(std::round(det.y1 / outputHeight * mask_height));
+        int mask_x2 = static_cast<int>(std::round(det.x2 / outputWidth * mask_width));
+        int mask_y2 = static_cast<int>(std::round(det.y2 / outputHeight * mask_height));
+        
+        // Clamp to mask bounds
+        mask_x1 = std::max(0, std::min(mask_x1, mask_width - 1));
+        mask_y1 = std::max(0, std::min(mask_y1, mask_height - 1));
+        mask_x2 = std::max(mask_x1 + 1, std::min(mask_x2, mask_width));
+        mask_y2 = std::max(mask_y1 + 1, std::min(mask_y2, mask_height));
+        
+        // Mask coefficients (32 values starting from index 84) @ prototypes over the region of interest
+        const float* mask_coeffs = &transposed_output0[det.proposal * num_features + 84];
+        int roi_width = mask_x2 - mask_x1;
+        int roi_height = mask_y2 - mask_y1;
+        std::vector<uint8_t> roi_mask(roi_width * roi_height);
+        
+        for (int y = 0; y < roi_height; ++y) {
+            for (int x = 0; x < roi_width; ++x) {
+                int pixel = (mask_y1 + y) * mask_width + (mask_x1 + x);
+                float value = 0.0f;
+                for (int c = 0; c < mask_channels; ++c) {
+                    value += mask_coeffs[c] * output1Data[c * mask_height * mask_width + pixel];
+                }
+                // Sigmoid above 0.5
+                roi_mask[y * roi_width + x] = value > 0.0f ? 255 : 0;
+            }
+        }
+        
+        YoloDetection detection;
+        detection.x1 = det.x1;
+        detection.y1 = det.y1;
+        detection.x2 = det.x2;
+        detection.y2 = det.y2;
+        detection.classId = det.class_id;
+        detection.score = det.prob;
+        detection.roiX = mask_x1;
+        detection.roiY = mask_y1;
+        detection.roiWidth = roi_width;
+        detection.roiHeight = roi_height;
+        detection.roiMask = std::move(roi_mask);
+        detections.push_back(std::move(detection));
+    }
+}
+
+void renderYoloMasks(const std::vector<YoloDetection>& detections, const std::vector<std::string>& classLabels,
+                     const std::set<std::string>& shaderClasses, int outputWidth, int outputHeight,
+                     std::map<std::string, std::vector<std::vector<unsigned char>>>& classMasks)
+{
+    classMasks.clear();
+
+    for (const auto& det : detections) {
+        const std::string& label = classLabels[det.classId];
+        if (shaderClasses.count(label) == 0) continue;
+        
+        int roi_width = det.roiWidth;
+        int roi_height = det.roiHeight;
+        const std::vector<uint8_t>& roi_mask = det.roiMask;
+        
+        // Resize ROI mask to detection box size using bilinear interpolation
+        int det_width = static_cast<int>(std::round(det.x2 - det.x1));
+        int det_height = static_cast<int>(std::round(det.y2 - det.y1));
+        std::vector<uint8_t> resized_mask(det_width * det_height);
+        
+        for (int y = 0; y < det_height; ++y) {
+            for (int x = 0; x < det_width; ++x) {
+                float src_x = static_cast<float>(x) / det_width * roi_width;
+                float src_y = static_cast<float>(y) / det_height * roi_height;
+                
+                int x0 = static_cast<int>(src_x);
+                int y0 = static_cast<int>(src_y);
+                int x1 = std::min(x0 + 1, roi_width - 1);
+                int y1 = std::min(y0 + 1, roi_height - 1);
+                
+                float dx = src_x - x0;
+                float dy = src_y - y0;
+                
+                float p00 = roi_mask[y0 * roi_width + x0] / 255.0f;
+                float p01 = roi_mask[y0 * roi_width + x1] / 255.0f;
+                float p10 = roi_mask[y1 * roi_width + x0] / 255.0f;
+                float p11 = roi_mask[y1 * roi_width + x1] / 255.0f;
+                
+                float value = (1 - dx) * (1 - dy) * p00 + dx * (1 - dy) * p01 +
+                             (1 - dx) * dy * p10 + dx * dy * p11;
+                
+                resized_mask[y * det_width + x] = static_cast<uint8_t>(value * 255);
+            }
+        }
+        
+        // Create final output mask
+        std::vector<uint8_t> output_mask(outputWidth * outputHeight, 0);
+        
+        // Place resized mask in the correct position
+        int start_x = static_cast<int>(det.x1);
+        int start_y = static_cast<int>(det.y1);
+        
+        for (int y = 0; y < det_height && (start_y + y) < outputHeight; ++y) {
+            for (int x = 0; x < det_width && (start_x + x) < outputWidth; ++x) {
+                int src_idx = y * det_width + x;
+                int dst_idx = (start_y + y) * outputWidth + (start_x + x);
+                output_mask[dst_idx] = resized_mask[src_idx];
+            }
+        }
+        
+        classMasks[label].push_back(std::move(output_mask));
+    }
+}
+
+void decodeYoloOutputs(const float* output0Data, const std::vector<int64_t>& output0Shape,
+                       const float* output1Data, const std::vector<int64_t>& output1Shape,
+                       const std::vector<std::string>& classLabels, const std::set<std::string>& shaderClasses,
+                       float nmsThreshold, int outputWidth, int outputHeight,
+                       std::map<std::string, std::vector<std::vector<unsigned char>>>& classMasks,
+                       int inputSize)
+{
+    std::vector<YoloDetection> detections;
+    decodeYoloDetections(output0Data, output0Shape, output1Data, output1Shape, classLabels, &shaderClasses,
+                         nmsThreshold, outputWidth, outputHeight, detections, inputSize);
+    renderYoloMasks(detections, classLabels, shaderClasses, outputWidth, outputHeight, classMasks);
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <string>
+#include <map>
+#include <set>
+
+/*
+CPU side of the YOLOv8-seg detector, kept apart from ObjectDetector so it does not need an ONNX
+session : letterbox-free resize into the 640x640 NCHW input tensor, and decoding of the two
+output tensors (boxes + mask coefficients, mask prototypes) into per class full frame masks.
+*/
+
+const int YOLO_INPUT_SIZE = 640;
+
+// RGB(A) frame -> 1x3xSxS float tensor in [0,1], bilinear resampled. S is 640 unless the model
+// was exported with a dynamic input size, smaller multiples of 32 trade accuracy for speed.
+void preprocessYoloInput(const uint8_t* frame, int frameWidth, int frameHeight, int frameChannels,
+                         std::vector<float>& inputTensorValues, int inputSize = YOLO_INPUT_SIZE);
+
+// One detection after NMS, what renderYoloMasks needs to draw its full frame mask
+struct YoloDetection {
+    float x1, y1, x2, y2;               // Box in output frame pixels, clamped to the frame
+    int classId;
+    float score;
+    int roiX, roiY, roiWidth, roiHeight; // The box in prototype mask pixels
+    std::vector<uint8_t> roiMask;       // Thresholded mask inside it, 0 / 255
+};
+
+/*
+The two halves of decodeYoloOutputs, so detections can be kept (see DetectionCache) and drawn
+again without the model. decodeYoloDetections keeps every class when keepClasses is null,
+renderYoloMasks only draws the labels in shaderClasses.
+*/
+void decodeYoloDetections(const float* output0Data, const std::vector<int64_t>& output0Shape,
+                          const float* output1Data, const std::vector<int64_t>& output1Shape,
+                          const std::vector<std::string>& classLabels, const std::set<std::string>* keepClasses,
+                          float nmsThreshold, int outputWidth, int outputHeight,
+                          std::vector<YoloDetection>& detections, int inputSize = YOLO_INPUT_SIZE);
+void renderYoloMasks(const std::vector<YoloDetection>& detections, const std::vector<std::string>& classLabels,
+                     const std::set<std::string>& shaderClasses, int outputWidth, int outputHeight,
+                     std::map<std::string, std::vector<std::vector<unsigned char>>>& classMasks);
+
+/*
+output0 is (1, 4 + classes + 32, proposals), output1 is (1, 32, maskH, maskW). Only detections
+whose label is in shaderClasses are kept, masks are produced at outputWidth x outputHeight.
+inputSize is the size the tensor was preprocessed at, boxes are in that space.
+*/
+void decodeYoloOutputs(const float* output0Data, const std::vector<int64_t>& output0Shape,
+                       const float* output1Data, const std::vector<int64_t>& output1Shape,
+                       const std::vector<std::string>& classLabels, const std::set<std::string>& shaderClasses,
+                       float nmsThreshold, int outputWidth, int outputHeight,
+                       std::map<std::string, std::vector<std::vector<unsigned char>>>& classMasks,
+                       int inputSize = YOLO_INPUT_SIZE);